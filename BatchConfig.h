@@ -0,0 +1,192 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include "KobayashiCommon.h"
+
+// ==========================================
+// 无窗口批处理程序的配置解析
+// ==========================================
+
+// 命令行和配置文件统一解析成 key=value 表
+// 命令行支持：--key value、--key=value、key=value、--config 文件
+// 配置文件每行一个 key = value，# 之后为注释
+// 命令行中后出现的值覆盖先出现的值（包括配置文件中的值）
+struct BatchConfig
+{
+    std::map<std::string, std::string> values;
+    std::set<std::string> used; // 已被程序读取的 key，用于报告拼写错误的参数
+
+    bool parse(int argc, char** argv)
+    {
+        for (int a = 1; a < argc; a++) {
+            std::string arg = argv[a];
+            if (arg.compare(0, 2, "--") == 0) arg = arg.substr(2);
+
+            std::string key, value;
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                key = arg.substr(0, eq);
+                value = arg.substr(eq + 1);
+            } else if (a + 1 < argc) {
+                key = arg;
+                value = argv[++a];
+            } else {
+                std::cerr << "Missing value for option: " << arg << std::endl;
+                return false;
+            }
+
+            if (key == "config") {
+                if (!loadFile(value)) return false;
+            } else {
+                values[key] = value;
+            }
+        }
+        return true;
+    }
+
+    bool loadFile(const std::string& path)
+    {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Cannot open config file: " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        int lineNo = 0;
+        while (std::getline(in, line)) {
+            lineNo++;
+            size_t hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
+
+            size_t eq = line.find('=');
+            std::string key = _trim(line.substr(0, eq));
+            if (key.empty()) continue;
+            if (eq == std::string::npos) {
+                std::cerr << path << ":" << lineNo << ": expected key = value" << std::endl;
+                return false;
+            }
+            values[key] = _trim(line.substr(eq + 1));
+        }
+        return true;
+    }
+
+    bool has(const std::string& key) const { return values.count(key) != 0; }
+
+    std::string getString(const std::string& key, const std::string& def)
+    {
+        used.insert(key);
+        auto it = values.find(key);
+        return it == values.end() ? def : it->second;
+    }
+
+    int getInt(const std::string& key, int def)
+    {
+        used.insert(key);
+        auto it = values.find(key);
+        return it == values.end() ? def : std::atoi(it->second.c_str());
+    }
+
+    float getFloat(const std::string& key, float def)
+    {
+        used.insert(key);
+        auto it = values.find(key);
+        return it == values.end() ? def : (float)std::atof(it->second.c_str());
+    }
+
+    // 把所有未被程序读取的 key 当作物理参数交给模拟器的 setParam()
+    // 模拟器不认识的 key 视为错误，避免拼写错误的参数被静默忽略
+    template <class Sim>
+    bool applyParams(Sim& sim)
+    {
+        bool ok = true;
+        for (const auto& kv : values) {
+            if (used.count(kv.first)) continue;
+            if (!sim.setParam(kv.first, (float)std::atof(kv.second.c_str()))) {
+                std::cerr << "Unknown parameter: " << kv.first << std::endl;
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    static std::string _trim(const std::string& s)
+    {
+        size_t b = s.find_first_not_of(" \t\r\n");
+        if (b == std::string::npos) return "";
+        size_t e = s.find_last_not_of(" \t\r\n");
+        return s.substr(b, e - b + 1);
+    }
+};
+
+// 把相场以 float32 原始二进制写入文件（行优先，x 变化最快）
+inline bool writeRawField(const std::string& path, const std::vector<float>& field)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot write output file: " << path << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(field.data()), field.size() * sizeof(float));
+    return true;
+}
+
+// 解析边界条件名：periodic、neumann、dirichlet
+inline bool parseBoundary(const std::string& name, Boundary& out)
+{
+    if (name == "periodic") out = Boundary::Periodic;
+    else if (name == "neumann") out = Boundary::Neumann;
+    else if (name == "dirichlet") out = Boundary::Dirichlet;
+    else {
+        std::cerr << "Unknown boundary condition: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 解析时间步长控制：fixed、adaptive、subcycled
+inline bool parseTimeStepping(const std::string& name, TimeStepping& out)
+{
+    if (name == "fixed") out = TimeStepping::Fixed;
+    else if (name == "adaptive") out = TimeStepping::Adaptive;
+    else if (name == "subcycled") out = TimeStepping::Subcycled;
+    else {
+        std::cerr << "Unknown time stepping: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 解析场的存储精度：single、half、bfloat16、double
+inline bool parsePrecision(const std::string& name, Precision& out)
+{
+    if (name == "single") out = Precision::Single;
+    else if (name == "half") out = Precision::Half;
+    else if (name == "bfloat16") out = Precision::BFloat16;
+    else if (name == "double") out = Precision::Double;
+    else {
+        std::cerr << "Unknown precision: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 解析 SIMD 指令集：auto、scalar、sse4、avx2、avx512
+// auto 请求最高的指令集，setSimd() 会降到 CPU 实际支持的级别
+inline bool parseSimd(const std::string& name, SimdLevel& out)
+{
+    if (name == "auto" || name == "avx512") out = SimdLevel::AVX512;
+    else if (name == "scalar") out = SimdLevel::Scalar;
+    else if (name == "sse4") out = SimdLevel::SSE4;
+    else if (name == "avx2") out = SimdLevel::AVX2;
+    else {
+        std::cerr << "Unknown simd level: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+// ==========================================
+// 自包含的一维复数 FFT
+// ==========================================
+
+// 不依赖任何外部库，离线即可编译：
+//   长度是 2 的幂      ：迭代的基 2 Cooley-Tukey
+//   质因数都不超过 31  ：递归的混合基 Cooley-Tukey（例如默认网格 250 = 2·5³）
+//   其它长度           ：Bluestein 算法，把长度 n 的 DFT 写成长度 m（2 的幂，m ≥ 2n - 1）的循环卷积
+// 旋转因子、位反转表和 Bluestein 的 chirp 在构造时用双精度算好再转成 float。
+// transform() 是 const 的，只写调用者给的数组和工作区，多个线程可以同时使用同一个 FFT 对象。
+class FFT
+{
+public:
+    typedef std::complex<float> Complex;
+
+    explicit FFT(int n = 1) : _n(n)
+    {
+        _m = 1;
+        while (_m < n) _m <<= 1;
+        if (_m != n && _factorize(n)) {
+            // 混合基：长度 n 的旋转因子 e^{-2πik/n}
+            _roots.resize(n);
+            for (int k = 0; k < n; k++) {
+                double a = -2.0 * 3.14159265358979323846 * k / n;
+                _roots[k] = Complex((float)std::cos(a), (float)std::sin(a));
+            }
+            return;
+        }
+        if (_m != n) {
+            // Bluestein：chirp w_j = e^{-iπj²/n}，j² 先对 2n 取模，避免 j 较大时角度失去精度
+            _m = 1;
+            while (_m < 2 * n - 1) _m <<= 1;
+            _chirp.resize(n);
+            for (int j = 0; j < n; j++) {
+                long long j2 = ((long long)j * j) % (2LL * n);
+                double a = -3.14159265358979323846 * (double)j2 / n;
+                _chirp[j] = Complex((float)std::cos(a), (float)std::sin(a));
+            }
+        }
+
+        // 长度 m 的基 2 变换：位反转表和 m/2 个旋转因子 e^{-2πik/m}
+        int bits = 0;
+        while ((1 << bits) < _m) bits++;
+        _reverse.resize(_m);
+        for (int i = 0; i < _m; i++) {
+            int r = 0;
+            for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+            _reverse[i] = r;
+        }
+        _twiddle.resize(_m / 2 > 0 ? _m / 2 : 1);
+        for (int k = 0; k < _m / 2; k++) {
+            double a = -2.0 * 3.14159265358979323846 * k / _m;
+            _twiddle[k] = Complex((float)std::cos(a), (float)std::sin(a));
+        }
+
+        if (!_chirp.empty()) {
+            // 卷积核 b_j = conj(w_j)，按循环卷积放在 0..n-1 和 m-n+1..m-1，预先变换好
+            _kernel.assign(_m, Complex(0.0f, 0.0f));
+            for (int j = 0; j < n; j++) {
+                _kernel[j] = std::conj(_chirp[j]);
+                if (j > 0) _kernel[_m - j] = std::conj(_chirp[j]);
+            }
+            _radix2(_kernel.data(), false);
+        }
+    }
+
+    int size() const { return _n; }
+
+    // 原地变换 data[0, n)：正变换 X_k = Σ x_j e^{-2πijk/n}；逆变换不除以 n
+    // scratch 是调用者的工作区（只有 Bluestein 用到），按需扩展，重复调用时不再分配
+    void transform(Complex* data, bool inverse, std::vector<Complex>& scratch) const
+    {
+        if (!_roots.empty()) {
+            if (scratch.size() < (size_t)_n) scratch.resize(_n);
+            std::copy(data, data + _n, scratch.begin());
+            _mixed(scratch.data(), data, _n, 1, 0, inverse);
+            return;
+        }
+        if (_chirp.empty()) {
+            _radix2(data, inverse);
+            return;
+        }
+
+        // 逆变换 = conj(正变换(conj(x)))
+        if (scratch.size() < (size_t)_m) scratch.resize(_m);
+        Complex* a = scratch.data();
+        for (int j = 0; j < _n; j++) a[j] = _mul(inverse ? std::conj(data[j]) : data[j], _chirp[j]);
+        for (int j = _n; j < _m; j++) a[j] = Complex(0.0f, 0.0f);
+        _radix2(a, false);
+        for (int j = 0; j < _m; j++) a[j] = _mul(a[j], _kernel[j]);
+        _radix2(a, true);
+        float scale = 1.0f / _m;
+        for (int k = 0; k < _n; k++) {
+            Complex x = _mul(a[k], _chirp[k]) * scale;
+            data[k] = inverse ? std::conj(x) : x;
+        }
+    }
+
+private:
+    int _n, _m;
+    std::vector<int> _reverse;
+    std::vector<Complex> _twiddle;
+    std::vector<Complex> _chirp;  // Bluestein 的 w_j，长度是 2 的幂时为空
+    std::vector<Complex> _kernel; // Bluestein 卷积核的 FFT
+    std::vector<int> _factors;    // 混合基：n 的质因数分解（4 合并成一个因子）
+    std::vector<Complex> _roots;  // 混合基：长度 n 的旋转因子，其它算法时为空
+
+    // 分解 n，质因数都不超过 31 时返回 true
+    bool _factorize(int n)
+    {
+        _factors.clear();
+        while (n % 4 == 0) { _factors.push_back(4); n /= 4; }
+        for (int p = 2; p <= 31 && n > 1; p++)
+            while (n % p == 0) { _factors.push_back(p); n /= p; }
+        return n == 1;
+    }
+
+    // 递归的时间抽取：长度 len 的子序列 in[0], in[stride], ... 的变换写入 out[0, len)。
+    // len = r·m：先把 r 个间隔为 stride·r 的子序列各自变换成长度 m，再对每个 k 做一次 r 点蝶形
+    void _mixed(const Complex* in, Complex* out, int len, int stride, int level, bool inverse) const
+    {
+        int r = _factors[level], m = len / r;
+        if (m == 1) {
+            for (int q = 0; q < r; q++) out[q] = in[q * stride];
+        } else {
+            for (int q = 0; q < r; q++) _mixed(in + q * stride, out + q * m, m, stride * r, level + 1, inverse);
+        }
+
+        // X[k + u·m] = Σ_q Y_q[k]·e^{-2πi·q(k + u·m)/len}，len 的单位根是长度 n 的单位根的 stride 次幂
+        float sign = inverse ? -1.0f : 1.0f;
+        Complex t[32];
+        int turn = _n / r; // (u·m)·stride = u·n/r
+        for (int k = 0; k < m; k++) {
+            for (int q = 0; q < r; q++) t[q] = out[q * m + k];
+            for (int u = 0, step = k * stride; u < r; u++, step += turn) {
+                Complex sum = t[0];
+                int e = 0;
+                for (int q = 1; q < r; q++) {
+                    e += step;
+                    if (e >= _n) e -= _n;
+                    Complex w = _roots[e];
+                    sum += _mul(t[q], Complex(w.real(), sign * w.imag()));
+                }
+                out[k + u * m] = sum;
+            }
+        }
+    }
+
+    // 复数乘法：std::complex 的 operator* 要处理 inf/nan（不开 -ffast-math 时调用 __mulsc3），这里的数都是有限的
+    static inline Complex _mul(Complex a, Complex b)
+    {
+        return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    // 长度 _m 的迭代基 2 变换（逆变换不除以 _m）
+    void _radix2(Complex* a, bool inverse) const
+    {
+        for (int i = 0; i < _m; i++)
+            if (i < _reverse[i]) std::swap(a[i], a[_reverse[i]]);
+
+        float sign = inverse ? -1.0f : 1.0f; // 逆变换用共轭的旋转因子
+        for (int len = 2; len <= _m; len <<= 1) {
+            int half = len >> 1, stride = _m / len;
+            for (int s = 0; s < _m; s += len) {
+                for (int k = 0; k < half; k++) {
+                    Complex w = _twiddle[k * stride];
+                    Complex v = _mul(a[s + k + half], Complex(w.real(), sign * w.imag()));
+                    Complex u = a[s + k];
+                    a[s + k] = u + v;
+                    a[s + k + half] = u - v;
+                }
+            }
+        }
+    }
+};
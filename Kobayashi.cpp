@@ -1,5 +1,65 @@
 #include "Kobayashi.h"
+#include "Simd.h"
 #include <cfloat> // 包含 FLT_EPSILON，用于浮点数比较，防止除以零
+#include <algorithm>
+
+// ==========================================
+// 代数各向异性：不用三角函数计算 cos(nθ)、sin(nθ)
+// ==========================================
+
+// Trig 路径的界面法线角度：由梯度 (gx, gy) 按象限用 atan 计算，
+// 梯度接近 0 的方向（FLT_EPSILON 以内）不改变 angl，沿用上一步的角度。TwoPass 与 Fused 共用，两者逐位一致
+template <class R> inline R interfaceAngle(R gx, R gy, R angl)
+{
+    if (gx <= +FLT_EPSILON && gx >= -FLT_EPSILON) {
+        if (gy < -FLT_EPSILON) angl = -0.5f * PI_F;
+        else if (gy > +FLT_EPSILON) angl = 0.5f * PI_F;
+    }
+    if (gx > +FLT_EPSILON) {
+        if (gy < -FLT_EPSILON) angl = 2.0f * PI_F + atan(gy / gx);
+        else if (gy > +FLT_EPSILON) angl = atan(gy / gx);
+    }
+    if (gx < -FLT_EPSILON) angl = PI_F + atan(gy / gx);
+    return angl;
+}
+
+// θ 是梯度 (gx, gy) 的方向角，令 c = cosθ = gx/|∇φ|、s = sinθ = gy/|∇φ|，
+// 则 cos(nθ) + i·sin(nθ) = (c + i·s)^n，整数 n 时展开成 c、s 的多项式
+// R 是计算类型（float，Double 精度时为 double）
+template <int N, class R> inline void angularHarmonic(R c, R s, R& cosN, R& sinN)
+{
+    static_assert(N == 4 || N == 6, "代数路径只展开 4 次和 6 次对称");
+    R c2 = c * c, s2 = s * s;
+    if (N == 4) {
+        cosN = c2 * c2 - 6.0f * c2 * s2 + s2 * s2;
+        sinN = 4.0f * c * s * (c2 - s2);
+    } else {
+        cosN = c2 * c2 * c2 - 15.0f * c2 * c2 * s2 + 15.0f * c2 * s2 * s2 - s2 * s2 * s2;
+        sinN = c * s * (6.0f * c2 * c2 - 20.0f * c2 * s2 + 6.0f * s2 * s2);
+    }
+}
+
+// 由一行梯度计算 epsilon 和 epsilonDeriv，循环内没有分支（三目运算编译为选择指令），可以向量化
+// 梯度接近 0 的格子方向角取 0（c = 1, s = 0）
+template <int N, class R>
+static void algebraicAnisotropyRow(int n, const R* gradX, const R* gradY,
+                                   float epsilonBar, float delta, R* eps, R* epsDeriv)
+{
+    const float tiny = FLT_EPSILON * FLT_EPSILON;
+    for (int i = 0; i < n; i++)
+    {
+        R gx = gradX[i], gy = gradY[i];
+        R r2 = gx * gx + gy * gy;
+        R inv = 1.0f / std::sqrt(r2 > tiny ? r2 : 1.0f);
+        R c = r2 > tiny ? gx * inv : 1.0f;
+        R s = r2 > tiny ? gy * inv : 0.0f;
+
+        R cosN, sinN;
+        angularHarmonic<N>(c, s, cosN, sinN);
+        eps[i] = epsilonBar * (1.0f + delta * cosN);
+        epsDeriv[i] = -epsilonBar * (float)N * delta * sinN;
+    }
+}
 
 // ==========================================
 // 构造函数与初始化
@@ -10,14 +70,17 @@ Kobayashi::Kobayashi(int x, int y, float timeStep) {
     _dx = 0.03f; // 空间步长：模拟世界中每个格子代表的物理距离
     _dy = 0.03f; 
     _dt = timeStep; // 时间步长：每次模拟迭代推进的时间量
+    _fixedDt = timeStep;
+    _dtT = timeStep;
+    _pool = std::make_shared<ThreadPool>(0); // 默认使用全部核心
+    setSimd(detectSimd());
     
     _initParams();  // 初始化物理参数
     _vectorInit();  // 分配内存并设置初始条件
 }
 
 Kobayashi::~Kobayashi() {
-    // 析构函数：程序退出时清理显存中的纹理资源
-    if (_textureID) glDeleteTextures(1, &_textureID);
+    // 析构函数：纹理资源由 glRelease() 在 OpenGL 上下文仍然有效时释放
 }
 
 // 初始化 Kobayashi 晶体生长模型的物理常数
@@ -36,32 +99,35 @@ void Kobayashi::_initParams() {
 
 // 分配内存并重置模拟状态
 void Kobayashi::_vectorInit() {
-    size_t vSize = _objectCount.x * _objectCount.y;
+    size_t vSize = (size_t)(_objectCount.x + 2) * (_objectCount.y + 2); // 含幽灵格
     
     // _phi: 相场变量 (0=液, 1=固)
     // _t: 温度场
     _phi.assign(vSize, 0.0f); 
     _t.assign(vSize, 0.0f);
+    _angl.assign(vSize, 0.0f); // 界面法线角度
     
-    // 梯度(Gradient)和拉普拉斯(Laplacian)缓存，用于计算变化率
-    _gradPhiX.assign(vSize, 0.0f); 
-    _gradPhiY.assign(vSize, 0.0f);
-    _lapPhi.assign(vSize, 0.0f); 
-    _lapT.assign(vSize, 0.0f);
-    
-    // 辅助变量：角度、各向异性系数及其导数
-    _angl.assign(vSize, 0.0f); 
-    _epsilon.assign(vSize, 0.0f); 
-    _epsilonDeriv.assign(vSize, 0.0f);
+    // TwoPass 内核的全场导数缓存，以及 Jacobi 模式 / Fused 内核的双缓冲
+    _allocateDerivedBuffers();
+    _allocateNextBuffers();
+    _allocateSpectralBuffers();
+    if (_thermalRatio > 1) _restrictTemperature();
     
     // 像素缓冲区：这是我们要传给显卡的数据，每个像素4个字节 (R,G,B,A)
-    _pixelBuffer.assign(vSize * 4, 0);
+    _pixelBuffer.assign((size_t)_objectCount.x * _objectCount.y * 4, 0);
     
-    // 在中心创建一个初始晶核
+    // 在中心创建一个初始晶核，Single 以外的精度再转换成对应的存储类型
     _createNucleus(_objectCount.x / 2, _objectCount.y / 2);
+    _convertFields(true);
     
-    // 立即更新一次纹理，确保初始画面不是黑的
-    _updateTexture();
+    // 下一次绘制时立即更新纹理，确保初始画面不是黑的
+    _stepCount = 0;
+    _time = 0.0;
+    _stats = GrowthStats();
+    _monitor.reset();
+    _snapshot.stepCount = -1;
+    _textureDirty = true;
+    _tilesDirty = true;
 }
 
 // 在网格中心放置一个微小的“种子”，让晶体开始生长
@@ -81,18 +147,28 @@ void Kobayashi::_createNucleus(int x, int y)
 
 // 计算空间导数（梯度和拉普拉斯算子）
 // 这是有限差分法的核心：通过邻居格子的值来推算当前的斜率和曲率
+// 每一行只写自己的导数、只读 _phi/_t，行与行之间没有依赖，按行并行
 void Kobayashi::_computeGradientLaplacian()
 {
-    for (int j = 0; j < _objectCount.y; j++)
+    _pool->parallelFor(0, _objectCount.y, [this](int j0, int j1) { _computeGradientLaplacianRows(j0, j1); });
+    _fillDerivedHalo();
+}
+
+// 计算 [j0, j1) 行的导数
+void Kobayashi::_computeGradientLaplacianRows(int j0, int j1)
+{
+    bool algebraic = _algebraicAnisotropy();
+
+    for (int j = j0; j < j1; j++)
     {
         for (int i = 0; i < _objectCount.x; i++)
         {
-            // 周期性边界条件 (Periodic Boundary)
-            // 意味着如果你走出右边界，会从左边界回来（像《贪吃蛇》或地球仪）
-            int i_plus = (i + 1) % _objectCount.x;
-            int i_minus = ((i - 1) + _objectCount.x) % _objectCount.x;
-            int j_plus = (j + 1) % _objectCount.y;
-            int j_minus = ((j - 1) + _objectCount.y) % _objectCount.y;
+            // 邻居下标：边界外的邻居落在幽灵格上，已由 _fillHalo() 按边界条件填好
+            // （周期边界时幽灵格是对侧的值，就像《贪吃蛇》或地球仪）
+            int i_plus = i + 1;
+            int i_minus = i - 1;
+            int j_plus = j + 1;
+            int j_minus = j - 1;
 
             // 1. 计算一阶导数 (Gradient / 梯度)
             // 物理意义：相场变化的“坡度”，用于确定界面法线方向
@@ -110,19 +186,13 @@ void Kobayashi::_computeGradientLaplacian()
                 + _t[_INDEX(i_plus, j_plus)] + _t[_INDEX(i_minus, j_minus)] + _t[_INDEX(i_minus, j_plus)] + _t[_INDEX(i_plus, j_minus)]
                 - 12.0f * _t[_INDEX(i, j)]) / (3.0f * _dx * _dx);
 
+            // 代数路径在整行梯度算完后统一计算 epsilon
+            if (algebraic) continue;
+
             // 3. 计算界面法线角度 (Angle)
             // 通过梯度 (dx, dy) 使用 atan2 计算角度。
             // FLT_EPSILON 用于处理梯度接近 0 的情况（即平坦区域，没有角度）
-            if (_gradPhiX[_INDEX(i, j)] <= +FLT_EPSILON && _gradPhiX[_INDEX(i, j)] >= -FLT_EPSILON)
-                if (_gradPhiY[_INDEX(i, j)] < -FLT_EPSILON) _angl[_INDEX(i, j)] = -0.5f * PI_F;
-                else if (_gradPhiY[_INDEX(i, j)] > +FLT_EPSILON) _angl[_INDEX(i, j)] = 0.5f * PI_F;
-
-            if (_gradPhiX[_INDEX(i, j)] > +FLT_EPSILON)
-                if (_gradPhiY[_INDEX(i, j)] < -FLT_EPSILON) _angl[_INDEX(i, j)] = 2.0f * PI_F + atan(_gradPhiY[_INDEX(i, j)] / _gradPhiX[_INDEX(i, j)]);
-                else if (_gradPhiY[_INDEX(i, j)] > +FLT_EPSILON) _angl[_INDEX(i, j)] = atan(_gradPhiY[_INDEX(i, j)] / _gradPhiX[_INDEX(i, j)]);
-
-            if (_gradPhiX[_INDEX(i, j)] < -FLT_EPSILON)
-                _angl[_INDEX(i, j)] = PI_F + atan(_gradPhiY[_INDEX(i, j)] / _gradPhiX[_INDEX(i, j)]);
+            _angl[_INDEX(i, j)] = interfaceAngle(_gradPhiX[_INDEX(i, j)], _gradPhiY[_INDEX(i, j)], _angl[_INDEX(i, j)]);
 
             // 4. 计算各向异性系数 (Epsilon)
             // 晶体不是圆球，它在不同方向生长速度不同（这就形成了雪花形状）。
@@ -130,6 +200,11 @@ void Kobayashi::_computeGradientLaplacian()
             _epsilon[_INDEX(i, j)] = _epsilonBar * (1.0f + _delta * cos(_anisotropy * _angl[_INDEX(i, j)]));
             _epsilonDeriv[_INDEX(i, j)] = -_epsilonBar * _anisotropy * _delta * sin(_anisotropy * _angl[_INDEX(i, j)]);
         }
+
+        if (algebraic) {
+            int o = _INDEX(0, j);
+            _anisotropyRow(_objectCount.x, &_gradPhiX[o], &_gradPhiY[o], &_epsilon[o], &_epsilonDeriv[o]);
+        }
     }
 }
 
@@ -138,17 +213,34 @@ void Kobayashi::_computeGradientLaplacian()
 // ==========================================
 
 // 根据微分方程更新 _phi 和 _t 的值
+// 每个格子只读取自己的 _phi/_t 和上一阶段算好的导数，按行并行，结果与线程数无关
 void Kobayashi::_evolution()
 {
-    for (int j = 0; j < _objectCount.y; j++)
+    _pool->parallelFor(0, _objectCount.y, [this](int j0, int j1) { _evolutionRows(j0, j1); });
+
+    // Jacobi 模式：新值写在 _phiNext/_tNext 中，整步完成后交换
+    if (_updateMode == UpdateMode::Jacobi) {
+        _phi.swap(_phiNext);
+        _t.swap(_tNext);
+    }
+}
+
+// 更新 [j0, j1) 行
+void Kobayashi::_evolutionRows(int j0, int j1)
+{
+    // 原地模式直接覆盖 _phi/_t；Jacobi 模式写入 _phiNext/_tNext，只读取上一步的值
+    std::vector<float>& phiOut = (_updateMode == UpdateMode::Jacobi) ? _phiNext : _phi;
+    std::vector<float>& tOut = (_updateMode == UpdateMode::Jacobi) ? _tNext : _t;
+
+    for (int j = j0; j < j1; j++)
     {
         for (int i = 0; i < _objectCount.x; i++)
         {
-            // 获取邻居索引
-            int i_plus = (i + 1) % _objectCount.x;
-            int i_minus = ((i - 1) + _objectCount.x) % _objectCount.x;
-            int j_plus = (j + 1) % _objectCount.y;
-            int j_minus = ((j - 1) + _objectCount.y) % _objectCount.y;
+            // 获取邻居索引（导数的幽灵格由 _fillDerivedHalo() 填好）
+            int i_plus = i + 1;
+            int i_minus = i - 1;
+            int j_plus = j + 1;
+            int j_minus = j - 1;
 
             // 计算 epsilon 的梯度的平方项（复杂的物理推导结果，用于处理各向异性界面能）
             float gradEpsPowX = (_epsilon[_INDEX(i_plus, j)] * _epsilon[_INDEX(i_plus, j)] - _epsilon[_INDEX(i_minus, j)] * _epsilon[_INDEX(i_minus, j)]) / _dx;
@@ -170,54 +262,1147 @@ void Kobayashi::_evolution()
 
             // === 核心更新公式 ===
             // 1. 更新相场 phi (Allen-Cahn equation 变体)
-            _phi[_INDEX(i, j)] = _phi[_INDEX(i, j)] +
+            phiOut[_INDEX(i, j)] = oldPhi +
                 (term1 + term2 + _epsilon[_INDEX(i, j)] * _epsilon[_INDEX(i, j)] * _lapPhi[_INDEX(i, j)] + term3
                     + oldPhi * (1.0f - oldPhi) * (oldPhi - 0.5f + m)) * _dt / _tau;
             
             // 2. 更新温度场 T (热传导方程 + 潜热释放)
             // _K * (phi_new - phi_old) 代表相变时释放的潜热，这会加热周围，减缓进一步生长
-            _t[_INDEX(i, j)] = oldT + _lapT[_INDEX(i, j)] * _dt + _K * (_phi[_INDEX(i, j)] - oldPhi);
+            tOut[_INDEX(i, j)] = oldT + _lapT[_INDEX(i, j)] * _dt + _K * (phiOut[_INDEX(i, j)] - oldPhi);
+        }
+    }
+}
+
+// ==========================================
+// 融合内核：一次扫描完成导数和演化
+// ==========================================
+
+// 第 j 行演化需要第 j-1、j、j+1 行的 epsilon、epsilonDeriv 和梯度，
+// 所以每个线程只保留这三行导数，按行滚动，不再写出七个全场数组。
+// 拉普拉斯项只在格子自身用到，演化时直接从 _phi/_t 计算。
+// 新值写入 _phiNext/_tNext/_anglNext（读写不同的数组，行块之间才没有依赖），整步完成后交换，
+// 所以结果与 TwoPass 逐位相同。
+// 内核按存储类型 S 实例化，场通过 FieldPtrs 访问：读入时放宽成计算类型，写回时舍入
+template <> Kobayashi::FieldSet<Half>& Kobayashi::_fieldSet<Half>() { return _halfFields; }
+template <> Kobayashi::FieldSet<BFloat16>& Kobayashi::_fieldSet<BFloat16>() { return _bfloat16Fields; }
+template <> Kobayashi::FieldSet<double>& Kobayashi::_fieldSet<double>() { return _doubleFields; }
+
+template <class S>
+Kobayashi::FieldPtrs<S> Kobayashi::_fieldPtrs()
+{
+    FieldSet<S>& f = _fieldSet<S>();
+    FieldPtrs<S> p = { f.phi.data(), f.t.data(), f.phiNext.data(), f.tNext.data() };
+    return p;
+}
+
+template <>
+Kobayashi::FieldPtrs<float> Kobayashi::_fieldPtrs<float>()
+{
+    FieldPtrs<float> p = { _phi.data(), _t.data(), _phiNext.data(), _tNext.data() };
+    return p;
+}
+
+void Kobayashi::_fusedStep()
+{
+    switch (_precision) {
+    case Precision::Half: _packedFusedStep<Half>(); return;
+    case Precision::BFloat16: _packedFusedStep<BFloat16>(); return;
+    case Precision::Double: _packedFusedStep<double>(); return;
+    default: break;
+    }
+    _fusedPass<true>(diagnostics());
+    _phi.swap(_phiNext);
+    _t.swap(_tNext);
+    if (!_algebraicAnisotropy()) _angl.swap(_anglNext); // 代数路径不读写角度
+}
+
+template <class S>
+void Kobayashi::_packedFusedStep()
+{
+    FieldSet<S>& f = _fieldSet<S>();
+    _fusedPass<true, S>(diagnostics());
+    f.phi.swap(f.phiNext);
+    f.t.swap(f.tNext);
+    if (!_algebraicAnisotropy()) _angl.swap(_anglNext);
+}
+
+template <bool Temperature, class S>
+void Kobayashi::_fusedPass(bool measure)
+{
+    int nx = _objectCount.x;
+    const FieldPtrs<S> f = _fieldPtrs<S>();
+    _pool->parallelFor(0, _objectCount.y, [this, nx, &f, measure](int j0, int j1) {
+        GrowthStats stats;
+        _fusedBlock<Temperature, S>(f, j0, j1, 0, nx, nullptr, measure ? &stats : nullptr);
+        if (measure) _mergeStats(stats);
+    });
+}
+
+// 计算第 j 行 [i0-1, i1] 列的 epsilon、epsilonDeriv 和梯度，公式与 _computeGradientLaplacianRows() 相同
+// 输出数组的下标是相对 i0 的列号（-1 到 i1-i0）；列 -1 和 nx 是幽灵格，按 _fillDerivedHalo() 的规则取对应内部格的值
+// 行块或列范围之外的格子（owned 为 false 或列不在 [i0, i1) 内）由相邻的块负责写回角度
+template <class S, class R>
+void Kobayashi::_deriveRow(const FieldPtrs<S>& f, int j, bool owned, int i0, int i1, R* eps, R* epsDeriv, R* gradX, R* gradY)
+{
+    typedef FieldTraits<S> F;
+    int nx = _objectCount.x;
+    int j_plus = j + 1;
+    int j_minus = j - 1;
+    bool algebraic = _algebraicAnisotropy();
+    Boundary b = (_boundary == Boundary::Periodic) ? Boundary::Periodic : Boundary::Neumann;
+
+    // 代数路径的 [i0, i1) 列用 SIMD 行内核求梯度，两端可能落在幽灵格上的列仍按下面的标量代码计算
+    bool vector = algebraic && _simd && simdData(f.phi);
+    if (vector) {
+        SimdGradientRow2D row = { simdData(f.phi) + _INDEX(i0, j), simdData(gradX), simdData(gradY), i1 - i0, nx + 2, _dx, _dy };
+        _simd->gradientRow2D(row);
+    }
+
+    for (int c = i0 - 1; c <= i1; c++)
+    {
+        if (vector && c == i0) c = i1;
+        int i = (c < 0 || c >= nx) ? haloSource(c, nx, b) : c;
+        int i_plus = i + 1;
+        int i_minus = i - 1;
+
+        R gx = (F::load(f.phi[_INDEX(i_plus, j)]) - F::load(f.phi[_INDEX(i_minus, j)])) / _dx;
+        R gy = (F::load(f.phi[_INDEX(i, j_plus)]) - F::load(f.phi[_INDEX(i, j_minus)])) / _dy;
+        gradX[c - i0] = gx;
+        gradY[c - i0] = gy;
+        if (algebraic) continue;
+
+        R angl = interfaceAngle<R>(gx, gy, _angl[_INDEX(i, j)]);
+
+        if (owned && c >= i0 && c < i1) _anglNext[_INDEX(i, j)] = (float)angl;
+        eps[c - i0] = _epsilonBar * (1.0f + _delta * cos(_anisotropy * angl));
+        epsDeriv[c - i0] = -_epsilonBar * _anisotropy * _delta * sin(_anisotropy * angl);
+    }
+    if (algebraic) _anisotropyRow(i1 - i0 + 2, gradX - 1, gradY - 1, eps - 1, epsDeriv - 1);
+}
+
+// 更新 [j0, j1) × [i0, i1) 的格子：先准备 j0-1、j0 两行导数，之后每行只新算一行
+// 相场用 _dt 推进，温度场用 _dtT 推进并得到本步潜热的 _latentShare（不做子循环时两者为 _dt 和 1）。
+// Temperature 为 false 时是相场子循环的后续小步：温度场保持不变，潜热累加到 _tNext。
+// 读写的场由 f 给出（通常是 _fieldPtrs()，时间分块时奇数步交换当前值和 Next 缓冲）；
+// 给出 window 时滚动缓冲放在 window 中，它已经算到 j0 行（同一步的上一个行块正好结束在 j0）时不再重算开头两行
+template <bool Temperature, class S>
+void Kobayashi::_fusedBlock(const FieldPtrs<S>& f, int j0, int j1, int i0, int i1, RowWindow<typename FieldTraits<S>::Real>* window, GrowthStats* stats)
+{
+    typedef FieldTraits<S> F;
+    typedef typename F::Real R;
+    auto phi = [&](int i, int j) { return F::load(f.phi[_INDEX(i, j)]); };
+    auto t = [&](int i, int j) { return F::load(f.t[_INDEX(i, j)]); };
+
+    // 三行滚动缓冲：第 r 行导数存在槽位 r % 3，每行覆盖 [i0-1, i1] 列，slot() 返回列 i0 对应的位置
+    // 网格外的行（-1 和 ny）与 TwoPass 的导数幽灵格相同：周期边界取对侧的行，其余边界复制相邻的行
+    int width = i1 - i0 + 2;
+    RowWindow<R> local;
+    RowWindow<R>& w = window ? *window : local;
+    if (w.eps.size() != (size_t)(3 * width)) {
+        for (std::vector<R>* v : { &w.eps, &w.epsDeriv, &w.gradX, &w.gradY }) v->assign(3 * width, R(0));
+        w.row = INT_MIN;
+    }
+    std::vector<R>& eps = w.eps;
+    std::vector<R>& epsDeriv = w.epsDeriv;
+    std::vector<R>& gradX = w.gradX;
+    std::vector<R>& gradY = w.gradY;
+    auto slot = [width](int r) { return ((r % 3) + 3) % 3 * width + 1; };
+    Boundary b = (_boundary == Boundary::Periodic) ? Boundary::Periodic : Boundary::Neumann;
+    auto derive = [&](int r) {
+        int row = haloSource(r, _objectCount.y, b);
+        int o = slot(r);
+        _deriveRow(f, row, r >= j0 && r < j1, i0, i1, eps.data() + o, epsDeriv.data() + o, gradX.data() + o, gradY.data() + o);
+    };
+
+    if (w.row != j0) {
+        derive(j0 - 1);
+        derive(j0);
+    }
+    // 生长诊断：刚写完的一行还在 L1 中
+    auto measure = [&](int j) {
+        if (stats)
+            stats->addRow(f.phiNext + _INDEX(i0, j), Temperature ? f.tNext + _INDEX(i0, j) : nullptr, i1 - i0, i0, j, 0, 1, nullptr,
+                          _simd ? _simd->growthRow : nullptr);
+    };
+
+    for (int j = j0; j < j1; j++)
+    {
+        derive(j + 1);
+
+        const R* epsM = eps.data() + slot(j - 1);
+        const R* eps0 = eps.data() + slot(j);
+        const R* epsP = eps.data() + slot(j + 1);
+        const R* derM = epsDeriv.data() + slot(j - 1);
+        const R* der0 = epsDeriv.data() + slot(j);
+        const R* derP = epsDeriv.data() + slot(j + 1);
+        const R* gxM = gradX.data() + slot(j - 1);
+        const R* gx0 = gradX.data() + slot(j);
+        const R* gxP = gradX.data() + slot(j + 1);
+        const R* gy0 = gradY.data() + slot(j);
+
+        int j_plus = j + 1;
+        int j_minus = j - 1;
+        R latentK = _K * _latentShare;
+
+        if (_simd && simdData(f.phi)) {
+            int o = _INDEX(i0, j);
+            SimdEvolutionRow2D row = { simdData(f.phi) + o, simdData(f.t) + o,
+                                       simdData(epsM), simdData(eps0), simdData(epsP), simdData(derM), simdData(der0), simdData(derP),
+                                       simdData(gxM), simdData(gx0), simdData(gxP), simdData(gy0),
+                                       simdData(f.phiNext) + o, simdData(f.tNext) + o, i1 - i0, _objectCount.x + 2,
+                                       _dx, _dy, _dt, _dtT, _tau, _alpha, _gamma, _tEq, _K, (float)latentK, Temperature };
+            _simd->evolutionRow2D(row);
+            measure(j);
+            continue;
+        }
+
+        for (int i = i0; i < i1; i++)
+        {
+            int i_plus = i + 1;
+            int i_minus = i - 1;
+            int c = i - i0; // 滚动缓冲中的列
+            R lapPhi = (2.0f * (phi(i_plus, j) + phi(i_minus, j) + phi(i, j_plus) + phi(i, j_minus))
+                + phi(i_plus, j_plus) + phi(i_minus, j_minus) + phi(i_minus, j_plus) + phi(i_plus, j_minus)
+                - 12.0f * phi(i, j)) / (3.0f * _dx * _dx);
+
+            R lapT = !Temperature ? 0.0f : (2.0f * (t(i_plus, j) + t(i_minus, j) + t(i, j_plus) + t(i, j_minus))
+                + t(i_plus, j_plus) + t(i_minus, j_minus) + t(i_minus, j_plus) + t(i_plus, j_minus)
+                - 12.0f * t(i, j)) / (3.0f * _dx * _dx);
+
+            R gradEpsPowX = (eps0[c + 1] * eps0[c + 1] - eps0[c - 1] * eps0[c - 1]) / _dx;
+            R gradEpsPowY = (epsP[c] * epsP[c] - epsM[c] * epsM[c]) / _dy;
+
+            R term1 = (epsP[c] * derP[c] * gxP[c] - epsM[c] * derM[c] * gxM[c]) / _dy;
+            R term2 = -(eps0[c + 1] * der0[c + 1] * gy0[c + 1] - eps0[c - 1] * der0[c - 1] * gy0[c - 1]) / _dx;
+            R term3 = gradEpsPowX * gx0[c] + gradEpsPowY * gy0[c];
+
+            R oldPhi = phi(i, j);
+            R oldT = t(i, j);
+
+            R m = _alpha / PI_F * atan(_gamma * (_tEq - oldT));
+
+            R newPhi = oldPhi +
+                (term1 + term2 + eps0[c] * eps0[c] * lapPhi + term3
+                    + oldPhi * (1.0f - oldPhi) * (oldPhi - 0.5f + m)) * _dt / _tau;
+            int idx = _INDEX(i, j);
+            f.phiNext[idx] = F::store(newPhi);
+            if (Temperature) f.tNext[idx] = F::store(oldT + lapT * _dtT + latentK * (newPhi - oldPhi));
+            else f.tNext[idx] = F::store(F::load(f.tNext[idx]) + _K * (newPhi - oldPhi));
+        }
+        measure(j);
+    }
+    w.row = j1;
+}
+
+// ==========================================
+// 窄带内核：只计算活跃的块
+// ==========================================
+
+// 液相 phi = 0、固相 phi = 1 且温度均匀时，演化方程的每一项都是 0，格子保持不变。
+// 每步先更新活跃块，再按块行并行：连续的活跃块合成一段交给 _fusedBlock()，
+// 静止的块把当前值复制到 Next 缓冲（上一步已经复制过的块两份缓冲相同，不必再复制），整步完成后交换
+void Kobayashi::_narrowBandStep()
+{
+    _updateActiveTiles();
+
+    int nx = _objectCount.x, ny = _objectCount.y;
+    const FieldPtrs<float> f = _fieldPtrs<float>();
+    const bool measure = diagnostics();
+    _pool->parallelFor(0, _tilesY, [this, nx, ny, &f, measure](int ty0, int ty1) {
+        for (int ty = ty0; ty < ty1; ty++) {
+            int j0 = ty * _tileSize, j1 = std::min(j0 + _tileSize, ny);
+            for (int tx = 0; tx < _tilesX; ) {
+                int t = tx + _tilesX * ty;
+                if (!_tileActive[t]) {
+                    if (_tileStepped[t]) _copyTile(tx, ty);
+                    tx++;
+                    continue;
+                }
+                int run = tx;
+                while (run < _tilesX && _tileActive[run + _tilesX * ty]) run++;
+                _fusedBlock<true>(f, j0, j1, tx * _tileSize, std::min(run * _tileSize, nx));
+                tx = run;
+            }
+            // 这一行块的 Next 缓冲此时是完整的新状态（静止块与当前值相同）
+            if (measure) _measureRows(f.phiNext, f.tNext, j0, j1, 0, nx);
+        }
+    }, 1);
+
+    _phi.swap(_phiNext);
+    _t.swap(_tNext);
+    if (!_algebraicAnisotropy()) _angl.swap(_anglNext);
+    _tileStepped = _tileActive;
+}
+
+// 块 (tx, ty) 连同外面一圈格子（可能是相邻块的格子或幽灵格）是否不静止：
+// phi 有介于 bandTol 和 1 - bandTol 之间的值，或者同时有接近 0 和接近 1 的值，或者温度的极差超过 bandTol
+bool Kobayashi::_tileBusyAt(int tx, int ty) const
+{
+    int i0 = tx * _tileSize - 1, i1 = std::min((tx + 1) * _tileSize, _objectCount.x) + 1;
+    int j0 = ty * _tileSize - 1, j1 = std::min((ty + 1) * _tileSize, _objectCount.y) + 1;
+    bool liquid = false, solid = false;
+    float tMin = _t[_INDEX(i0, j0)], tMax = tMin;
+    for (int j = j0; j < j1; j++) {
+        for (int i = i0; i < i1; i++) {
+            float phi = _phi[_INDEX(i, j)];
+            float t = _t[_INDEX(i, j)];
+            liquid |= phi <= _bandTol;
+            solid |= phi >= 1.0f - _bandTol;
+            if (phi > _bandTol && phi < 1.0f - _bandTol) return true;
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+    }
+    return (liquid && solid) || tMax - tMin > _bandTol;
+}
+
+// 每步开始时（幽灵格已填好）更新活跃块。
+// 一个块的格子和外面一圈格子只会被它自己或 8 个相邻块的计算改变，所以只需重新检查
+// 上一步活跃的块及其相邻的块；周期边界时幽灵格来自对侧，相邻关系也按周期计算。
+// 计算某个格子要用到两格以内的 phi，所以本步活跃的块是不静止的块再向四周扩展一块
+void Kobayashi::_updateActiveTiles()
+{
+    int tilesX = (_objectCount.x + _tileSize - 1) / _tileSize;
+    int tilesY = (_objectCount.y + _tileSize - 1) / _tileSize;
+    size_t count = (size_t)tilesX * tilesY;
+    if (tilesX != _tilesX || tilesY != _tilesY || _tileBusy.size() != count) {
+        _tilesX = tilesX;
+        _tilesY = tilesY;
+        _tilesDirty = true;
+    }
+    if (_tilesDirty) {
+        // 两份缓冲的内容未知，第一步把所有静止块都复制一次
+        _tileBusy.assign(count, 1);
+        _tileActive.assign(count, 1);
+        _tileStepped.assign(count, 1);
+    }
+
+    bool periodic = (_boundary == Boundary::Periodic);
+    auto neighbor = [&](int tx, int ty, int dx, int dy) -> int {
+        int x = tx + dx, y = ty + dy;
+        if (periodic) { x = (x + _tilesX) % _tilesX; y = (y + _tilesY) % _tilesY; }
+        else if (x < 0 || x >= _tilesX || y < 0 || y >= _tilesY) return -1;
+        return x + _tilesX * y;
+    };
+    auto nearActive = [&](int tx, int ty) {
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                int n = neighbor(tx, ty, dx, dy);
+                if (n >= 0 && _tileActive[n]) return true;
+            }
+        return false;
+    };
+
+    // 1. 重新检查可能变化的块（_tileActive 此时仍是上一步的结果）
+    std::vector<unsigned char> busy(_tileBusy);
+    _pool->parallelFor(0, _tilesY, [&](int ty0, int ty1) {
+        for (int ty = ty0; ty < ty1; ty++)
+            for (int tx = 0; tx < _tilesX; tx++)
+                if (_tilesDirty || nearActive(tx, ty)) busy[tx + _tilesX * ty] = _tileBusyAt(tx, ty);
+    }, 1);
+    _tileBusy.swap(busy);
+
+    // 2. 向四周扩展一块
+    for (int ty = 0; ty < _tilesY; ty++)
+        for (int tx = 0; tx < _tilesX; tx++) {
+            bool active = false;
+            for (int dy = -1; dy <= 1 && !active; dy++)
+                for (int dx = -1; dx <= 1 && !active; dx++) {
+                    int n = neighbor(tx, ty, dx, dy);
+                    active = n >= 0 && _tileBusy[n];
+                }
+            _tileActive[tx + _tilesX * ty] = active;
+        }
+    _tilesDirty = false;
+}
+
+// 静止块的当前值复制到 Next 缓冲
+void Kobayashi::_copyTile(int tx, int ty)
+{
+    int i0 = tx * _tileSize, i1 = std::min(i0 + _tileSize, _objectCount.x);
+    int j0 = ty * _tileSize, j1 = std::min(j0 + _tileSize, _objectCount.y);
+    bool angle = !_algebraicAnisotropy();
+    for (int j = j0; j < j1; j++) {
+        int a = _INDEX(i0, j), e = _INDEX(i1, j);
+        std::copy(_phi.begin() + a, _phi.begin() + e, _phiNext.begin() + a);
+        std::copy(_t.begin() + a, _t.begin() + e, _tNext.begin() + a);
+        if (angle) std::copy(_angl.begin() + a, _angl.begin() + e, _anglNext.begin() + a);
+    }
+}
+
+// ==========================================
+// 谱方法内核：周期边界下的半隐式 Fourier 格式
+// ==========================================
+
+// 周期边界下 9 点拉普拉斯算子被 Fourier 变换对角化：波数 (p, q) 上它乘以 -κ²，
+// κ² = (12 - 4cos a - 4cos b - 4cos a·cos b) / (3dx²)，a = 2πp/nx，b = 2πq/ny。
+// 空间离散与 Fused 完全相同，只是时间推进改为半隐式：
+//   相场：τ(φⁿ⁺¹ - φⁿ)/dt = N(φⁿ, Tⁿ) + A∇²(φⁿ⁺¹ - φⁿ)
+//         N 是 Fused 的显式右端（各向异性项和反应项都是显式的），A = (ε̄(1 + δ))² 不小于各处的 ε²，
+//         稳定项只作用在增量上，dt → 0 时回到显式格式；
+//         于是 Fourier 空间中 Δφ̂ = Δφ̂_explicit / (1 + dt/τ·A·κ²)
+//         反应项仍是显式的，它的斜率 (0.5 + α/2)/τ 决定了 dt 的上限
+//   温度场：(Tⁿ⁺¹ - Tⁿ)/dt = ∇²Tⁿ⁺¹ + K(φⁿ⁺¹ - φⁿ)/dt，扩散完全隐式（后向欧拉），
+//         ΔT̂ = (dt·∇²Tⁿ 的变换 + K·Δφ̂) / (1 + dt·κ²)
+// 两个实数增量打包成一个复数场，每步只需一次正变换和一次逆变换
+void Kobayashi::_allocateSpectralBuffers() {
+    if (_kernel != Kernel::Spectral) {
+        std::vector<std::complex<float>>().swap(_spectrum);
+        std::vector<std::complex<float>>().swap(_filtered);
+        return;
+    }
+    int nx = _objectCount.x, ny = _objectCount.y;
+    if (_fftX.size() != nx) _fftX = FFT(nx);
+    if (_fftY.size() != ny) _fftY = FFT(ny);
+    _cosX.resize(nx);
+    _cosY.resize(ny);
+    for (int p = 0; p < nx; p++) _cosX[p] = (float)std::cos(2.0 * 3.14159265358979323846 * p / nx);
+    for (int q = 0; q < ny; q++) _cosY[q] = (float)std::cos(2.0 * 3.14159265358979323846 * q / ny);
+    _spectrum.assign((size_t)nx * ny, std::complex<float>(0.0f, 0.0f));
+    _filtered.assign((size_t)nx * ny, std::complex<float>(0.0f, 0.0f));
+}
+
+// nx × ny 的二维变换：先按行，再按列（列先复制到每个线程自己的缓冲里）
+void Kobayashi::_fft2D(std::vector<std::complex<float>>& data, bool inverse) {
+    int nx = _objectCount.x, ny = _objectCount.y;
+    _pool->parallelFor(0, ny, [&](int j0, int j1) {
+        std::vector<std::complex<float>> scratch;
+        for (int j = j0; j < j1; j++) _fftX.transform(&data[(size_t)nx * j], inverse, scratch);
+    });
+    _pool->parallelFor(0, nx, [&](int i0, int i1) {
+        std::vector<std::complex<float>> column(ny), scratch;
+        for (int i = i0; i < i1; i++) {
+            for (int j = 0; j < ny; j++) column[j] = data[i + (size_t)nx * j];
+            _fftY.transform(column.data(), inverse, scratch);
+            for (int j = 0; j < ny; j++) data[i + (size_t)nx * j] = column[j];
+        }
+    });
+}
+
+void Kobayashi::_spectralStep() {
+    if (_boundary != Boundary::Periodic) {
+        _fusedStep(); // 非周期边界不能用 FFT 对角化
+        return;
+    }
+    int nx = _objectCount.x, ny = _objectCount.y;
+
+    // 1. 显式增量：相场的 Δφ 和温度场的扩散部分 dt·∇²T（减去 Fused 加上的潜热）
+    _fusedPass<true>();
+    _pool->parallelFor(0, ny, [this, nx](int j0, int j1) {
+        for (int j = j0; j < j1; j++)
+            for (int i = 0; i < nx; i++) {
+                int idx = _INDEX(i, j);
+                float dPhi = _phiNext[idx] - _phi[idx];
+                float dT = _tNext[idx] - _t[idx] - _K * dPhi;
+                _spectrum[i + (size_t)nx * j] = std::complex<float>(dPhi, dT);
+            }
+    });
+    _fft2D(_spectrum, false);
+
+    // 2. 分开两个实数场的变换（X[k] 与 conj(X[-k]) 的组合），除以各自的隐式因子后重新打包
+    float eps = _epsilonBar * (1.0f + std::fabs(_delta));
+    float phiStiff = _dt / _tau * eps * eps;
+    float invLap = 1.0f / (3.0f * _dx * _dx);
+    _pool->parallelFor(0, ny, [&](int q0, int q1) {
+        for (int q = q0; q < q1; q++) {
+            int qm = (q == 0) ? 0 : ny - q;
+            for (int p = 0; p < nx; p++) {
+                int pm = (p == 0) ? 0 : nx - p;
+                std::complex<float> z = _spectrum[p + (size_t)nx * q];
+                std::complex<float> zc = std::conj(_spectrum[pm + (size_t)nx * qm]);
+                std::complex<float> phiHat = 0.5f * (z + zc);
+                std::complex<float> tHat = std::complex<float>(0.0f, -0.5f) * (z - zc);
+
+                float kappa2 = (12.0f - 4.0f * _cosX[p] - 4.0f * _cosY[q] - 4.0f * _cosX[p] * _cosY[q]) * invLap;
+                phiHat /= 1.0f + phiStiff * kappa2;
+                tHat = (tHat + _K * phiHat) / (1.0f + _dt * kappa2);
+                _filtered[p + (size_t)nx * q] = phiHat + std::complex<float>(0.0f, 1.0f) * tHat;
+            }
+        }
+    });
+    _fft2D(_filtered, true);
+
+    // 3. 加上隐式增量（逆变换不含 1/(nx·ny)）
+    float scale = 1.0f / ((float)nx * ny);
+    _pool->parallelFor(0, ny, [this, nx, scale](int j0, int j1) {
+        for (int j = j0; j < j1; j++)
+            for (int i = 0; i < nx; i++) {
+                int idx = _INDEX(i, j);
+                std::complex<float> d = _filtered[i + (size_t)nx * j] * scale;
+                _phi[idx] += d.real();
+                _t[idx] += d.imag();
+            }
+    });
+    if (!_algebraicAnisotropy()) _angl.swap(_anglNext);
+}
+
+float Kobayashi::activeTileFraction() const {
+    if (_kernel != Kernel::NarrowBand || _tileActive.empty()) return 1.0f;
+    size_t active = 0;
+    for (unsigned char a : _tileActive) active += a;
+    return (float)active / (float)_tileActive.size();
+}
+
+// 推进 steps 个物理步骤，不涉及任何渲染
+int Kobayashi::step(int steps) {
+    _stopReason = StopReason::None;
+    const long long start = _stepCount, end = _stepCount + steps;
+    while (_stepCount < end && _stopReason == StopReason::None) {
+        _saveSnapshot();
+        int depth = (int)std::min<long long>(end - _stepCount, _blockDepth);
+        if (depth <= 1 || !_temporalBlock(depth)) _advanceStep(FLT_MAX);
+        if (_divergence) _rollback();
+    }
+    _textureDirty = true; // 数据已变化，绘制前需要重新上传纹理
+    return (int)(_stepCount - start);
+}
+
+int Kobayashi::advance(double duration, int maxSteps) {
+    double end = _time + duration;
+    int steps = 0;
+    _stopReason = StopReason::None;
+    // 剩余时间小于一步的万分之一时视为已经到达，避免为舍入误差多走一小步
+    while (steps < maxSteps && end - _time > 1e-4 * _stepDt && _stopReason == StopReason::None) {
+        _saveSnapshot();
+        _advanceStep((float)(end - _time));
+        steps++;
+        if (_divergence) _rollback();
+    }
+    _textureDirty = true;
+    return steps;
+}
+
+// ==========================================
+// 生长诊断
+// ==========================================
+
+// 各任务先在局部累加，最后加锁合并一次；计数和最值与合并顺序无关，结果不随线程数变化
+template <class S>
+void Kobayashi::_measureRows(const S* phi, const S* t, int j0, int j1, int i0, int i1)
+{
+    GrowthStats s;
+    for (int j = j0; j < j1; j++) {
+        int n = _INDEX(i0, j);
+        s.addRow(phi + n, t ? t + n : nullptr, i1 - i0, i0, j, 0, 1, nullptr, _simd ? _simd->growthRow : nullptr);
+    }
+    _mergeStats(s);
+}
+
+void Kobayashi::_mergeStats(const GrowthStats& s)
+{
+    std::lock_guard<std::mutex> lock(_statsLock);
+    _stepStats.merge(s);
+}
+
+void Kobayashi::_measureField()
+{
+    int nx = _objectCount.x;
+    const bool coarse = _thermalRatio > 1; // 双分辨率时 _t 只是这一步开始时的插值
+    _pool->parallelFor(0, _objectCount.y, [this, nx, coarse](int j0, int j1) {
+        _measureRows(_phi.data(), coarse ? nullptr : _t.data(), j0, j1, 0, nx);
+    });
+    if (coarse) {
+        for (int J = 0; J < _thermalCount.y; J++)
+            _stepStats.addRow<float>(nullptr, &_tCoarse[_COARSE(0, J)], _thermalCount.x, 0, J, 0);
+    }
+}
+
+void Kobayashi::_finishStats()
+{
+    if (!diagnostics()) return;
+    _stats = _stepStats;
+    _stepStats = GrowthStats();
+    // 发散的一步不检查停止条件，由 step()/advance() 回退
+    if (_watchdog.interval > 0 && (_divergence = divergence(_stats, _watchdog))) return;
+    const int count[2] = { _objectCount.x, _objectCount.y };
+    StopReason reason = _monitor.check(_stats, _time, count, 2, _dx);
+    if (reason != StopReason::None) _stopReason = reason;
+}
+
+// ==========================================
+// 发散看门狗
+// ==========================================
+
+// 上一步已通过检查，当前状态可以作为回退点；回退之后 _stepCount 回到快照处，不会立即重存
+void Kobayashi::_saveSnapshot()
+{
+    if (_watchdog.interval <= 0) return;
+    if (_snapshot.stepCount >= 0 && _stepCount - _snapshot.stepCount < _watchdog.interval) return;
+    Snapshot& s = _snapshot;
+    s.phi = _phi;
+    s.t = _t;
+    s.angl = _angl;
+    s.tCoarse = _tCoarse;
+    _copyState(s.half, _halfFields);
+    _copyState(s.bfloat16, _bfloat16Fields);
+    _copyState(s.dbl, _doubleFields);
+    s.stepCount = _stepCount;
+    s.time = _time;
+    s.stepDt = _stepDt;
+    s.stats = _stats;
+    s.monitor = _monitor;
+    _retries = 0;
+}
+
+// 双缓冲的另一半和导数都在下一步重新计算，NarrowBand 的块状态全部重新检查
+void Kobayashi::_rollback()
+{
+    const Snapshot& s = _snapshot;
+    RollbackEvent e = { _stepCount, _time, s.stepCount, s.time, _stepDt, _divergence, false };
+    _divergence = nullptr;
+    e.gaveUp = s.stepCount < 0 || ++_retries > _watchdog.maxRetries;
+    if (s.stepCount >= 0) {
+        _phi = s.phi;
+        _t = s.t;
+        _angl = s.angl;
+        _tCoarse = s.tCoarse;
+        _copyState(_halfFields, s.half);
+        _copyState(_bfloat16Fields, s.bfloat16);
+        _copyState(_doubleFields, s.dbl);
+        _stepCount = s.stepCount;
+        _time = s.time;
+        _stepDt = s.stepDt;
+        _stats = s.stats;
+        StopConditions conditions = _monitor.conditions();
+        _monitor = s.monitor;
+        _monitor.setConditions(conditions);
+        _tilesDirty = true;
+    }
+    if (e.gaveUp) {
+        _stopReason = StopReason::Diverged;
+    } else {
+        _fixedDt *= 0.5f;
+        _cfl *= 0.5f;
+    }
+    _rollbacks.push_back(e);
+}
+
+// 显式格式的稳定上限（见 explicitStableStep），9 点拉普拉斯算子的谱半径是 16/(3·dx²)：
+// 相场：ε ≤ ε̄(1 + δ)，扩散系数 ε²/τ；反应项 φ(1-φ)(φ-0.5+m)/τ 在 φ = 0、1 处的斜率不超过 (0.5 + α/2)/τ（|m| < α/2）
+// 温度场：扩散系数 1，潜热项只依赖相场；双分辨率时在间距为 ratio·dx 的粗网格上
+void Kobayashi::stableTimeSteps(float& dtPhi, float& dtT) const {
+    float lap = 16.0f / (3.0f * _dx * _dx);
+    float eps = _epsilonBar * (1.0f + std::fabs(_delta));
+    dtPhi = explicitStableStep(eps * eps / _tau, lap, (0.5f + 0.5f * std::fabs(_alpha)) / _tau);
+    dtT = explicitStableStep(1.0f, lap / (float)(_thermalRatio * _thermalRatio), 0.0f);
+}
+
+// 推进一步：Fixed 用构造时的 dt，其余模式每步重新取稳定上限乘以 cfl，都不超过 maxDt。
+// Subcycled：稳定上限较大的场走这一步，另一个场走 substeps 个小步
+void Kobayashi::_advanceStep(float maxDt) {
+    float dt = std::min(_fixedDt, maxDt);
+    int substeps = 1;
+    bool phaseSubcycled = false;
+    bool dualGrid = _thermalRatio > 1;
+    bool packed = _precision != Precision::Single; // Single 以外的精度总是用 Fused 内核
+    // 只有周期边界的 Spectral 是半隐式的，其它边界按 Fused 推进，仍受显式稳定上限约束
+    bool implicit = _kernel == Kernel::Spectral && _boundary == Boundary::Periodic && !dualGrid && !packed;
+    if (_timeStepping != TimeStepping::Fixed && !implicit) {
+        float dtPhi, dtT;
+        stableTimeSteps(dtPhi, dtT);
+        dtPhi *= _cfl;
+        dtT *= _cfl;
+        if (_timeStepping == TimeStepping::Subcycled && _kernel == Kernel::Fused && !dualGrid && !packed) {
+            dt = std::min(std::max(dtPhi, dtT), maxDt);
+            substeps = std::max(1, (int)std::ceil(dt / std::min(dtPhi, dtT)));
+            phaseSubcycled = dtPhi < dtT;
+        } else {
+            dt = std::min(std::min(dtPhi, dtT), maxDt);
+        }
+    }
+
+    _fillHalo();
+    _stepStats = GrowthStats();
+    if (dualGrid) {
+        _dt = dt;
+        _dualGridStep();
+    } else if (substeps > 1 && phaseSubcycled) {
+        _subcyclePhase(dt, substeps);
+    } else if (substeps > 1) {
+        _subcycleTemperature(dt, substeps);
+    } else {
+        _dt = dt;
+        _dtT = dt;
+        _latentShare = 1.0f;
+        if (_kernel == Kernel::Fused || packed) {
+            _fusedStep();
+        } else if (_kernel == Kernel::NarrowBand) {
+            _narrowBandStep();
+        } else if (_kernel == Kernel::Spectral) {
+            _spectralStep();
+        } else {
+            _computeGradientLaplacian();
+            _evolution();
+        }
+    }
+
+    // Fused 扫描和 NarrowBand 已经在写新值时统计过，非周期边界的 Spectral 按 Fused 推进
+    bool fusedSweep = _kernel == Kernel::Fused || _kernel == Kernel::NarrowBand || packed
+                   || (_kernel == Kernel::Spectral && _boundary != Boundary::Periodic);
+    bool measured = !dualGrid && substeps == 1 && fusedSweep;
+    if (diagnostics() && !measured) _measureField();
+
+    _stepDt = dt;
+    _substeps = substeps;
+    _phaseSubcycled = phaseSubcycled;
+    _time += dt;
+    _stepCount++;
+    _finishStats();
+}
+
+// 温度场子循环：相场按 dt 走一步，温度场走 substeps 个 dt/substeps 的小步，
+// 每个小步得到相场这一步潜热的 1/substeps（相场的新值在所有小步结束后才换入）
+void Kobayashi::_subcycleTemperature(float dt, int substeps) {
+    _dt = dt;
+    _dtT = dt / substeps;
+    _latentShare = 1.0f / substeps;
+    _fusedPass<true>(); // 第一个小步与相场一起算
+    _t.swap(_tNext);
+    for (int s = 1; s < substeps; s++) {
+        fillHalo2D(_t, _objectCount.x, _objectCount.y, _boundary, _tBoundary);
+        _pool->parallelFor(0, _objectCount.y, [this](int j0, int j1) { _temperatureRows(j0, j1); });
+        _t.swap(_tNext);
+    }
+    _phi.swap(_phiNext);
+    if (!_algebraicAnisotropy()) _angl.swap(_anglNext);
+    _latentShare = 1.0f;
+}
+
+// 相场子循环：温度场按 dt 走一步（扩散项用这一步开始时的温度），相场走 substeps 个 dt/substeps 的小步，
+// 小步中的驱动力 m 也用开始时的温度，每个小步的潜热累加到温度场的新值上
+void Kobayashi::_subcyclePhase(float dt, int substeps) {
+    _dt = dt / substeps;
+    _dtT = dt;
+    _latentShare = 1.0f;
+    _fusedPass<true>();
+    bool angle = !_algebraicAnisotropy();
+    for (int s = 1; s < substeps; s++) {
+        _phi.swap(_phiNext);
+        if (angle) _angl.swap(_anglNext);
+        fillHalo2D(_phi, _objectCount.x, _objectCount.y, _boundary, 0.0f);
+        _fusedPass<false>();
+    }
+    _phi.swap(_phiNext);
+    if (angle) _angl.swap(_anglNext);
+    _t.swap(_tNext);
+}
+
+// [j0, j1) 行的温度场小步，公式与 _fusedBlock() 相同，相场的变化取 _phiNext - _phi
+void Kobayashi::_temperatureRows(int j0, int j1)
+{
+    float latentK = _K * _latentShare;
+    for (int j = j0; j < j1; j++)
+    {
+        int j_plus = j + 1;
+        int j_minus = j - 1;
+        for (int i = 0; i < _objectCount.x; i++)
+        {
+            int i_plus = i + 1;
+            int i_minus = i - 1;
+            float lapT = (2.0f * (_t[_INDEX(i_plus, j)] + _t[_INDEX(i_minus, j)] + _t[_INDEX(i, j_plus)] + _t[_INDEX(i, j_minus)])
+                + _t[_INDEX(i_plus, j_plus)] + _t[_INDEX(i_minus, j_minus)] + _t[_INDEX(i_minus, j_plus)] + _t[_INDEX(i_plus, j_minus)]
+                - 12.0f * _t[_INDEX(i, j)]) / (3.0f * _dx * _dx);
+            _tNext[_INDEX(i, j)] = _t[_INDEX(i, j)] + lapT * _dtT + latentK * (_phiNext[_INDEX(i, j)] - _phi[_INDEX(i, j)]);
+        }
+    }
+}
+
+// ==========================================
+// 时间分块
+// ==========================================
+
+// 连续 depth 步按行块的波前推进（见 wavefront()）：第 s 步读第 s 层、写第 s+1 层，两层交替放在当前值和 Next 缓冲中。
+// 第 j 行的新值要读第 j-2 到 j+2 行（导数行用到上下两行的梯度），每块至少 2 行时只依赖相邻的两块；
+// 每块写完后填充所含行的幽灵格，下一步读到的幽灵格与逐步推进时 _fillHalo() 填的相同
+bool Kobayashi::_temporalBlock(int depth)
+{
+    bool packed = _precision != Precision::Single;
+    if (_timeStepping != TimeStepping::Fixed || (_kernel != Kernel::Fused && !packed) || _thermalRatio > 1 || !_algebraicAnisotropy())
+        return false;
+    switch (_precision) {
+    case Precision::Half: return _blockedSteps<Half>(depth);
+    case Precision::BFloat16: return _blockedSteps<BFloat16>(depth);
+    case Precision::Double: return _blockedSteps<double>(depth);
+    default: return _blockedSteps<float>(depth);
+    }
+}
+
+template <class S>
+void Kobayashi::_swapNext()
+{
+    FieldSet<S>& f = _fieldSet<S>();
+    f.phi.swap(f.phiNext);
+    f.t.swap(f.tNext);
+}
+
+template <>
+void Kobayashi::_swapNext<float>()
+{
+    _phi.swap(_phiNext);
+    _t.swap(_tNext);
+}
+
+// 块高 h 取使 2·depth + 3 块（同时活跃的块及其相邻块）的 phi、t 及其 Next 缓冲放得进约 1 MiB 的行数，
+// 但至少 2 行、至少切出 2·depth 块；列方向切成线程数份
+template <class S>
+bool Kobayashi::_blockedSteps(int depth)
+{
+    const size_t cacheBytes = 1 << 20;
+    int nx = _objectCount.x, ny = _objectCount.y;
+    size_t rowBytes = (size_t)(nx + 2) * sizeof(S) * 4;
+    int h = std::min((int)(cacheBytes / ((2 * depth + 3) * rowBytes)), ny / (2 * depth));
+    if (h < 2) h = 2;
+    int chunks = ny / h;
+    if (chunks < 2 * depth) return false;
+    int parts = std::min(_pool->size(), nx);
+
+    _fillHalo();
+    _dt = _fixedDt;
+    _dtT = _fixedDt;
+    _latentShare = 1.0f;
+    _stepStats = GrowthStats();
+    const bool measure = diagnostics();
+
+    // 每一步的每个列带各有一个滚动缓冲，同一步相邻的行块接着用，不必重算块边界上的导数行
+    FieldPtrs<S> even = _fieldPtrs<S>();
+    FieldPtrs<S> odd = { even.phiNext, even.tNext, even.phi, even.t };
+    std::vector<RowWindow<typename FieldTraits<S>::Real>> windows(depth * parts);
+    auto row = [ny, chunks](int c) { return (int)((long long)ny * c / chunks); };
+    wavefront(*_pool, depth, chunks, parts,
+        [&](int s, int c, int p) {
+            GrowthStats stats;
+            bool last = measure && s == depth - 1; // 只统计最后一步
+            _fusedBlock<true, S>(s % 2 ? odd : even, row(c), row(c + 1), nx * p / parts, nx * (p + 1) / parts, &windows[s * parts + p],
+                                 last ? &stats : nullptr);
+            if (last) _mergeStats(stats);
+        },
+        [&](int s, int c) {
+            const FieldPtrs<S>& f = s % 2 ? odd : even;
+            fillHaloRows2D(f.phiNext, nx, ny, row(c), row(c + 1), _boundary, 0.0f);
+            fillHaloRows2D(f.tNext, nx, ny, row(c), row(c + 1), _boundary, _tBoundary);
+        });
+    if (depth % 2) _swapNext<S>();
+
+    _stepDt = _fixedDt;
+    _substeps = 1;
+    _phaseSubcycled = false;
+    for (int s = 0; s < depth; s++) _time += _fixedDt;
+    _stepCount += depth;
+    _finishStats();
+    return true;
+}
+
+// ==========================================
+// 双分辨率温度场
+// ==========================================
+
+// 一步分三段：
+//   1. 粗网格温度插值到 _t，相场扫描（Fused 的 Temperature = false 版本）只读 _t 中的格子自身求驱动力，
+//      潜热 K·Δφ 累加到清零的 _tNext
+//   2. 粗网格温度：9 点拉普拉斯算子（间距 ratio·dx）的扩散，加上所覆盖细格潜热之和除以 ratio²，
+//      相场区域内的总热量与单一网格时相同
+//   3. 交换相场和粗网格温度的双缓冲
+void Kobayashi::_dualGridStep()
+{
+    int cx = _thermalCount.x, cy = _thermalCount.y;
+    int r = _thermalRatio;
+    fillHalo2D(_tCoarse, cx, cy, _boundary, _tBoundary);
+    _prolongTemperature();
+
+    std::fill(_tNext.begin(), _tNext.end(), 0.0f);
+    _fusedPass<false>();
+
+    float dxc = r * _dx;
+    float share = 1.0f / (float)(r * r);
+    _pool->parallelFor(0, cy, [&](int j0, int j1) {
+        for (int J = j0; J < j1; J++)
+            for (int I = 0; I < cx; I++) {
+                const float* t = _tCoarse.data();
+                int c = _COARSE(I, J);
+                float lapT = (2.0f * (t[_COARSE(I + 1, J)] + t[_COARSE(I - 1, J)] + t[_COARSE(I, J + 1)] + t[_COARSE(I, J - 1)])
+                    + t[_COARSE(I + 1, J + 1)] + t[_COARSE(I - 1, J - 1)] + t[_COARSE(I - 1, J + 1)] + t[_COARSE(I + 1, J - 1)]
+                    - 12.0f * t[c]) / (3.0f * dxc * dxc);
+
+                // 所覆盖的细格（相场网格外的粗格没有潜热）
+                float latent = 0.0f;
+                int i0 = std::max(0, (I - _thermalPad) * r), i1 = std::min(_objectCount.x, (I - _thermalPad + 1) * r);
+                int jj0 = std::max(0, (J - _thermalPad) * r), jj1 = std::min(_objectCount.y, (J - _thermalPad + 1) * r);
+                for (int j = jj0; j < jj1; j++)
+                    for (int i = i0; i < i1; i++) latent += _tNext[_INDEX(i, j)];
+
+                _tCoarseNext[c] = t[c] + lapT * _dt + latent * share;
+            }
+    });
+
+    _tCoarse.swap(_tCoarseNext);
+    _phi.swap(_phiNext);
+    if (!_algebraicAnisotropy()) _angl.swap(_anglNext);
+}
+
+void Kobayashi::_prolongTemperature()
+{
+    _pool->parallelFor(0, _objectCount.y, [this](int j0, int j1) {
+        for (int j = j0; j < j1; j++) {
+            int J = _thermalIndexY[j];
+            float wy = _thermalWeightY[j];
+            for (int i = 0; i < _objectCount.x; i++) {
+                int I = _thermalIndexX[i];
+                float wx = _thermalWeightX[i];
+                float lower = _tCoarse[_COARSE(I, J)] + wx * (_tCoarse[_COARSE(I + 1, J)] - _tCoarse[_COARSE(I, J)]);
+                float upper = _tCoarse[_COARSE(I, J + 1)] + wx * (_tCoarse[_COARSE(I + 1, J + 1)] - _tCoarse[_COARSE(I, J + 1)]);
+                _t[_INDEX(i, j)] = lower + wy * (upper - lower);
+            }
+        }
+    });
+}
+
+// 每个粗格取所覆盖细格的平均，相场网格外的粗格取 Dirichlet 边界的温度（其余边界取 0）
+void Kobayashi::_restrictTemperature()
+{
+    int r = _thermalRatio;
+    float outside = (_boundary == Boundary::Dirichlet) ? _tBoundary : 0.0f;
+    for (int J = 0; J < _thermalCount.y; J++)
+        for (int I = 0; I < _thermalCount.x; I++) {
+            int i0 = std::max(0, (I - _thermalPad) * r), i1 = std::min(_objectCount.x, (I - _thermalPad + 1) * r);
+            int j0 = std::max(0, (J - _thermalPad) * r), j1 = std::min(_objectCount.y, (J - _thermalPad + 1) * r);
+            float sum = 0.0f;
+            int count = 0;
+            for (int j = j0; j < j1; j++)
+                for (int i = i0; i < i1; i++, count++) sum += _t[_INDEX(i, j)];
+            _tCoarse[_COARSE(I, J)] = count > 0 ? sum / count : outside;
         }
+}
+
+void Kobayashi::setThermalGrid(int ratio, int pad) {
+    _snapshot.stepCount = -1;
+    ratio = std::max(1, ratio);
+    pad = (ratio > 1 && _boundary != Boundary::Periodic) ? std::max(0, pad) : 0;
+
+    // 双分辨率只支持 Single 精度；现有的温度场先回到细网格
+    if (ratio > 1) setPrecision(Precision::Single);
+    if (_thermalRatio > 1) {
+        fillHalo2D(_tCoarse, _thermalCount.x, _thermalCount.y, _boundary, _tBoundary);
+        _prolongTemperature();
+    }
+    _thermalRatio = ratio;
+    _thermalPad = pad;
+    _allocateNextBuffers();
+    if (ratio == 1) {
+        _thermalCount = { 0, 0 };
+        std::vector<float>().swap(_tCoarse);
+        std::vector<float>().swap(_tCoarseNext);
+        return;
     }
+
+    _thermalCount = { coarseCount(_objectCount.x, ratio, pad), coarseCount(_objectCount.y, ratio, pad) };
+    coarseInterpolation(_objectCount.x, ratio, pad, _thermalIndexX, _thermalWeightX);
+    coarseInterpolation(_objectCount.y, ratio, pad, _thermalIndexY, _thermalWeightY);
+    size_t size = (size_t)(_thermalCount.x + 2) * (_thermalCount.y + 2);
+    _tCoarse.assign(size, 0.0f);
+    _tCoarseNext.assign(size, 0.0f);
+    _restrictTemperature();
+    _tilesDirty = true;
 }
 
 // 主更新循环
 void Kobayashi::update() {
     if (!_updateFlag) return; // 如果暂停则不计算
 
-    // 为了加快视觉效果，每一帧渲染前，我们计算 10 次物理步骤
-    for (int i = 0; i < 10; i++) {
-        _computeGradientLaplacian();
-        _evolution();
-    }
-    _updateTexture(); // 计算完后，准备将数据传给显卡
+    // 为了加快视觉效果，每一帧渲染前，我们计算 10 次物理步骤；满足停止条件时暂停
+    step(10);
+    if (_stopReason != StopReason::None) _updateFlag = false;
 }
 
 void Kobayashi::reset() {
     _vectorInit();
 }
 
+// 切换时间推进方式，Jacobi 模式需要额外的 _phiNext/_tNext（Fused 内核总是双缓冲）
+void Kobayashi::setUpdateMode(UpdateMode mode) {
+    _updateMode = mode;
+    _allocateNextBuffers();
+}
+
+// 幽灵格在每步开始前填一次，本步内 _phi/_t 不再变化（新值写入 _phiNext/_tNext 或只改格子自身）
+// Dirichlet 边界：网格外是 phi = 0、t = tBoundary 的液体浴
+void Kobayashi::_fillHalo() {
+    switch (_precision) {
+    case Precision::Half: _fillHalo(_halfFields.phi, _halfFields.t); break;
+    case Precision::BFloat16: _fillHalo(_bfloat16Fields.phi, _bfloat16Fields.t); break;
+    case Precision::Double: _fillHalo(_doubleFields.phi, _doubleFields.t); break;
+    default: _fillHalo(_phi, _t); break;
+    }
+}
+
+template <class S>
+void Kobayashi::_fillHalo(std::vector<S>& phi, std::vector<S>& t) {
+    fillHalo2D(phi, _objectCount.x, _objectCount.y, _boundary, 0.0f);
+    fillHalo2D(t, _objectCount.x, _objectCount.y, _boundary, _tBoundary);
+}
+
+// 导数没有"固定值"的含义，非周期边界时一律复制相邻的内部格
+void Kobayashi::_fillDerivedHalo() {
+    Boundary b = (_boundary == Boundary::Periodic) ? Boundary::Periodic : Boundary::Neumann;
+    std::vector<float>* derived[] = { &_epsilon, &_epsilonDeriv, &_gradPhiX, &_gradPhiY };
+    for (std::vector<float>* v : derived) fillHalo2D(*v, _objectCount.x, _objectCount.y, b);
+}
+
+// 只导出内部格，行优先
+void Kobayashi::exportPhi(std::vector<float>& out) const {
+    out.resize((size_t)_objectCount.x * _objectCount.y);
+    for (int j = 0; j < _objectCount.y; j++)
+        for (int i = 0; i < _objectCount.x; i++)
+            out[(size_t)i + (size_t)_objectCount.x * j] = _phiValue(_INDEX(i, j));
+}
+
+// 代数路径只覆盖 4 次和 6 次对称，其它各向异性模数（包括非整数）仍用三角函数
+bool Kobayashi::_algebraicAnisotropy() const {
+    return _anisotropyMode == AnisotropyMode::Algebraic && (_anisotropy == 4.0f || _anisotropy == 6.0f);
+}
+
+// 代数路径：由 n 个梯度计算 epsilon 和 epsilonDeriv
+// float 的行有 SIMD 内核时交给内核，结果与标量代码逐位相同（只有乘除和开方）
+template <class R>
+void Kobayashi::_anisotropyRow(int n, const R* gradX, const R* gradY, R* eps, R* epsDeriv) const {
+    if (_simd && simdData(eps)) {
+        SimdAnisotropyRow2D row = { simdData(gradX), simdData(gradY), simdData(eps), simdData(epsDeriv), n, (int)_anisotropy, _epsilonBar, _delta };
+        _simd->anisotropyRow2D(row);
+        return;
+    }
+    if (_anisotropy == 4.0f) algebraicAnisotropyRow<4>(n, gradX, gradY, _epsilonBar, _delta, eps, epsDeriv);
+    else algebraicAnisotropyRow<6>(n, gradX, gradY, _epsilonBar, _delta, eps, epsDeriv);
+}
+
+// 切换每步的计算方式，两种内核需要的缓冲区不同
+void Kobayashi::setKernel(Kernel kernel) {
+    _kernel = kernel;
+    _tilesDirty = true;
+    _allocateDerivedBuffers();
+    _allocateNextBuffers();
+    _allocateSpectralBuffers();
+}
+
+// 只有 TwoPass 内核需要全场导数（Single 以外的精度不用 TwoPass）
+void Kobayashi::_allocateDerivedBuffers() {
+    size_t size = (size_t)(_objectCount.x + 2) * (_objectCount.y + 2);
+    std::vector<float>* derived[] = { &_gradPhiX, &_gradPhiY, &_lapPhi, &_lapT, &_epsilon, &_epsilonDeriv };
+    for (std::vector<float>* v : derived) {
+        if (_kernel == Kernel::TwoPass && _precision == Precision::Single) v->assign(size, 0.0f);
+        else std::vector<float>().swap(*v);
+    }
+}
+
+// 双分辨率和 Single 以外的精度总是用 Fused 的扫描；后者的双缓冲在 FieldSet 中
+void Kobayashi::_allocateNextBuffers() {
+    size_t size = (size_t)(_objectCount.x + 2) * (_objectCount.y + 2);
+    bool single = _precision == Precision::Single;
+    bool fused = _kernel != Kernel::TwoPass || _thermalRatio > 1 || !single;
+    if (single && (_updateMode == UpdateMode::Jacobi || fused)) {
+        _phiNext.assign(size, 0.0f);
+        _tNext.assign(size, 0.0f);
+    } else {
+        std::vector<float>().swap(_phiNext);
+        std::vector<float>().swap(_tNext);
+    }
+    if (fused) _anglNext.assign(_angl.size(), 0.0f);
+    else std::vector<float>().swap(_anglNext);
+}
+
+// 重新创建线程池，threads <= 0 表示使用全部核心
+void Kobayashi::setThreadCount(int threads) {
+    _pool = std::make_shared<ThreadPool>(threads);
+}
+
+// 请求的指令集超过 CPU 支持的级别时降到 CPU 支持的最高级别
+void Kobayashi::setSimd(SimdLevel level) {
+    _simd = simdKernels(level);
+    _simdLevel = level;
+}
+
+// 按名字修改物理常数，供批处理程序从命令行或配置文件传入
+bool Kobayashi::setParam(const std::string& name, float value) {
+    if (name == "tau") _tau = value;
+    else if (name == "epsilonBar") _epsilonBar = value;
+    else if (name == "mu") _mu = value;
+    else if (name == "K") _K = value;
+    else if (name == "delta") _delta = value;
+    else if (name == "anisotropy") _anisotropy = value;
+    else if (name == "alpha") _alpha = value;
+    else if (name == "gamma") _gamma = value;
+    else if (name == "tEq") _tEq = value;
+    else if (name == "tBoundary") _tBoundary = value;
+    else if (name == "bandTol") _bandTol = value;
+    else if (name == "cfl") _cfl = value;
+    else if (name == "dx") _dx = value;
+    else if (name == "dy") _dy = value;
+    else return false;
+    _tilesDirty = true; // 参数变化后静止的块也可能开始演化
+    return true;
+}
+
 // ==========================================
-// 图形渲染部分 (OpenGL)
+// 存储精度
 // ==========================================
 
-// 初始化 OpenGL 纹理设置
-void Kobayashi::glInit() {
-    glEnable(GL_TEXTURE_2D); // 开启 2D 纹理功能
-    glGenTextures(1, &_textureID); // 申请一个纹理 ID
-    glBindTexture(GL_TEXTURE_2D, _textureID); // 绑定这个 ID 为当前操作对象
+void Kobayashi::setPrecision(Precision precision) {
+    if (_thermalRatio > 1) precision = Precision::Single;
+    if (precision == _precision) return;
 
-    // 设置纹理过滤方式 (Linear = 线性插值，图像放大时会模糊平滑，而不是马赛克)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    // 设置纹理包裹方式 (Clamp = 边缘拉伸，防止纹理重复平铺)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    // 先回到 float，再转换成新的存储类型
+    _convertFields(false);
+    _precision = precision;
+    _convertFields(true);
+    _allocateDerivedBuffers();
+    _allocateNextBuffers();
+    _tilesDirty = true;
 }
 
-// 将模拟数据 (_phi) 转换为颜色数据 (_pixelBuffer) 并上传到显卡
-void Kobayashi::_updateTexture()
+// pack 为 true 时把 _phi/_t 转换成当前精度的 FieldSet，否则转换回来；Single 时什么也不做
+void Kobayashi::_convertFields(bool pack) {
+    _snapshot.stepCount = -1; // 快照按转换前的存放方式保存
+    switch (_precision) {
+    case Precision::Half: if (pack) _packFields<Half>(); else _unpackFields<Half>(); break;
+    case Precision::BFloat16: if (pack) _packFields<BFloat16>(); else _unpackFields<BFloat16>(); break;
+    case Precision::Double: if (pack) _packFields<double>(); else _unpackFields<double>(); break;
+    default: break;
+    }
+}
+
+template <class S>
+void Kobayashi::_packFields() {
+    FieldSet<S>& f = _fieldSet<S>();
+    narrowField(_phi, f.phi);
+    narrowField(_t, f.t);
+    f.phiNext.assign(f.phi.size(), FieldTraits<S>::store(0.0f));
+    f.tNext.assign(f.t.size(), FieldTraits<S>::store(0.0f));
+    std::vector<float>* single[] = { &_phi, &_t, &_phiNext, &_tNext };
+    for (std::vector<float>* v : single) std::vector<float>().swap(*v);
+}
+
+template <class S>
+void Kobayashi::_unpackFields() {
+    FieldSet<S>& f = _fieldSet<S>();
+    widenField(f.phi, _phi);
+    widenField(f.t, _t);
+    std::vector<S>* packed[] = { &f.phi, &f.t, &f.phiNext, &f.tNext };
+    for (std::vector<S>* v : packed) std::vector<S>().swap(*v);
+}
+
+float Kobayashi::_phiValue(int index) const {
+    switch (_precision) {
+    case Precision::Half: return FieldTraits<Half>::load(_halfFields.phi[index]);
+    case Precision::BFloat16: return FieldTraits<BFloat16>::load(_bfloat16Fields.phi[index]);
+    case Precision::Double: return (float)_doubleFields.phi[index];
+    default: return _phi[index];
+    }
+}
+
+// ==========================================
+// 颜色映射（渲染前的 CPU 部分）
+// ==========================================
+
+// 将模拟数据 (_phi) 转换为颜色数据 (_pixelBuffer)
+void Kobayashi::_fillPixelBuffer()
 {
     // 定义颜色 (RGB格式, 范围 0.0-1.0)
     struct float3 { float x, y, z; };
@@ -230,12 +1415,12 @@ void Kobayashi::_updateTexture()
     float c1Boundary = 0.9f;
     float c2Boundary = 0.99f;
 
-    size_t size = _phi.size();
-    
-    // 遍历每一个格子
-    for (size_t k = 0; k < size; k++)
+    // 遍历每一个内部格子（跳过幽灵格），k 是像素下标
+    for (int j = 0; j < _objectCount.y; j++)
+    for (int i = 0; i < _objectCount.x; i++)
     {
-        float phi = _phi[k]; // 获取当前格子的状态 (0.0 - 1.0)
+        size_t k = (size_t)i + (size_t)_objectCount.x * j;
+        float phi = _phiValue(_INDEX(i, j)); // 获取当前格子的状态 (0.0 - 1.0)
         float3 color;
         float ratio;
 
@@ -278,49 +1463,4 @@ void Kobayashi::_updateTexture()
         _pixelBuffer[k * 4 + 2] = toByte(color.z);
         _pixelBuffer[k * 4 + 3] = 255; // Alpha = 255 (不透明)
     }
-
-    // --- 上传纹理到 GPU ---
-    glBindTexture(GL_TEXTURE_2D, _textureID);
-    // glTexImage2D 参数解释：
-    // GL_TEXTURE_2D: 目标类型
-    // 0: Mipmap 层级 (0是原图)
-    // GL_RGBA: 显卡内部存储格式
-    // width, height: 纹理尺寸
-    // 0: 边框 (必须是0)
-    // GL_RGBA: 我们提供的数据格式
-    // GL_UNSIGNED_BYTE: 我们提供的数据类型 (uchar)
-    // data: 数据指针
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _objectCount.x, _objectCount.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, _pixelBuffer.data());
-}
-
-// 实际的绘制函数，每帧调用一次
-void Kobayashi::glRender() {
-    // 1. 清除屏幕颜色
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    // 2. 绑定我们要使用的纹理
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, _textureID);
-    
-    // 设置绘制颜色为白色 (这样纹理会保持原色，不会被染色)
-    glColor3f(1.0f, 1.0f, 1.0f);
-
-    // 3. 绘制一个四边形 (Quad)，充满整个视口
-    // OpenGL 的坐标系：中心是 (0,0)，左下是 (-1,-1)，右上是 (1,1)
-    // 纹理坐标 (TexCoord)：左下是 (0,0)，右上是 (1,1)
-    // 我们的任务是将纹理的四个角对应到四边形的四个角上
-    glBegin(GL_QUADS);
-        // 左下角
-        glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, -1.0f);
-        // 右下角
-        glTexCoord2f(1.0f, 0.0f); glVertex2f( 1.0f, -1.0f);
-        // 右上角
-        glTexCoord2f(1.0f, 1.0f); glVertex2f( 1.0f,  1.0f);
-        // 左上角
-        glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f,  1.0f);
-    glEnd();
-    
-    // 4. 交换缓冲区 (Double Buffering)
-    // 我们在一个隐藏的缓冲区画画，画好后瞬间交换到前台显示，防止闪烁
-    glutSwapBuffers(); 
-}
\ No newline at end of file
+}
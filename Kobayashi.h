@@ -1,11 +1,17 @@
 #pragma once
 #include <vector>
+#include <string>
 #include <cmath>
 #include <ctime>
 #include <iostream>
-#include <GL/freeglut.h> 
+#include <memory>
+#include <climits>
+#include <mutex>
+#include "KobayashiCommon.h"
+#include "ThreadPool.h"
+#include "FFT.h"
 
-const float PI_F = 3.14159265358979f;
+struct SimdKernels;
 
 class Kobayashi
 {
@@ -17,34 +23,280 @@ public:
     void update();
     void reset();
 
-    // 渲染逻辑
+    // 无窗口批处理接口：推进 steps 个物理步，不做任何渲染相关工作；满足停止条件时提前返回，返回 stepCount() 的增量。
+    // 看门狗回退时重新走回退掉的步
+    int step(int steps);
+    // 推进 duration 的物理时间，最后一步缩短到恰好到达；最多走 maxSteps 步（含回退前走过的步），返回所用的步数
+    int advance(double duration, int maxSteps = INT_MAX);
+
+    // 生长诊断（见 GrowthStats）：打开后每步统计固相面积、界面格数、固相在两个方向的范围和温度的最值，
+    // growthStats() 是最近一步结束时的值。Fused 扫描（含 NarrowBand、Single 以外的精度和时间分块）写完一段行后顺带统计；
+    // TwoPass、周期边界的 Spectral、子循环和双分辨率在步末单独读一遍场，双分辨率时温度的最值取粗网格
+    void setDiagnostics(bool enabled) { _diagnostics = enabled; }
+    bool diagnostics() const { return _diagnostics || _monitor.active() || _watchdog.interval > 0; }
+    const GrowthStats& growthStats() const { return _stats; }
+
+    // 自动停止条件（见 StopConditions），设置任何条件时同时打开生长诊断。
+    // step()/advance() 在满足条件的那一步之后返回，stopReason() 是最近一次调用提前返回的原因；update() 此时暂停。
+    // 时间分块时每 depth 步检查一次
+    void setStopConditions(const StopConditions& conditions) { _monitor.setConditions(conditions); }
+    const GrowthMonitor& growthMonitor() const { return _monitor; }
+    StopReason stopReason() const { return _stopReason; }
+
+    // 发散看门狗（见 WatchdogSettings），interval > 0 时打开，同时打开生长诊断：每步用诊断的统计量检查 NaN/Inf
+    // 和 phi、t 的范围，不另外遍历场（时间分块时每 depth 步检查一次）。每隔 interval 步把状态场复制一份到内存，
+    // 发散时回到这份快照，dt（Adaptive/Subcycled 时是 cfl）减半后继续，每次回退记入 rollbacks()；
+    // 从同一快照回退 maxRetries 次仍发散时停在快照处，stopReason() 为 Diverged
+    void setWatchdog(const WatchdogSettings& settings) { _watchdog = settings; _snapshot = Snapshot(); }
+    const WatchdogSettings& watchdog() const { return _watchdog; }
+    const std::vector<RollbackEvent>& rollbacks() const { return _rollbacks; }
+
+    // 时间步长控制（见 TimeStepping）：默认 Fixed；Adaptive/Subcycled 的安全系数是参数 cfl。
+    // Subcycled 只用于 Fused 内核，其它内核按 Adaptive 推进；周期边界的 Spectral 内核不需要显式稳定上限，总是按 Fixed 推进
+    void setTimeStepping(TimeStepping mode) { _timeStepping = mode; }
+    TimeStepping timeStepping() const { return _timeStepping; }
+    // 按当前参数计算相场和温度场各自的显式稳定上限（未乘 cfl）
+    void stableTimeSteps(float& dtPhi, float& dtT) const;
+
+    // 时间推进方式：InPlace 直接覆盖 _phi/_t；Jacobi 双缓冲，新值只由上一步的场计算
+    enum class UpdateMode { InPlace, Jacobi };
+    void setUpdateMode(UpdateMode mode);
+    UpdateMode updateMode() const { return _updateMode; }
+
+    // 每步的计算方式：Fused 单次扫描，只保留滚动的三行导数；TwoPass 先算全场导数再演化（参考实现）
+    // NarrowBand 与 Fused 相同，但网格按 _tileSize 分块，只计算界面或温度前沿附近的活跃块，
+    // 静止的块（phi 全部在 bandTol 以内接近 0 或 1，且温度的极差不超过 bandTol）保持不变
+    // Spectral 是周期边界下的半隐式格式：先用 Fused 求出显式增量，再在 Fourier 空间隐式处理扩散项，
+    // dt 不受显式稳定上限限制（总是使用构造时的 dt）；非周期边界时按 Fused 推进
+    enum class Kernel { Fused, TwoPass, NarrowBand, Spectral };
+    void setKernel(Kernel kernel);
+    Kernel kernel() const { return _kernel; }
+
+    // 各向异性的计算方式：Algebraic 由归一化梯度的多项式直接得到 cos(nθ)、sin(nθ)，
+    // 只支持 anisotropy = 4 或 6，其它模数自动使用 Trig（atan 求角度后调用 cos/sin 的原始实现）
+    // 代数路径不需要上一步的角度，梯度接近 0 的格子方向角取 0
+    enum class AnisotropyMode { Algebraic, Trig };
+    void setAnisotropyMode(AnisotropyMode mode) { _anisotropyMode = mode; _tilesDirty = true; }
+    AnisotropyMode anisotropyMode() const { return _anisotropyMode; }
+
+    // 边界条件：Periodic（默认）、Neumann 零通量、Dirichlet（幽灵格 phi = 0，t = tBoundary，即恒定过冷度的液体浴）
+    void setBoundary(Boundary boundary) { _boundary = boundary; _tilesDirty = true; }
+    Boundary boundary() const { return _boundary; }
+
+    // 双分辨率：温度场放在每个方向粗 ratio 倍的网格上（ratio = 1 表示与相场同一网格），
+    // 非周期边界时粗网格在相场网格外每侧再多 pad 个粗格，温度区域可以比相场区域大得多（在 setBoundary() 之后调用）。
+    // ratio > 1 时每步用 Fused 的相场扫描（kernel 设置不起作用，Subcycled 按 Adaptive 推进）：
+    // 驱动力中的温度由粗网格双线性插值到 _t，潜热 K·Δφ 平均到粗格上，扩散在粗网格上计算。
+    // 切换时现有的温度场在两种网格之间转换
+    void setThermalGrid(int ratio, int pad = 0);
+    int thermalRatio() const { return _thermalRatio; }
+
+    // 相场和温度场的存储精度（见 Precision）：Single 以外的精度每步都用 Fused 内核推进
+    // （kernel 设置不起作用，Subcycled 按 Adaptive 推进），_angl 仍是 float。
+    // 双分辨率时只支持 Single，设置其它精度不起作用。切换时现有的场在两种存储类型之间转换
+    void setPrecision(Precision precision);
+    Precision precision() const { return _precision; }
+
+    // 显式向量化的行内核（见 Simd.h）：默认使用 CPU 支持的最高指令集，超过 CPU 支持的级别自动降级，Scalar 使用原来的标量代码。
+    // 覆盖 Single 精度下 Fused 扫描（包括 NarrowBand 和子循环）的梯度、代数各向异性和演化；TwoPass 内核的演化仍是标量的参考实现。
+    // 各指令集的结果逐位相同，与 Scalar 的差别只来自驱动力中 atan 的多项式近似
+    void setSimd(SimdLevel level);
+    SimdLevel simd() const { return _simdLevel; }
+
+    // 时间分块：step() 把连续 depth 步按行块的波前推进（见 wavefront()），一个行块在缓存中连续走完 depth 步，
+    // 大网格上不再每步都把整个场从内存读写一遍；depth = 1 表示逐步推进，两者的结果逐位相同。
+    // 只用于 Fixed 时间步长、Fused 内核（或 Single 以外的精度）、Algebraic 各向异性和单一网格的温度场，
+    // 其余情况以及行数少于 4·depth 时仍逐步推进；advance() 总是逐步推进
+    void setTemporalBlocking(int depth) { _blockDepth = std::max(1, depth); }
+    int temporalBlocking() const { return _blockDepth; }
+
+    // 求解器按行并行，threads <= 0 表示使用全部核心；结果与线程数无关
+    void setThreadCount(int threads);
+    int threadCount() const { return _pool->size(); }
+
+    // 按名字修改 _initParams() 中的物理常数（以及 dx/dy、NarrowBand 的 bandTol、时间步长的 cfl），名字不存在时返回 false
+    bool setParam(const std::string& name, float value);
+
+    // 渲染逻辑（实现在 KobayashiGL.cpp，批处理程序不需要链接）
     void glInit();
     void glRender();
+    void glRelease();
 
     // 简单的控制接口
     void togglePause() { _updateFlag = !_updateFlag; }
     bool isPaused() const { return !_updateFlag; }
 
+    // 查询接口
+    int width() const { return _objectCount.x; }
+    int height() const { return _objectCount.y; }
+    long long stepCount() const { return _stepCount; }
+    double time() const { return _time; }           // 已推进的物理时间
+    float timeStep() const { return _stepDt; }      // 最近一步的 dt
+    int substeps() const { return _substeps; }      // 最近一步中被子循环的场走的小步数，1 表示没有子循环
+    bool phaseSubcycled() const { return _phaseSubcycled; } // 最近一步子循环的是相场（否则是温度场）
+    float activeTileFraction() const; // NarrowBand 内核最近一步计算的块占全部块的比例，其它内核为 1
+    void exportPhi(std::vector<float>& out) const; // 只导出内部格，nx × ny
+
 private:
+    friend struct KobayashiBench; // 基准测试需要单独调用每个求解阶段
+
     // 模拟参数保持不变
     struct int2 { int x; int y; };
     int2 _objectCount = { 0, 0 };
-    inline int _INDEX(int i, int j) { return (i + _objectCount.x * j); };
+    // 场数组四周各多一圈幽灵格，内部格 (i, j) ∈ [0, nx) × [0, ny)，幽灵格坐标为 -1 和 nx/ny
+    inline int _INDEX(int i, int j) const { return (i + 1) + (_objectCount.x + 2) * (j + 1); };
 
     float _dx, _dy, _dt;
+    float _fixedDt;            // 构造时给定的 dt，Fixed 模式每步使用
+    float _dtT;                // 本次扫描中温度场的步长，只有子循环时与 _dt（相场的步长）不同
+    float _latentShare = 1.0f; // 温度场子循环时每个小步分到的潜热比例
+    float _cfl = 0.7f;         // Adaptive/Subcycled 的安全系数
+    TimeStepping _timeStepping = TimeStepping::Fixed;
     float _tau, _epsilonBar, _mu, _K, _delta, _anisotropy, _alpha, _gamma, _tEq;
+    float _tBoundary = 0.0f; // Dirichlet 边界的温度
+    float _bandTol = 1e-6f;  // NarrowBand 内核判断块是否静止的容差
+    Boundary _boundary = Boundary::Periodic;
+
+    // _angl 也是状态：Trig 路径中梯度接近 0 的格子沿用上一步的角度
+    std::vector<float> _phi, _t, _angl;
+    long long _stepCount = 0;
+    double _time = 0.0;
+    float _stepDt = 0.0f;
+    int _substeps = 1;
+    bool _phaseSubcycled = false;
+
+    // TwoPass 内核的全场导数，Fused 内核不分配
+    std::vector<float> _epsilon, _epsilonDeriv, _gradPhiX, _gradPhiY, _lapPhi, _lapT;
+
+    // Jacobi 模式和 Fused 内核的双缓冲：新一步的 _phi/_t（Fused 还有 _angl）写在这里，整步完成后交换
+    std::vector<float> _phiNext, _tNext, _anglNext;
+    UpdateMode _updateMode = UpdateMode::InPlace;
+    Kernel _kernel = Kernel::Fused;
+    AnisotropyMode _anisotropyMode = AnisotropyMode::Algebraic;
+    std::shared_ptr<ThreadPool> _pool;
+    SimdLevel _simdLevel = SimdLevel::Scalar;
+    const SimdKernels* _simd = nullptr; // Scalar 时为空
+    int _blockDepth = 1;                // 时间分块的步数
+
+    // 生长诊断：_stepStats 在一步内由各个任务合并，步末存入 _stats
+    bool _diagnostics = false;
+    GrowthStats _stats, _stepStats;
+    std::mutex _statsLock;
+    GrowthMonitor _monitor;
+    StopReason _stopReason = StopReason::None;
+
+    // NarrowBand 内核的活跃块
+    static constexpr int _tileSize = 16;
+    int _tilesX = 0, _tilesY = 0;
+    std::vector<unsigned char> _tileBusy;    // 块本身（含外面一圈格子）不静止
+    std::vector<unsigned char> _tileActive;  // 本步要计算的块：_tileBusy 向四周扩展一块
+    std::vector<unsigned char> _tileStepped; // 上一步计算过的块，它的 Next 缓冲与当前值不同
+    bool _tilesDirty = true;                 // 需要重新检查所有块（重置、改参数或边界之后）
+
+    // Spectral 内核：两个方向的 FFT、9 点拉普拉斯算子在各个波数上的 cos 表，
+    // 以及打包成复数的增量（实部是相场，虚部是温度场）及其滤波结果，其它内核不分配
+    FFT _fftX, _fftY;
+    std::vector<float> _cosX, _cosY;
+    std::vector<std::complex<float>> _spectrum, _filtered;
+
+    // 双分辨率温度场：粗网格的温度及其双缓冲（含幽灵格），以及细格到粗格的插值表；ratio = 1 时为空
+    int _thermalRatio = 1, _thermalPad = 0;
+    int2 _thermalCount = { 0, 0 };
+    std::vector<float> _tCoarse, _tCoarseNext;
+    std::vector<int> _thermalIndexX, _thermalIndexY;
+    std::vector<float> _thermalWeightX, _thermalWeightY;
+    inline int _COARSE(int i, int j) const { return (i + 1) + (_thermalCount.x + 2) * (j + 1); }
+
+    // Single 以外的精度：_phi/_t 及其双缓冲按存储类型 S 存放在对应的 FieldSet 中，
+    // 此时 _phi/_t/_phiNext/_tNext 为空；内核通过 FieldPtrs 访问两种存放方式
+    Precision _precision = Precision::Single;
+    template <class S> struct FieldSet { std::vector<S> phi, t, phiNext, tNext; };
+    template <class S> struct FieldPtrs { S *phi, *t, *phiNext, *tNext; };
+    FieldSet<Half> _halfFields;
+    FieldSet<BFloat16> _bfloat16Fields;
+    FieldSet<double> _doubleFields;
+    template <class S> FieldSet<S>& _fieldSet();
+    template <class S> FieldPtrs<S> _fieldPtrs();
+
+    // 发散看门狗：快照是状态场（Single 以外的精度时是 FieldSet 的 phi、t）以及步数、时间和诊断，stepCount < 0 表示没有快照；
+    // _divergence 是最近一步发散的原因，_retries 是从当前快照连续回退的次数
+    struct Snapshot
+    {
+        std::vector<float> phi, t, angl, tCoarse;
+        FieldSet<Half> half;
+        FieldSet<BFloat16> bfloat16;
+        FieldSet<double> dbl;
+        long long stepCount = -1;
+        double time = 0.0;
+        float stepDt = 0.0f;
+        GrowthStats stats;
+        GrowthMonitor monitor;
+    };
+    WatchdogSettings _watchdog;
+    Snapshot _snapshot;
+    const char* _divergence = nullptr;
+    int _retries = 0;
+    std::vector<RollbackEvent> _rollbacks;
 
-    std::vector<float> _phi, _t, _epsilon, _epsilonDeriv, _gradPhiX, _gradPhiY, _lapPhi, _lapT, _angl;
-    
     // OpenGL 纹理
     std::vector<unsigned char> _pixelBuffer;
-    GLuint _textureID = 0;
+    unsigned int _textureID = 0;
+    bool _textureDirty = true; // 场数据变化后需要重新上传纹理
     bool _updateFlag = true;
 
     void _initParams();
     void _vectorInit();
     void _createNucleus(int x, int y);
+    void _allocateNextBuffers();
+    void _allocateDerivedBuffers();
+    void _fillHalo();        // 每步开始前按边界条件填充 _phi/_t 的幽灵格
+    template <class S> void _fillHalo(std::vector<S>& phi, std::vector<S>& t);
+    void _fillDerivedHalo(); // TwoPass 内核：填充邻居要读取的导数的幽灵格
     void _computeGradientLaplacian();
+    void _computeGradientLaplacianRows(int j0, int j1);
     void _evolution();
-    void _updateTexture();
-};
\ No newline at end of file
+    void _evolutionRows(int j0, int j1);
+    void _advanceStep(float maxDt); // 推进一步，dt 不超过 maxDt
+    void _fusedStep();
+    bool _temporalBlock(int depth); // 时间分块推进 depth 步，不满足条件时返回 false
+    template <class S> bool _blockedSteps(int depth);
+    template <class S> void _swapNext(); // 交换当前值和 Next 缓冲
+    template <class S> void _measureRows(const S* phi, const S* t, int j0, int j1, int i0, int i1); // [j0, j1) 行 [i0, i1) 列计入 _stepStats
+    void _mergeStats(const GrowthStats& s); // 一个任务的局部统计加锁合并到 _stepStats
+    void _measureField();                // 不经过 Fused 扫描的推进方式：步末单独统计 _phi/_t
+    void _finishStats();                 // 步末：保存统计，检查发散和停止条件
+    void _saveSnapshot();                // 看门狗：距上一个快照满 interval 步时保存当前状态
+    void _rollback();                    // 看门狗：回到快照，dt 减半
+    template <class S> static void _copyState(FieldSet<S>& to, const FieldSet<S>& from) { to.phi = from.phi; to.t = from.t; }
+    template <class S> void _packedFusedStep(); // Single 以外的精度：FieldSet<S> 上的 _fusedStep()
+    // Temperature 为 false 时只推进相场，潜热累加到 _tNext；measure 时计入生长诊断
+    template <bool Temperature, class S = float> void _fusedPass(bool measure = false);
+    template <class R> struct RowWindow { std::vector<R> eps, epsDeriv, gradX, gradY; int row = INT_MIN; }; // _fusedBlock() 的三行滚动导数，row 是最后算好的行
+    // stats 非空时每写完一行就计入生长诊断（Temperature 为 false 时不统计温度）
+    template <bool Temperature, class S = float>
+    void _fusedBlock(const FieldPtrs<S>& f, int j0, int j1, int i0, int i1, RowWindow<typename FieldTraits<S>::Real>* window = nullptr,
+                     GrowthStats* stats = nullptr);
+    void _subcycleTemperature(float dt, int substeps);
+    void _subcyclePhase(float dt, int substeps);
+    void _temperatureRows(int j0, int j1); // 温度场的一个小步：扩散加上本步潜热的 _latentShare
+    void _allocateSpectralBuffers();
+    void _spectralStep();
+    void _fft2D(std::vector<std::complex<float>>& data, bool inverse);
+    void _narrowBandStep();
+    void _dualGridStep();         // ratio > 1：细网格上的相场扫描加粗网格上的温度步
+    void _prolongTemperature();   // 粗网格温度双线性插值到 _t 的内部格
+    void _restrictTemperature();  // _t 平均到粗网格（setThermalGrid() 转换现有的温度场）
+    void _updateActiveTiles();
+    bool _tileBusyAt(int tx, int ty) const;
+    void _copyTile(int tx, int ty);
+    bool _algebraicAnisotropy() const;
+    template <class R> void _anisotropyRow(int n, const R* gradX, const R* gradY, R* eps, R* epsDeriv) const;
+    template <class S, class R>
+    void _deriveRow(const FieldPtrs<S>& f, int j, bool owned, int i0, int i1, R* eps, R* epsDeriv, R* gradX, R* gradY);
+    void _convertFields(bool pack);          // 在 _phi/_t 与当前精度的 FieldSet 之间转换
+    template <class S> void _packFields();   // _phi/_t 转换成 FieldSet<S>，释放 float 的场
+    template <class S> void _unpackFields(); // FieldSet<S> 转换回 _phi/_t
+    float _phiValue(int index) const;        // 任意精度下 _phi 在数组下标 index 处的值
+    void _fillPixelBuffer(); // 把 _phi 映射成颜色，写入 _pixelBuffer（纯 CPU 计算）
+    void _updateTexture();   // _fillPixelBuffer() 之后上传到显卡
+};
@@ -1,5 +1,7 @@
 #include "Kobayashi3D.h"
+#include "Simd.h"
 #include <cfloat> // 包含 FLT_EPSILON，用于浮点数比较，防止除以零
+#include <algorithm>
 
 // ==========================================
 // 角度处理辅助函数
@@ -7,8 +9,9 @@
 
 // 计算两个角度的差分，处理2π周期性
 // 返回值在 [-π, π] 范围内
-inline float angleDifference(float angle_plus, float angle_minus) {
-    float diff = angle_plus - angle_minus;
+template <class R>
+inline R angleDifference(R angle_plus, R angle_minus) {
+    R diff = angle_plus - angle_minus;
 
     // 将差分规范化到 [-π, π] 范围
     while (diff > PI_F) {
@@ -26,8 +29,9 @@ inline float angleDifference(float angle_plus, float angle_minus) {
 // ==========================================
 
 // 计算叉积：k = u_ori × u0，其中 u0 = (0, 0, 1)
-inline void crossProduct(float u_ori_x, float u_ori_y, float u_ori_z,
-                         float& k_x, float& k_y, float& k_z) {
+template <class R>
+inline void crossProduct(R u_ori_x, R u_ori_y, R u_ori_z,
+                         R& k_x, R& k_y, R& k_z) {
     // u0 = (0, 0, 1)
     // k = u_ori × u0 = (u_ori_y, -u_ori_x, 0)
     k_x = u_ori_y;
@@ -36,9 +40,10 @@ inline void crossProduct(float u_ori_x, float u_ori_y, float u_ori_z,
 }
 
 // 计算反对称矩阵 K 与向量 u 的乘积：K·u
-inline void skewSymmetricProduct(float k_x, float k_y, float k_z,
-                                 float u_x, float u_y, float u_z,
-                                 float& result_x, float& result_y, float& result_z) {
+template <class R>
+inline void skewSymmetricProduct(R k_x, R k_y, R k_z,
+                                 R u_x, R u_y, R u_z,
+                                 R& result_x, R& result_y, R& result_z) {
     // K = [  0  -k_z  k_y ]
     //     [ k_z   0  -k_x ]
     //     [-k_y  k_x   0  ]
@@ -49,13 +54,14 @@ inline void skewSymmetricProduct(float k_x, float k_y, float k_z,
 }
 
 // 计算 K² 与向量 u 的乘积
-inline void skewSymmetricSquaredProduct(float k_x, float k_y, float k_z,
-                                        float u_x, float u_y, float u_z,
-                                        float& result_x, float& result_y, float& result_z) {
+template <class R>
+inline void skewSymmetricSquaredProduct(R k_x, R k_y, R k_z,
+                                        R u_x, R u_y, R u_z,
+                                        R& result_x, R& result_y, R& result_z) {
     // K² = -k·k^T + k×k (对于反对称矩阵)
     // 实际上：K²·u = (k·u)k - |k|²u
-    float k_dot_u = k_x * u_x + k_y * u_y + k_z * u_z;
-    float k_mag_sq = k_x * k_x + k_y * k_y + k_z * k_z;
+    R k_dot_u = k_x * u_x + k_y * u_y + k_z * u_z;
+    R k_mag_sq = k_x * k_x + k_y * k_y + k_z * k_z;
 
     result_x = k_dot_u * k_x - k_mag_sq * u_x;
     result_y = k_dot_u * k_y - k_mag_sq * u_y;
@@ -64,16 +70,17 @@ inline void skewSymmetricSquaredProduct(float k_x, float k_y, float k_z,
 
 // Rodrigues旋转公式：n_rot = (I + sinΘ·K + (1-cosΘ)·K²)·n
 // 其中 k = u_ori × u0，Θ = θ_ori
-inline void rodriguesRotation(float u_x, float u_y, float u_z,
-                              float u_ori_x, float u_ori_y, float u_ori_z,
-                              float theta_ori,
-                              float& u_rot_x, float& u_rot_y, float& u_rot_z) {
+template <class R>
+inline void rodriguesRotation(R u_x, R u_y, R u_z,
+                              R u_ori_x, R u_ori_y, R u_ori_z,
+                              R theta_ori,
+                              R& u_rot_x, R& u_rot_y, R& u_rot_z) {
     // 计算 k = u_ori × u0
-    float k_x, k_y, k_z;
+    R k_x, k_y, k_z;
     crossProduct(u_ori_x, u_ori_y, u_ori_z, k_x, k_y, k_z);
 
     // 归一化 k
-    float k_mag = sqrt(k_x * k_x + k_y * k_y + k_z * k_z);
+    R k_mag = sqrt(k_x * k_x + k_y * k_y + k_z * k_z);
     if (k_mag < FLT_EPSILON) {
         // u_ori 已经指向 z 轴，无需旋转
         u_rot_x = u_x;
@@ -86,16 +93,16 @@ inline void rodriguesRotation(float u_x, float u_y, float u_z,
     k_z /= k_mag;
 
     // 计算旋转角度 Θ = θ_ori
-    float sin_theta_ori = sin(theta_ori);
-    float cos_theta_ori = cos(theta_ori);
-    float one_minus_cos = 1.0f - cos_theta_ori;
+    R sin_theta_ori = sin(theta_ori);
+    R cos_theta_ori = cos(theta_ori);
+    R one_minus_cos = 1.0f - cos_theta_ori;
 
     // 计算 K·u
-    float Ku_x, Ku_y, Ku_z;
+    R Ku_x, Ku_y, Ku_z;
     skewSymmetricProduct(k_x, k_y, k_z, u_x, u_y, u_z, Ku_x, Ku_y, Ku_z);
 
     // 计算 K²·u
-    float K2u_x, K2u_y, K2u_z;
+    R K2u_x, K2u_y, K2u_z;
     skewSymmetricSquaredProduct(k_x, k_y, k_z, u_x, u_y, u_z, K2u_x, K2u_y, K2u_z);
 
     // n_rot = u + sinΘ·K·u + (1-cosΘ)·K²·u
@@ -104,29 +111,66 @@ inline void rodriguesRotation(float u_x, float u_y, float u_z,
     u_rot_z = u_z + sin_theta_ori * Ku_z + one_minus_cos * K2u_z;
 }
 
+// ==========================================
+// 拉普拉斯算子
+// ==========================================
+
+// 中心格 c 处的 ∇²f，f(n) 读取下标 n 处的值，sy、sz 是 ±y、±z 邻居的下标步长，h2 = Δx²。
+// points 是模板的点数（见 Kobayashi3D::LaplacianStencil）：
+//   7 点 ：(Σ面 - 6f)/h²，截断误差的主项 h²/12·Σ∂⁴f/∂x⁴ 随方向变化
+//   19 点：(2Σ面 + Σ棱 - 24f)/(6h²)
+//   27 点：(14Σ面 + 3Σ棱 + Σ角 - 128f)/(30h²)
+// 后两者的主项都是各向同性的 h²/12·∇⁴f，与 2D 的 9 点算子相同；面、棱、角邻居分别有 6、12、8 个
+template <class R, class Field>
+inline R stencilLaplacian(const Field& f, int c, int sy, int sz, int points, R h2)
+{
+    R faces = f(c + 1) + f(c - 1)
+            + f(c + sy) + f(c - sy)
+            + f(c + sz) + f(c - sz);
+    if (points == 7) return (faces - 6.0f * f(c)) / h2;
+
+    R edges = f(c + 1 + sy) + f(c - 1 + sy) + f(c + 1 - sy) + f(c - 1 - sy)
+            + f(c + 1 + sz) + f(c - 1 + sz) + f(c + 1 - sz) + f(c - 1 - sz)
+            + f(c + sy + sz) + f(c - sy + sz) + f(c + sy - sz) + f(c - sy - sz);
+    if (points == 19) return (2.0f * faces + edges - 24.0f * f(c)) / (6.0f * h2);
+
+    R corners = f(c + 1 + sy + sz) + f(c - 1 + sy + sz) + f(c + 1 - sy + sz) + f(c - 1 - sy + sz)
+              + f(c + 1 + sy - sz) + f(c - 1 + sy - sz) + f(c + 1 - sy - sz) + f(c - 1 - sy - sz);
+    return (14.0f * faces + 3.0f * edges + corners - 128.0f * f(c)) / (30.0f * h2);
+}
+
 // ==========================================
 // 构造函数与初始化
 // ==========================================
 
-Kobayashi::Kobayashi(int x, int y, int z, float timeStep) {
+Kobayashi3D::Kobayashi3D(int x, int y, int z, float timeStep, Storage storage) {
     _objectCount = { x, y, z }; // 3D 网格大小，例如 100x100x100
+    _fullCount = { x, y, z };
+    _storage = storage;
+    if (_storage == Storage::Adaptive) {
+        // 数组存放基础网格，细层的格子数向上取整为加密比的倍数
+        _objectCount = { (x + _amrRatio - 1) / _amrRatio, (y + _amrRatio - 1) / _amrRatio, (z + _amrRatio - 1) / _amrRatio };
+    }
     _dx = 0.03f; // x 方向空间步长
     _dy = 0.03f; // y 方向空间步长
     _dz = 0.03f; // z 方向空间步长
     _dt = timeStep; // 时间步长：每次模拟迭代推进的时间量
+    _fixedDt = timeStep;
+    _pool = std::make_shared<ThreadPool>(0); // 默认使用全部核心
+    setSimd(detectSimd());
 
     _initParams();  // 初始化物理参数
     _vectorInit();  // 分配内存并设置初始条件
 }
 
-Kobayashi::~Kobayashi() {
+Kobayashi3D::~Kobayashi3D() {
     // 析构函数
 }
 
 // 初始化 Kobayashi 晶体生长模型的物理常数
 // 这些参数决定了晶体的形状（六角形、树枝状等）和生长速度
 // 参考论文：Kobayashi, A. (1993) "Modeling and numerical simulations of dendritic crystal growth"
-void Kobayashi::_initParams() {
+void Kobayashi3D::_initParams() {
     // 弛豫时间 τ，控制相变速度（单位：无量纲）
     // 物理意义：越小相变越快，晶体生长越迅速
     _tau = 0.0003f;
@@ -171,64 +215,74 @@ void Kobayashi::_initParams() {
 }
 
 // 分配内存并重置模拟状态
-void Kobayashi::_vectorInit() {
-    size_t vSize = _objectCount.x * _objectCount.y * _objectCount.z;
+void Kobayashi3D::_vectorInit() {
+    _stepCount = 0;
+    _time = 0.0;
+    _hasFixedOrientation = false;
+    _stats = GrowthStats();
+    _monitor.reset();
+    _snapshot.stepCount = -1;
+
+    if (_storage != Storage::Dense) {
+        // 只建立砖块表（Adaptive 时覆盖细层），晶核所在的砖块由 _createNucleus() 分配，其余按需分配
+        for (int a = 0; a < 3; a++) {
+            int n = (a == 0) ? width() : (a == 1) ? height() : depth();
+            _bricksPerAxis[a] = (n + _brickSize - 1) / _brickSize;
+        }
+        _bricks.clear();
+        _bricks.resize((size_t)_bricksPerAxis[0] * _bricksPerAxis[1] * _bricksPerAxis[2]);
+        _brickList.clear();
+    }
+    if (_storage == Storage::Sparse) {
+        _createNucleus(width() / 2, height() / 2, depth() / 2);
+        return;
+    }
+
+    size_t vSize = (size_t)(_objectCount.x + 2) * (_objectCount.y + 2) * (_objectCount.z + 2); // 含幽灵格
 
     // _phi: 相场变量 (0=液, 1=固)
     // _t: 温度场
     _phi.assign(vSize, 0.0f);
     _t.assign(vSize, 0.0f);
 
-    // 相场梯度和拉普拉斯算子
-    _gradPhiX.assign(vSize, 0.0f);
-    _gradPhiY.assign(vSize, 0.0f);
-    _gradPhiZ.assign(vSize, 0.0f);
-    _lapPhi.assign(vSize, 0.0f);
-    _lapT.assign(vSize, 0.0f);
-
-    // 相场梯度模和局部方向角
-    _gradPhiMag.assign(vSize, 0.0f);
-    _tau_field.assign(vSize, 0.0f);
-    _theta.assign(vSize, 0.0f);
-    _phi_angle.assign(vSize, 0.0f);
+    // 下一步的相场和温度场
+    _phiNext.assign(vSize, 0.0f);
+    _tNext.assign(vSize, 0.0f);
 
-    // 各向异性系数及其导数
-    _epsilon.assign(vSize, 0.0f);
-    _epsilonDerivTheta.assign(vSize, 0.0f);
-    _epsilonDerivPhi.assign(vSize, 0.0f);
+    // 相场方程中需要在邻居处取值的各向异性量
+    _allocateDerived(_epsilon2, _fluxY, _fluxZ, _epsTauTheta, vSize);
 
     // 取向场：Ω_ori 用单位球上的点 (x, y, z) 表示
     // 初始化为指向 z 轴正方向 (0, 0, 1)
     _omega_ori_x.assign(vSize, 0.0f);
     _omega_ori_y.assign(vSize, 0.0f);
     _omega_ori_z.assign(vSize, 1.0f);
-
-    // 取向场的局部极坐标表示
-    _rho_x_plus.assign(vSize, 0.0f);
-    _rho_x_minus.assign(vSize, 0.0f);
-    _rho_y_plus.assign(vSize, 0.0f);
-    _rho_y_minus.assign(vSize, 0.0f);
-    _rho_z_plus.assign(vSize, 0.0f);
-    _rho_z_minus.assign(vSize, 0.0f);
-
-    _lambda_x_plus.assign(vSize, 0.0f);
-    _lambda_x_minus.assign(vSize, 0.0f);
-    _lambda_y_plus.assign(vSize, 0.0f);
-    _lambda_y_minus.assign(vSize, 0.0f);
-    _lambda_z_plus.assign(vSize, 0.0f);
-    _lambda_z_minus.assign(vSize, 0.0f);
-
-    // 取向场梯度模
-    _gradOmegaOriMag.assign(vSize, 0.0f);
-
-    // 存储 ∂η/∂t
-    _dPhiDt.assign(vSize, 0.0f);
+    _omega_next_x.assign(vSize, 0.0f);
+    _omega_next_y.assign(vSize, 0.0f);
+    _omega_next_z.assign(vSize, 1.0f);
 
     // 固定方向场标记（默认都不固定）
     _isOrientationFixed.assign(vSize, false);
 
+    // 双分辨率：温度只存放在粗网格上
+    if (_thermalRatio > 1) {
+        _restrictTemperature();
+        std::vector<float>().swap(_t);
+        std::vector<float>().swap(_tNext);
+    }
+
     // 在中心创建一个初始晶核
-    _createNucleus(_objectCount.x / 2, _objectCount.y / 2, _objectCount.z / 2);
+    _createNucleus(width() / 2, height() / 2, depth() / 2);
+    if (_storage == Storage::Adaptive) {
+        // 晶核建在细层上，写回基础网格后按它划分加密砖块。新砖块的插值会把晶核抹到相邻的细格上，
+        // 所以划分后清空细层的相场，重新放置晶核
+        _restrictBricks();
+        _regrid();
+        for (Brick* brick : _brickList) std::fill(brick->data[FieldPhi].begin(), brick->data[FieldPhi].end(), 0.0f);
+        _createNucleus(width() / 2, height() / 2, depth() / 2);
+        _restrictBricks();
+    }
+    _convertFields(true); // Single 以外的精度：转换成存储类型
 }
 
 // ==========================================
@@ -238,9 +292,10 @@ void Kobayashi::_vectorInit() {
 // 计算两个单位向量之间的大圆距离（中心角）
 // 输入：两个单位向量 ω_p = (x_p, y_p, z_p) 和 ω_q = (x_q, y_q, z_q)
 // 输出：中心角 ρ ∈ [0, π]
-inline float centralAngle(float x_p, float y_p, float z_p, float x_q, float y_q, float z_q) {
+template <class R>
+inline R centralAngle(R x_p, R y_p, R z_p, R x_q, R y_q, R z_q) {
     // 使用点积计算：cos(ρ) = ω_p · ω_q
-    float dot = x_p * x_q + y_p * y_q + z_p * z_q;
+    R dot = x_p * x_q + y_p * y_q + z_p * z_q;
     // 限制在 [-1, 1] 范围内以避免数值误差
     dot = fmax(-1.0f, fmin(1.0f, dot));
     return acos(dot);
@@ -250,685 +305,1900 @@ inline float centralAngle(float x_p, float y_p, float z_p, float x_q, float y_q,
 // 然后计算投影点在局部极坐标中的角度 λ
 // 输入：ω_p (极点), ω_q (要投影的点)
 // 输出：角度 λ ∈ [0, 2π)
-inline float stereographicAngle(float x_p, float y_p, float z_p, float x_q, float y_q, float z_q) {
+template <class R>
+inline R stereographicAngle(R x_p, R y_p, R z_p, R x_q, R y_q, R z_q) {
     // 建立局部坐标系：
     // 极点为 ω_p，需要找到两个正交的切向量作为基
 
     // 第一个切向量：选择一个与 ω_p 不平行的向量，然后叉乘
-    float ref_x = 0.0f, ref_y = 0.0f, ref_z = 1.0f;
+    R ref_x = 0.0f, ref_y = 0.0f, ref_z = 1.0f;
     if (fabs(z_p) > 0.9f) {
         // 如果 ω_p 接近 z 轴，使用 x 轴作为参考
         ref_x = 1.0f; ref_y = 0.0f; ref_z = 0.0f;
     }
 
     // 第一个切向量：e1 = ref × ω_p（归一化）
-    float e1_x = ref_y * z_p - ref_z * y_p;
-    float e1_y = ref_z * x_p - ref_x * z_p;
-    float e1_z = ref_x * y_p - ref_y * x_p;
-    float e1_len = sqrt(e1_x * e1_x + e1_y * e1_y + e1_z * e1_z);
+    R e1_x = ref_y * z_p - ref_z * y_p;
+    R e1_y = ref_z * x_p - ref_x * z_p;
+    R e1_z = ref_x * y_p - ref_y * x_p;
+    R e1_len = sqrt(e1_x * e1_x + e1_y * e1_y + e1_z * e1_z);
     if (e1_len < FLT_EPSILON) return 0.0f;
     e1_x /= e1_len; e1_y /= e1_len; e1_z /= e1_len;
 
     // 第二个切向量：e2 = ω_p × e1（已经归一化）
-    float e2_x = y_p * e1_z - z_p * e1_y;
-    float e2_y = z_p * e1_x - x_p * e1_z;
-    float e2_z = x_p * e1_y - y_p * e1_x;
+    R e2_x = y_p * e1_z - z_p * e1_y;
+    R e2_y = z_p * e1_x - x_p * e1_z;
+    R e2_z = x_p * e1_y - y_p * e1_x;
 
     // 计算从 ω_p 到 ω_q 的向量在切平面上的投影
     // 投影向量 = ω_q - (ω_q · ω_p) * ω_p
-    float dot_pq = x_p * x_q + y_p * y_q + z_p * z_q;
-    float proj_x = x_q - dot_pq * x_p;
-    float proj_y = y_q - dot_pq * y_p;
-    float proj_z = z_q - dot_pq * z_p;
+    R dot_pq = x_p * x_q + y_p * y_q + z_p * z_q;
+    R proj_x = x_q - dot_pq * x_p;
+    R proj_y = y_q - dot_pq * y_p;
+    R proj_z = z_q - dot_pq * z_p;
 
     // 将投影向量表示在 (e1, e2) 基下
-    float coord_e1 = proj_x * e1_x + proj_y * e1_y + proj_z * e1_z;
-    float coord_e2 = proj_x * e2_x + proj_y * e2_y + proj_z * e2_z;
+    R coord_e1 = proj_x * e1_x + proj_y * e1_y + proj_z * e1_z;
+    R coord_e2 = proj_x * e2_x + proj_y * e2_y + proj_z * e2_z;
 
     // 计算极坐标角度
-    float lambda = atan2(coord_e2, coord_e1);
+    R lambda = atan2(coord_e2, coord_e1);
     if (lambda < 0.0f) lambda += 2.0f * PI_F;
 
     return lambda;
 }
 
 // 在网格中心放置一个微小的”种子”，让晶体开始生长
-void Kobayashi::_createNucleus(int x, int y, int z)
+void Kobayashi3D::_createNucleus(int x, int y, int z)
 {
     // 在3D空间中创建一个小球形晶核
     // 将中心及周围的点设为 1.0 (固体)
-    _phi[_INDEX(x, y, z)] = 1.0f;
-    _phi[_INDEX(x - 1, y, z)] = 1.0f;
-    _phi[_INDEX(x + 1, y, z)] = 1.0f;
-    _phi[_INDEX(x, y - 1, z)] = 1.0f;
-    _phi[_INDEX(x, y + 1, z)] = 1.0f;
-    _phi[_INDEX(x, y, z - 1)] = 1.0f;
-    _phi[_INDEX(x, y, z + 1)] = 1.0f;
+    _phiRef(x, y, z) = 1.0f;
+    _phiRef(x - 1, y, z) = 1.0f;
+    _phiRef(x + 1, y, z) = 1.0f;
+    _phiRef(x, y - 1, z) = 1.0f;
+    _phiRef(x, y + 1, z) = 1.0f;
+    _phiRef(x, y, z - 1) = 1.0f;
+    _phiRef(x, y, z + 1) = 1.0f;
+}
+
+float& Kobayashi3D::_phiRef(int i, int j, int k)
+{
+    if (_storage == Storage::Dense) return _phi[_INDEX(_fold(0, i), _fold(1, j), _fold(2, k))];
+    int bx = i / _brickSize, by = j / _brickSize, bz = k / _brickSize;
+    Brick* brick = _brickAt(bx, by, bz);
+    if (!brick) brick = _allocateBrick(bx, by, bz);
+    Block blk = _brickBlock(*brick);
+    return blk.phi[blk.index(i - bx * _brickSize, j - by * _brickSize, k - bz * _brickSize)];
+}
+
+float Kobayashi3D::phiAt(int i, int j, int k) const
+{
+    if (_storage == Storage::Dense) {
+        int n = _INDEX(_fold(0, i), _fold(1, j), _fold(2, k));
+        switch (_precision) {
+        case Precision::Half: return FieldTraits<Half>::load(_halfFields.phi[n]);
+        case Precision::BFloat16: return FieldTraits<BFloat16>::load(_bfloat16Fields.phi[n]);
+        case Precision::Double: return (float)_doubleFields.phi[n];
+        default: return _phi[n];
+        }
+    }
+    int bx = i / _brickSize, by = j / _brickSize, bz = k / _brickSize;
+    const Brick* brick = _brickAt(bx, by, bz);
+    if (!brick && _storage == Storage::Adaptive) return _phi[_INDEX(i / _amrRatio, j / _amrRatio, k / _amrRatio)];
+    if (!brick) return 0.0f; // 背景液体
+    int s = _brickSize + 2;
+    return brick->data[FieldPhi][(i - bx * _brickSize + 1) + s * ((j - by * _brickSize + 1) + s * (k - bz * _brickSize + 1))];
 }
 
 // ==========================================
-// 物理模拟核心：计算导数
+// 存储精度
 // ==========================================
 
-// 计算空间导数（梯度和拉普拉斯算子）- 3D版本
-// 这是有限差分法的核心：通过邻居格子的值来推算当前的斜率和曲率
-// 参考：有限差分法 (Finite Difference Method, FDM)
-void Kobayashi::_computeGradientLaplacian()
+// Single 以外的精度只用于 Dense 存储：状态场按 S 存放在 FieldSet<S> 中，内核读入时放宽成计算类型，写回时舍入
+template <> Kobayashi3D::FieldSet<Half>& Kobayashi3D::_fieldSet<Half>() { return _halfFields; }
+template <> Kobayashi3D::FieldSet<BFloat16>& Kobayashi3D::_fieldSet<BFloat16>() { return _bfloat16Fields; }
+template <> Kobayashi3D::FieldSet<double>& Kobayashi3D::_fieldSet<double>() { return _doubleFields; }
+
+template <class S>
+Kobayashi3D::BlockOf<S> Kobayashi3D::_packedBlock()
 {
-    for (int k = 0; k < _objectCount.z; k++)
-    {
-        for (int j = 0; j < _objectCount.y; j++)
-        {
-            for (int i = 0; i < _objectCount.x; i++)
-            {
-                // 周期性边界条件 (Periodic Boundary Condition)
-                int i_plus = (i + 1) % _objectCount.x;
-                int i_minus = ((i - 1) + _objectCount.x) % _objectCount.x;
-                int j_plus = (j + 1) % _objectCount.y;
-                int j_minus = ((j - 1) + _objectCount.y) % _objectCount.y;
-                int k_plus = (k + 1) % _objectCount.z;
-                int k_minus = ((k - 1) + _objectCount.z) % _objectCount.z;
+    FieldSet<S>& f = _fieldSet<S>();
+    BlockOf<S> blk = { _objectCount.x, _objectCount.y, _objectCount.z, _objectCount.x + 2, _objectCount.y + 2,
+                       f.phi.data(), f.t.data(), f.phiNext.data(), f.tNext.data(),
+                       f.omegaX.data(), f.omegaY.data(), f.omegaZ.data(),
+                       f.omegaNextX.data(), f.omegaNextY.data(), f.omegaNextZ.data(),
+                       f.epsilon2.data(), f.fluxY.data(), f.fluxZ.data(), f.epsTauTheta.data(),
+                       _objectCount.x + 2, (_objectCount.x + 2) * (_objectCount.y + 2) };
+    _bundleDerived(blk);
+    return blk;
+}
 
-                int idx = _INDEX(i, j, k);
+void Kobayashi3D::setPrecision(Precision precision) {
+    if (_storage != Storage::Dense || _thermalRatio > 1) precision = Precision::Single;
+    if (precision == _precision) return;
 
-                // ========== 1. 计算相场梯度 (Gradient / 梯度) ==========
-                // 物理意义：相场变化的”坡度”，用于确定界面法线方向
-                // 公式：∂η/∂x ≈ (η(i+1,j,k) - η(i-1,j,k)) / (2·Δx)  [中心差分法]
-                _gradPhiX[idx] = (_phi[_INDEX(i_plus, j, k)] - _phi[_INDEX(i_minus, j, k)]) / (2.0f * _dx);
-                _gradPhiY[idx] = (_phi[_INDEX(i, j_plus, k)] - _phi[_INDEX(i, j_minus, k)]) / (2.0f * _dy);
-                _gradPhiZ[idx] = (_phi[_INDEX(i, j, k_plus)] - _phi[_INDEX(i, j, k_minus)]) / (2.0f * _dz);
-
-                // 计算梯度模：|∇η| = sqrt((∂η/∂x)² + (∂η/∂y)² + (∂η/∂z)²)
-                _gradPhiMag[idx] = sqrt(_gradPhiX[idx] * _gradPhiX[idx]
-                                      + _gradPhiY[idx] * _gradPhiY[idx]
-                                      + _gradPhiZ[idx] * _gradPhiZ[idx]);
-
-                // 计算 τ = sqrt((∂η/∂x)² + (∂η/∂y)²)
-                // 注意：τ 只包含 x 和 y 方向的梯度，不包含 z 方向
-                _tau_field[idx] = sqrt(_gradPhiX[idx] * _gradPhiX[idx]
-                                     + _gradPhiY[idx] * _gradPhiY[idx]);
-
-                // ========== 2. 计算局部相位前沿方向 Ω = (θ, φ) ==========
-                // 物理意义：界面法线方向的球坐标表示
-                // 公式：θ = -arccos((∂η/∂z)/|∇η|)
-                // 公式：φ = -arctan((∂η/∂y)/(∂η/∂x))
-                if (_gradPhiMag[idx] > FLT_EPSILON) {
-                    _theta[idx] = -acos(_gradPhiZ[idx] / _gradPhiMag[idx]);
-                } else {
-                    _theta[idx] = 0.0f;
-                }
+    // 先回到 float，再转换成新的存储类型
+    _convertFields(false);
+    _precision = precision;
+    _convertFields(true);
+}
 
-                if (fabs(_gradPhiX[idx]) > FLT_EPSILON) {
-                    _phi_angle[idx] = -atan2(_gradPhiY[idx], _gradPhiX[idx]);
-                } else {
-                    _phi_angle[idx] = 0.0f;
-                }
+// 19/27 点模板要读棱和角上的幽灵格，砖块只填充 6 个面上的幽灵格，所以只支持 Dense
+void Kobayashi3D::setLaplacianStencil(LaplacianStencil stencil) {
+    _stencil = (_storage == Storage::Dense) ? stencil : LaplacianStencil::Point7;
+}
 
-                // ========== 3. 计算拉普拉斯算子 (Laplacian) - 3D 7点模板 ==========
-                // 物理意义：场的”扩散”趋势
-                // 公式：∇²η = ∂²η/∂x² + ∂²η/∂y² + ∂²η/∂z²
-                // 使用7点中心差分：∇²η ≈ (η_E + η_W + η_N + η_S + η_U + η_D - 6η_C) / Δx²
-                _lapPhi[idx] = (_phi[_INDEX(i_plus, j, k)] + _phi[_INDEX(i_minus, j, k)]
-                              + _phi[_INDEX(i, j_plus, k)] + _phi[_INDEX(i, j_minus, k)]
-                              + _phi[_INDEX(i, j, k_plus)] + _phi[_INDEX(i, j, k_minus)]
-                              - 6.0f * _phi[idx]) / (_dx * _dx);
-
-                // 同样计算温度场的拉普拉斯算子
-                _lapT[idx] = (_t[_INDEX(i_plus, j, k)] + _t[_INDEX(i_minus, j, k)]
-                            + _t[_INDEX(i, j_plus, k)] + _t[_INDEX(i, j_minus, k)]
-                            + _t[_INDEX(i, j, k_plus)] + _t[_INDEX(i, j, k_minus)]
-                            - 6.0f * _t[idx]) / (_dx * _dx);
-
-                // ========== 4. 算法1：计算取向场梯度 ∇Ω_ori ==========
-                // 使用立体投影和局部极坐标方法
-                // 参考：Algorithm 1 - Calculation of ∇Ω_ori
-
-                // 当前点的取向 ω_p
-                float omega_p_x = _omega_ori_x[idx];
-                float omega_p_y = _omega_ori_y[idx];
-                float omega_p_z = _omega_ori_z[idx];
-
-                // 对每个邻居计算 (ρ, λ)
-                // x+ 方向
-                {
-                    int idx_q = _INDEX(i_plus, j, k);
-                    float omega_q_x = _omega_ori_x[idx_q];
-                    float omega_q_y = _omega_ori_y[idx_q];
-                    float omega_q_z = _omega_ori_z[idx_q];
-
-                    _rho_x_plus[idx] = centralAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                    _lambda_x_plus[idx] = stereographicAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                }
+int Kobayashi3D::_stencilPoints() const {
+    switch (_stencil) {
+    case LaplacianStencil::Point19: return 19;
+    case LaplacianStencil::Point27: return 27;
+    default: return 7;
+    }
+}
 
-                // x- 方向
-                {
-                    int idx_q = _INDEX(i_minus, j, k);
-                    float omega_q_x = _omega_ori_x[idx_q];
-                    float omega_q_y = _omega_ori_y[idx_q];
-                    float omega_q_z = _omega_ori_z[idx_q];
+// ==========================================
+// 镜像对称
+// ==========================================
 
-                    _rho_x_minus[idx] = centralAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                    _lambda_x_minus[idx] = stereographicAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                }
+// 对称的方向上完整网格的坐标 i 关于中心层 c = n/2 折叠：存放的是 c, c+1, ... 层，第 r 层对应 c ± r。
+// 周期边界时第 0 层（偶数 n 时即第 n 层）也是对称面，存放 n/2 + 1 层；非周期边界存放 n - n/2 层，
+// 偶数 n 时完整网格的第 0 层在对称的网格之外，取第 1 层的值
+bool Kobayashi3D::setSymmetry(Symmetry symmetry, bool imposed) {
+    if (symmetry != Symmetry::None && (_storage != Storage::Dense || _thermalRatio > 1 || (!mirrorSymmetric() && !imposed))) return false;
+    if (symmetry == _symmetry) return true;
+
+    _symmetry = symmetry;
+    _mirror[0] = symmetry == Symmetry::Octant;
+    _mirror[1] = symmetry == Symmetry::Octant || symmetry == Symmetry::Quarter;
+    _mirror[2] = symmetry != Symmetry::None;
+    int full[3] = { _fullCount.x, _fullCount.y, _fullCount.z }, count[3];
+    for (int a = 0; a < 3; a++) {
+        if (!_mirror[a]) count[a] = full[a];
+        else count[a] = (_boundary == Boundary::Periodic) ? full[a] / 2 + 1 : full[a] - full[a] / 2;
+    }
+    _objectCount = { count[0], count[1], count[2] };
+    for (int a = 0; a < 3; a++) {
+        _foldWeight[a].assign(_mirror[a] ? count[a] : 0, 0);
+        if (_mirror[a])
+            for (int i = 0; i < full[a]; i++) _foldWeight[a][_fold(a, i)]++;
+    }
 
-                // y+ 方向
-                {
-                    int idx_q = _INDEX(i, j_plus, k);
-                    float omega_q_x = _omega_ori_x[idx_q];
-                    float omega_q_y = _omega_ori_y[idx_q];
-                    float omega_q_z = _omega_ori_z[idx_q];
+    // 先释放按原来的网格分配的数组，assign() 不会缩小容量
+    for (std::vector<float>* f : { &_phi, &_t, &_phiNext, &_tNext, &_omega_ori_x, &_omega_ori_y, &_omega_ori_z,
+                                   &_omega_next_x, &_omega_next_y, &_omega_next_z, &_epsilon2, &_fluxY, &_fluxZ, &_epsTauTheta })
+        std::vector<float>().swap(*f);
+    std::vector<bool>().swap(_isOrientationFixed);
+    _vectorInit();
+    return true;
+}
 
-                    _rho_y_plus[idx] = centralAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                    _lambda_y_plus[idx] = stereographicAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                }
+int Kobayashi3D::_fold(int a, int i) const {
+    if (!_mirror[a]) return i;
+    int n = (a == 0) ? _objectCount.x : (a == 1) ? _objectCount.y : _objectCount.z;
+    int c = ((a == 0) ? _fullCount.x : (a == 1) ? _fullCount.y : _fullCount.z) / 2;
+    return std::min(std::abs(i - c), n - 1);
+}
 
-                // y- 方向
-                {
-                    int idx_q = _INDEX(i, j_minus, k);
-                    float omega_q_x = _omega_ori_x[idx_q];
-                    float omega_q_y = _omega_ori_y[idx_q];
-                    float omega_q_z = _omega_ori_z[idx_q];
+// 对称面一端复制第 1 层。周期边界时另一端也是对称面：偶数 n 时它穿过存放的最后一层（完整网格的第 0 层），
+// 同样隔一层复制；奇数 n 时它在最后一层（第 n-1 层）与第 0 层之间，复制最后一层
+HaloSides Kobayashi3D::_haloSides(Boundary b) const {
+    HaloSides sides(b);
+    const int full[3] = { _fullCount.x, _fullCount.y, _fullCount.z };
+    for (int a = 0; a < 3; a++) {
+        if (!_mirror[a]) continue;
+        sides.lo[a] = HaloSide::Reflect;
+        if (b == Boundary::Periodic) sides.hi[a] = (full[a] % 2 == 0) ? HaloSide::Reflect : HaloSide::Copy;
+    }
+    return sides;
+}
 
-                    _rho_y_minus[idx] = centralAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                    _lambda_y_minus[idx] = stereographicAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                }
+void Kobayashi3D::setDerivedLayout(DerivedLayout layout) {
+    if (_storage != Storage::Dense) layout = DerivedLayout::Separate;
+    if (layout == _derivedLayout) return;
+
+    // 各向异性量每步开始时由状态场重新计算，只需按新的排列重新分配
+    _derivedLayout = layout;
+    switch (_precision) {
+    case Precision::Half: _allocateDerived(_halfFields.epsilon2, _halfFields.fluxY, _halfFields.fluxZ, _halfFields.epsTauTheta, _halfFields.phi.size()); break;
+    case Precision::BFloat16: _allocateDerived(_bfloat16Fields.epsilon2, _bfloat16Fields.fluxY, _bfloat16Fields.fluxZ, _bfloat16Fields.epsTauTheta, _bfloat16Fields.phi.size()); break;
+    case Precision::Double: _allocateDerived(_doubleFields.epsilon2, _doubleFields.fluxY, _doubleFields.fluxZ, _doubleFields.epsTauTheta, _doubleFields.phi.size()); break;
+    default: _allocateDerived(_epsilon2, _fluxY, _fluxZ, _epsTauTheta, _phi.size()); break;
+    }
+}
 
-                // z+ 方向
-                {
-                    int idx_q = _INDEX(i, j, k_plus);
-                    float omega_q_x = _omega_ori_x[idx_q];
-                    float omega_q_y = _omega_ori_y[idx_q];
-                    float omega_q_z = _omega_ori_z[idx_q];
+// cells 是含幽灵格的格子数。Bundled 时整块交错数组放在 epsilon2 中（见 _bundleDerived()），其余三个释放
+template <class R>
+void Kobayashi3D::_allocateDerived(std::vector<R>& epsilon2, std::vector<R>& fluxY, std::vector<R>& fluxZ, std::vector<R>& epsTauTheta, size_t cells) const
+{
+    if (_derivedLayout == DerivedLayout::Bundled) {
+        epsilon2.assign(4 * cells, R(0));
+        for (std::vector<R>* v : { &fluxY, &fluxZ, &epsTauTheta }) std::vector<R>().swap(*v);
+        return;
+    }
+    for (std::vector<R>* v : { &epsilon2, &fluxY, &fluxZ, &epsTauTheta }) v->assign(cells, R(0));
+}
 
-                    _rho_z_plus[idx] = centralAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                    _lambda_z_plus[idx] = stereographicAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                }
+// 交错数组的第 (j, k) 组是四个量的 (j, k) 行，每行 sx 个数：组内第 q 个量的指针偏移 q·sx，行、层步长是状态场的 4 倍
+template <class S>
+void Kobayashi3D::_bundleDerived(BlockOf<S>& blk) const
+{
+    if (_derivedLayout != DerivedLayout::Bundled) return;
+    blk.fluxY = blk.epsilon2 + blk.sx;
+    blk.fluxZ = blk.epsilon2 + 2 * blk.sx;
+    blk.epsTauTheta = blk.epsilon2 + 3 * blk.sx;
+    blk.dsy = 4 * blk.sx;
+    blk.dsz = 4 * blk.sx * blk.sy;
+}
 
-                // z- 方向
-                {
-                    int idx_q = _INDEX(i, j, k_minus);
-                    float omega_q_x = _omega_ori_x[idx_q];
-                    float omega_q_y = _omega_ori_y[idx_q];
-                    float omega_q_z = _omega_ori_z[idx_q];
+// pack 为 true 时把 float 的场转换成当前精度的 FieldSet，否则转换回来；Single 时什么也不做
+void Kobayashi3D::_convertFields(bool pack) {
+    _snapshot.stepCount = -1; // 快照按转换前的存放方式保存
+    switch (_precision) {
+    case Precision::Half: if (pack) _packFields<Half>(); else _unpackFields<Half>(); break;
+    case Precision::BFloat16: if (pack) _packFields<BFloat16>(); else _unpackFields<BFloat16>(); break;
+    case Precision::Double: if (pack) _packFields<double>(); else _unpackFields<double>(); break;
+    default: break;
+    }
+}
 
-                    _rho_z_minus[idx] = centralAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                    _lambda_z_minus[idx] = stereographicAngle(omega_p_x, omega_p_y, omega_p_z, omega_q_x, omega_q_y, omega_q_z);
-                }
+template <class S>
+void Kobayashi3D::_packFields() {
+    FieldSet<S>& f = _fieldSet<S>();
+    narrowField(_phi, f.phi);
+    narrowField(_t, f.t);
+    narrowField(_omega_ori_x, f.omegaX);
+    narrowField(_omega_ori_y, f.omegaY);
+    narrowField(_omega_ori_z, f.omegaZ);
+    // Next 缓冲在 H = 0 时不写，保持与当前取向相同
+    narrowField(_omega_ori_x, f.omegaNextX);
+    narrowField(_omega_ori_y, f.omegaNextY);
+    narrowField(_omega_ori_z, f.omegaNextZ);
+    f.phiNext.assign(f.phi.size(), FieldTraits<S>::store(0.0f));
+    f.tNext.assign(f.t.size(), FieldTraits<S>::store(0.0f));
+    _allocateDerived(f.epsilon2, f.fluxY, f.fluxZ, f.epsTauTheta, f.phi.size());
+
+    std::vector<float>* single[] = {
+        &_phi, &_t, &_phiNext, &_tNext, &_omega_ori_x, &_omega_ori_y, &_omega_ori_z,
+        &_omega_next_x, &_omega_next_y, &_omega_next_z, &_epsilon2, &_fluxY, &_fluxZ, &_epsTauTheta };
+    for (std::vector<float>* v : single) std::vector<float>().swap(*v);
+}
 
-                // 计算 ∇Ω_ori 的模
-                // 使用 (ρ, λ) 场的梯度来近似
-                // ||∇Ω_ori|| ≈ sqrt((∂ρ/∂x)² + (∂ρ/∂y)² + (∂ρ/∂z)² + (∂λ/∂x)² + (∂λ/∂y)² + (∂λ/∂z)²)
-                // 注意：ρ 是中心角，范围 [0, π]，不需要特殊处理
-                float grad_rho_x = (_rho_x_plus[idx] - _rho_x_minus[idx]) / (2.0f * _dx);
-                float grad_rho_y = (_rho_y_plus[idx] - _rho_y_minus[idx]) / (2.0f * _dy);
-                float grad_rho_z = (_rho_z_plus[idx] - _rho_z_minus[idx]) / (2.0f * _dz);
-
-                // λ 是极坐标角度，范围 [0, 2π]，需要处理周期性
-                float grad_lambda_x = angleDifference(_lambda_x_plus[idx], _lambda_x_minus[idx]) / (2.0f * _dx);
-                float grad_lambda_y = angleDifference(_lambda_y_plus[idx], _lambda_y_minus[idx]) / (2.0f * _dy);
-                float grad_lambda_z = angleDifference(_lambda_z_plus[idx], _lambda_z_minus[idx]) / (2.0f * _dz);
-
-                _gradOmegaOriMag[idx] = sqrt(grad_rho_x * grad_rho_x + grad_rho_y * grad_rho_y + grad_rho_z * grad_rho_z
-                                           + grad_lambda_x * grad_lambda_x + grad_lambda_y * grad_lambda_y + grad_lambda_z * grad_lambda_z);
-
-                // ========== 5. 计算各向异性系数 ε(Ω, Ω_ori) 及其导数 ==========
-                // 物理意义：晶体在不同方向生长速度不同
-                // 计算局部相位前沿方向 Ω 和取向场 Ω_ori 之间的夹角
-
-                // Ω = -∇η (归一化)
-                float omega_x = 0.0f, omega_y = 0.0f, omega_z = 0.0f;
-                if (_gradPhiMag[idx] > FLT_EPSILON) {
-                    omega_x = -_gradPhiX[idx] / _gradPhiMag[idx];
-                    omega_y = -_gradPhiY[idx] / _gradPhiMag[idx];
-                    omega_z = -_gradPhiZ[idx] / _gradPhiMag[idx];
-                }
+template <class S>
+void Kobayashi3D::_unpackFields() {
+    FieldSet<S>& f = _fieldSet<S>();
+    widenField(f.phi, _phi);
+    widenField(f.t, _t);
+    widenField(f.omegaX, _omega_ori_x);
+    widenField(f.omegaY, _omega_ori_y);
+    widenField(f.omegaZ, _omega_ori_z);
+    _omega_next_x = _omega_ori_x;
+    _omega_next_y = _omega_ori_y;
+    _omega_next_z = _omega_ori_z;
+    _phiNext.assign(_phi.size(), 0.0f);
+    _tNext.assign(_phi.size(), 0.0f);
+    _allocateDerived(_epsilon2, _fluxY, _fluxZ, _epsTauTheta, _phi.size());
+    f = FieldSet<S>();
+}
+
+template <class S>
+void Kobayashi3D::_fillPackedHalo()
+{
+    FieldSet<S>& f = _fieldSet<S>();
+    int nx = _objectCount.x, ny = _objectCount.y, nz = _objectCount.z;
+    HaloSides sides = _haloSides(_boundary);
+    HaloSides omegaSides = _haloSides((_boundary == Boundary::Periodic) ? Boundary::Periodic : Boundary::Neumann);
+    fillHalo3D(f.phi, nx, ny, nz, sides, 0.0f);
+    fillHalo3D(f.t, nx, ny, nz, sides, _tBoundary);
+    if (_orientationEnabled()) {
+        fillHalo3D(f.omegaX, nx, ny, nz, omegaSides);
+        fillHalo3D(f.omegaY, nx, ny, nz, omegaSides);
+        fillHalo3D(f.omegaZ, nx, ny, nz, omegaSides);
+    }
+}
 
-                // 将 Ω 从全局坐标转换到以 Ω_ori 为z轴的局部坐标
-                // 使用 Rodrigues 旋转公式
-                // k = u_ori × u0，Θ = θ_ori
-                float theta_ori = acos(fmax(-1.0f, fmin(1.0f, omega_p_z)));
-                float phi_ori = atan2(omega_p_y, omega_p_x);
-
-                // 旋转 Ω 到局部坐标系
-                float omega_rot_x, omega_rot_y, omega_rot_z;
-                rodriguesRotation(omega_x, omega_y, omega_z,
-                                 omega_p_x, omega_p_y, omega_p_z,
-                                 theta_ori,
-                                 omega_rot_x, omega_rot_y, omega_rot_z);
-
-                // 从旋转后的向量计算局部球坐标 (θ̃, φ̃)
-                float theta_tilde = acos(fmax(-1.0f, fmin(1.0f, omega_rot_z)));
-                float phi_tilde = atan2(omega_rot_y, omega_rot_x);
-
-                // 计算三角函数值
-                float sin_theta_t = sin(theta_tilde);
-                float cos_theta_t = cos(theta_tilde);
-                float sin_phi_t = sin(phi_tilde);
-                float cos_phi_t = cos(phi_tilde);
-
-                float sin2_theta_t = sin_theta_t * sin_theta_t;
-                float cos2_theta_t = cos_theta_t * cos_theta_t;
-                float sin2_phi_t = sin_phi_t * sin_phi_t;
-                float cos2_phi_t = cos_phi_t * cos_phi_t;
-
-                float sin4_theta_t = sin2_theta_t * sin2_theta_t;
-                float cos4_theta_t = cos2_theta_t * cos2_theta_t;
-                float sin4_phi_t = sin2_phi_t * sin2_phi_t;
-                float cos4_phi_t = cos2_phi_t * cos2_phi_t;
-
-                // 公式(19)：ε_o(n) = c1 + c2(sin⁴θ̃(sin⁴φ̃ + cos⁴φ̃) + cos⁴θ̃)
-                float epsilon_o = _c1 + _c2 * (sin4_theta_t * (sin4_phi_t + cos4_phi_t) + cos4_theta_t);
-                _epsilon[idx] = epsilon_o;
-
-                // 计算各向异性系数对 θ̃ 的导数
-                // ∂ε_o/∂θ̃ = c2 * (4sin³θ̃cosθ̃(sin⁴φ̃ + cos⁴φ̃) - 4cos³θ̃sinθ̃)
-                float dEpsilon_dTheta_t = _c2 * (4.0f * sin2_theta_t * sin_theta_t * cos_theta_t * (sin4_phi_t + cos4_phi_t)
-                                                - 4.0f * cos2_theta_t * cos_theta_t * sin_theta_t);
-                _epsilonDerivTheta[idx] = dEpsilon_dTheta_t;
-
-                // 计算各向异性系数对 φ̃ 的导数
-                // ∂ε_o/∂φ̃ = c2 * sin⁴θ̃ * 4sinφ̃cosφ̃(sin²φ̃ - cos²φ̃)
-                float dEpsilon_dPhi_t = _c2 * sin4_theta_t * 4.0f * sin_phi_t * cos_phi_t * (sin2_phi_t - cos2_phi_t);
-                _epsilonDerivPhi[idx] = dEpsilon_dPhi_t;
+template <class S>
+void Kobayashi3D::_solvePackedFields()
+{
+    BlockFnOf<S> kernel = _solveKernel<S>();
+    BlockOf<S> blk = _packedBlock<S>();
+    const bool measure = diagnostics();
+    _pool->parallelFor(0, _objectCount.z, [this, kernel, &blk, measure](int k0, int k1) {
+        (this->*kernel)(blk, k0, k1);
+        if (measure) _measureBlock(blk, blk.phiNext, blk.tNext, k0, k1);
+    }, _planeGrain());
+    _swapNext<S>();
+}
+
+template <class S>
+void Kobayashi3D::_swapNext()
+{
+    FieldSet<S>& f = _fieldSet<S>();
+    f.phi.swap(f.phiNext);
+    f.t.swap(f.tNext);
+    if (_orientationEnabled()) {
+        f.omegaX.swap(f.omegaNextX);
+        f.omegaY.swap(f.omegaNextY);
+        f.omegaZ.swap(f.omegaNextZ);
+    }
+}
+
+template <>
+void Kobayashi3D::_swapNext<float>()
+{
+    _phi.swap(_phiNext);
+    _t.swap(_tNext);
+    if (_orientationEnabled()) {
+        _omega_ori_x.swap(_omega_next_x);
+        _omega_ori_y.swap(_omega_next_y);
+        _omega_ori_z.swap(_omega_next_z);
+    }
+}
+
+// ==========================================
+// 并行调度：按 z 方向切片（slab）分给线程池
+// ==========================================
+
+// 每个阶段内，各个格子只写自己的输出、只读上一阶段的结果，
+// 所以切片之间没有依赖；parallelFor() 返回即为阶段之间的屏障。
+// 每个任务块是相邻的几个 z 层（见 _planeGrain()），线程先处理相邻的块，做完后从其它线程窃取，
+// 含有界面的层比纯液体层慢时也能保持各核心负载均衡。
+// Sparse 存储时任务块是砖块而不是 z 层
+int Kobayashi3D::_planeGrain() const
+{
+    // 条带遍历（见 RowWalk）只在一个任务块内复用 ±z 邻居，所以每块取多层，每个线程仍分到约 4 块
+    if (KOBAYASHI3D_TILE_ROWS <= 0) return 1;
+    return std::max(1, _objectCount.z / (4 * _pool->size()));
+}
+
+void Kobayashi3D::_computeAnisotropy()
+{
+    if (_storage == Storage::Sparse) {
+        _computeBrickAnisotropy();
+
+        // 未分配的相邻砖块是背景，它的通量项对一个四周都是背景的格子运行同一个内核得到
+        std::vector<float> bg[FieldCount];
+        for (std::vector<float>& f : bg) f.assign(27, 0.0f);
+        bg[FieldOmegaZ].assign(27, 1.0f);
+        Block bgBlock = { 1, 1, 1, 3, 3,
+                          bg[FieldPhi].data(), bg[FieldT].data(), bg[FieldPhiNext].data(), bg[FieldTNext].data(),
+                          bg[FieldOmegaX].data(), bg[FieldOmegaY].data(), bg[FieldOmegaZ].data(),
+                          bg[FieldOmegaNextX].data(), bg[FieldOmegaNextY].data(), bg[FieldOmegaNextZ].data(),
+                          bg[FieldEpsilon2].data(), bg[FieldFluxY].data(), bg[FieldFluxZ].data(), bg[FieldEpsTauTheta].data(), 3, 9 };
+        _computeAnisotropyBlock(bgBlock, 0, 1);
+        for (int f = 0; f < 4; f++) _backgroundDerived[f] = bg[FieldEpsilon2 + f][13];
+
+        const int derived[] = { FieldEpsilon2, FieldFluxY, FieldFluxZ, FieldEpsTauTheta };
+        _fillBrickHalo(derived, 4);
+        return;
+    }
+
+    switch (_precision) {
+    case Precision::Half: _denseAnisotropy(_packedBlock<Half>()); return;
+    case Precision::BFloat16: _denseAnisotropy(_packedBlock<BFloat16>()); return;
+    case Precision::Double: _denseAnisotropy(_packedBlock<double>()); return;
+    default: _denseAnisotropy(_denseBlock()); return;
+    }
+}
+
+template <class S>
+void Kobayashi3D::_denseAnisotropy(const BlockOf<S>& blk)
+{
+    _pool->parallelFor(0, _objectCount.z, [this, &blk](int k0, int k1) { _computeAnisotropyBlock(blk, k0, k1); }, _planeGrain());
+
+    // 通量项没有"固定值"的含义，非周期边界时一律复制相邻的内部格
+    HaloSides sides = _haloSides((_boundary == Boundary::Periodic) ? Boundary::Periodic : Boundary::Neumann);
+    for (auto* f : { blk.epsilon2, blk.fluxY, blk.fluxZ, blk.epsTauTheta })
+        fillHaloStrided3D(f, blk.nx, blk.ny, blk.nz, blk.dsy, blk.dsz, 0, blk.nz, sides);
+}
+
+// 按当前参数选择特化版本：[Orientation][FixedMask][温度：0 一般的 a²，1 为 a² = 1，2 为粗网格]
+template <class S>
+Kobayashi3D::BlockFnOf<S> Kobayashi3D::_solveKernel() const
+{
+    static const BlockFnOf<S> kernels[2][2][3] = {
+        { { &Kobayashi3D::_solveFieldsBlock<S, false, false, false, false>, &Kobayashi3D::_solveFieldsBlock<S, false, false, true, false>,
+            &Kobayashi3D::_solveFieldsBlock<S, false, false, false, true> },
+          { &Kobayashi3D::_solveFieldsBlock<S, false, true, false, false>,  &Kobayashi3D::_solveFieldsBlock<S, false, true, true, false>,
+            &Kobayashi3D::_solveFieldsBlock<S, false, true, false, true> } },
+        { { &Kobayashi3D::_solveFieldsBlock<S, true, false, false, false>,  &Kobayashi3D::_solveFieldsBlock<S, true, false, true, false>,
+            &Kobayashi3D::_solveFieldsBlock<S, true, false, false, true> },
+          { &Kobayashi3D::_solveFieldsBlock<S, true, true, false, false>,   &Kobayashi3D::_solveFieldsBlock<S, true, true, true, false>,
+            &Kobayashi3D::_solveFieldsBlock<S, true, true, false, true> } },
+    };
+    int thermal = (_thermalRatio > 1) ? 2 : (_alpha_T == 1.0f) ? 1 : 0;
+    return kernels[_orientationEnabled()][_hasFixedOrientation][thermal];
+}
+
+// 新的相场、温度场和取向场写入 _phiNext/_tNext/_omega_next_*（Jacobi 双缓冲），阶段结束后交换，
+// 这样结果与遍历顺序和线程数无关
+void Kobayashi3D::_solveFields()
+{
+    if (_storage == Storage::Sparse) {
+        _solveBrickFields(_solveKernel<float>());
+        return;
+    }
+    switch (_precision) {
+    case Precision::Half: _solvePackedFields<Half>(); return;
+    case Precision::BFloat16: _solvePackedFields<BFloat16>(); return;
+    case Precision::Double: _solvePackedFields<double>(); return;
+    default: break;
+    }
+
+    // 生长诊断在每个任务写完自己的层之后统计，这些层还在缓存中；双分辨率时温度由 _thermalStep() 统计
+    BlockFn kernel = _solveKernel<float>();
+    Block blk = _denseBlock();
+    const bool measure = diagnostics();
+    const float* tNext = (_thermalRatio > 1) ? nullptr : blk.tNext;
+    _pool->parallelFor(0, _objectCount.z, [this, kernel, &blk, measure, tNext](int k0, int k1) {
+        (this->*kernel)(blk, k0, k1);
+        if (measure) _measureBlock(blk, blk.phiNext, tNext, k0, k1);
+    }, _planeGrain());
+    _swapNext<float>();
+}
+
+// 幽灵格在每步开始前填一次，本步内状态场不再变化（新值都写入 *Next）
+// Dirichlet 边界：网格外是 phi = 0、t = tBoundary 的液体浴；取向场没有固定值，按零通量处理
+void Kobayashi3D::_fillHalo() {
+    if (_storage == Storage::Sparse) {
+        const int state[] = { FieldPhi, FieldT, FieldOmegaX, FieldOmegaY, FieldOmegaZ };
+        _fillBrickHalo(state, _orientationEnabled() ? 5 : 2);
+        return;
+    }
+
+    switch (_precision) {
+    case Precision::Half: _fillPackedHalo<Half>(); return;
+    case Precision::BFloat16: _fillPackedHalo<BFloat16>(); return;
+    case Precision::Double: _fillPackedHalo<double>(); return;
+    default: break;
+    }
+
+    int nx = _objectCount.x, ny = _objectCount.y, nz = _objectCount.z;
+    HaloSides sides = _haloSides(_boundary);
+    HaloSides omegaSides = _haloSides((_boundary == Boundary::Periodic) ? Boundary::Periodic : Boundary::Neumann);
+    fillHalo3D(_phi, nx, ny, nz, sides, 0.0f);
+    if (_thermalRatio > 1) fillHalo3D(_tCoarse, _thermalCount.x, _thermalCount.y, _thermalCount.z, _boundary, _tBoundary);
+    else fillHalo3D(_t, nx, ny, nz, sides, _tBoundary);
+    // 取向场的邻居只在算法1和方程(18)中用到，H = 0 时不需要幽灵格
+    if (_orientationEnabled()) {
+        fillHalo3D(_omega_ori_x, nx, ny, nz, omegaSides);
+        fillHalo3D(_omega_ori_y, nx, ny, nz, omegaSides);
+        fillHalo3D(_omega_ori_z, nx, ny, nz, omegaSides);
+    }
+}
+
+// 只导出内部格，x 变化最快
+void Kobayashi3D::exportPhi(std::vector<float>& out) const {
+    int nx = width(), ny = height(), nz = depth();
+    out.resize((size_t)nx * ny * nz);
+    for (int k = 0; k < nz; k++)
+        for (int j = 0; j < ny; j++)
+            for (int i = 0; i < nx; i++)
+                out[(size_t)i + (size_t)nx * (j + (size_t)ny * k)] = phiAt(i, j, k);
+}
+
+// 重新创建线程池，threads <= 0 表示使用全部核心
+void Kobayashi3D::setThreadCount(int threads) {
+    _pool = std::make_shared<ThreadPool>(threads);
+}
+
+// 请求的指令集超过 CPU 支持的级别时降到 CPU 支持的最高级别
+void Kobayashi3D::setSimd(SimdLevel level) {
+    _simd = simdKernels(level);
+    _simdLevel = level;
+}
+
+// 常驻内存：所有场数组实际占用的字节数（std::vector<bool> 按位存储）
+size_t Kobayashi3D::memoryBytes() const {
+    const std::vector<float>* fields[] = {
+        &_phi, &_t, &_phiNext, &_tNext, &_tCoarse, &_tCoarseNext,
+        &_omega_ori_x, &_omega_ori_y, &_omega_ori_z, &_omega_next_x, &_omega_next_y, &_omega_next_z,
+        &_epsilon2, &_fluxY, &_fluxZ, &_epsTauTheta };
+    size_t bytes = 0;
+    for (const std::vector<float>* f : fields) bytes += f->capacity() * sizeof(float);
+    bytes += (_isOrientationFixed.capacity() + 7) / 8;
+    bytes += _halfFields.bytes() + _bfloat16Fields.bytes() + _doubleFields.bytes();
+
+    // Sparse：砖块表和已分配砖块的场
+    bytes += _bricks.capacity() * sizeof(std::unique_ptr<Brick>) + _brickList.capacity() * sizeof(Brick*);
+    for (const Brick* brick : _brickList) {
+        bytes += sizeof(Brick);
+        for (const std::vector<float>& f : brick->data) bytes += f.capacity() * sizeof(float);
+    }
+    return bytes;
+}
+
+// ==========================================
+// Sparse 存储：砖块
+// ==========================================
+
+Kobayashi3D::Block Kobayashi3D::_denseBlock()
+{
+    Block blk = { _objectCount.x, _objectCount.y, _objectCount.z, _objectCount.x + 2, _objectCount.y + 2,
+                  _phi.data(), _t.data(), _phiNext.data(), _tNext.data(),
+                  _omega_ori_x.data(), _omega_ori_y.data(), _omega_ori_z.data(),
+                  _omega_next_x.data(), _omega_next_y.data(), _omega_next_z.data(),
+                  _epsilon2.data(), _fluxY.data(), _fluxZ.data(), _epsTauTheta.data(),
+                  _objectCount.x + 2, (_objectCount.x + 2) * (_objectCount.y + 2) };
+    _bundleDerived(blk);
+    return blk;
+}
+
+Kobayashi3D::Block Kobayashi3D::_brickBlock(Brick& brick)
+{
+    std::vector<float>* d = brick.data;
+    Block blk = { brick.n[0], brick.n[1], brick.n[2], _brickSize + 2, _brickSize + 2,
+                  d[FieldPhi].data(), d[FieldT].data(), d[FieldPhiNext].data(), d[FieldTNext].data(),
+                  d[FieldOmegaX].data(), d[FieldOmegaY].data(), d[FieldOmegaZ].data(),
+                  d[FieldOmegaNextX].data(), d[FieldOmegaNextY].data(), d[FieldOmegaNextZ].data(),
+                  d[FieldEpsilon2].data(), d[FieldFluxY].data(), d[FieldFluxZ].data(), d[FieldEpsTauTheta].data(),
+                  _brickSize + 2, (_brickSize + 2) * (_brickSize + 2) };
+    return blk;
+}
+
+Kobayashi3D::Brick* Kobayashi3D::_brickAt(int bx, int by, int bz) const
+{
+    return _bricks[(size_t)bx + (size_t)_bricksPerAxis[0] * (by + (size_t)_bricksPerAxis[1] * bz)].get();
+}
+
+// 新砖块的内容是背景液体；加入 _brickList 由调用者负责（_updateBricks() 每步重建）
+Kobayashi3D::Brick* Kobayashi3D::_allocateBrick(int bx, int by, int bz)
+{
+    std::unique_ptr<Brick>& slot = _bricks[(size_t)bx + (size_t)_bricksPerAxis[0] * (by + (size_t)_bricksPerAxis[1] * bz)];
+    slot.reset(new Brick);
+    Brick& brick = *slot;
+    int coord[3] = { bx, by, bz };
+    int count[3] = { width(), height(), depth() };
+    for (int a = 0; a < 3; a++) {
+        brick.coord[a] = coord[a];
+        brick.n[a] = std::min(_brickSize, count[a] - coord[a] * _brickSize);
+    }
+    size_t size = (size_t)(_brickSize + 2) * (_brickSize + 2) * (_brickSize + 2);
+    bool orientation = _orientationEnabled();
+    for (int f = 0; f < FieldCount; f++) {
+        bool omegaNext = (f >= FieldOmegaNextX && f <= FieldOmegaNextZ);
+        if (omegaNext && !orientation) continue;
+        float value = (f == FieldOmegaZ || f == FieldOmegaNextZ) ? 1.0f : 0.0f;
+        brick.data[f].assign(size, value);
+    }
+    _brickList.push_back(&brick);
+    return &brick;
+}
+
+// H = 0 时 _allocateBrick() 不分配取向场的 Next 缓冲；H 改为非零时由 setParam() 为所有已分配的砖块补上，
+// 取值与当前取向场相同
+void Kobayashi3D::_allocateOrientationNext()
+{
+    if (!_orientationEnabled()) return;
+    for (std::unique_ptr<Brick>& slot : _bricks) {
+        if (!slot || !slot->data[FieldOmegaNextX].empty()) continue;
+        for (int f = 0; f < 3; f++) slot->data[FieldOmegaNextX + f] = slot->data[FieldOmegaX + f];
+    }
+}
+
+// 砖块的内部格是否与背景（phi = 0、t = 0、Ω_ori = (0, 0, 1)）有超过 sparseTol 的差别
+bool Kobayashi3D::_brickBusy(const Brick& brick) const
+{
+    int s = _brickSize + 2;
+    bool orientation = _orientationEnabled();
+    const float* phi = brick.data[FieldPhi].data();
+    const float* t = brick.data[FieldT].data();
+    const float* ox = brick.data[FieldOmegaX].data();
+    const float* oy = brick.data[FieldOmegaY].data();
+    const float* oz = brick.data[FieldOmegaZ].data();
+    for (int k = 0; k < brick.n[2]; k++)
+        for (int j = 0; j < brick.n[1]; j++)
+            for (int i = 0; i < brick.n[0]; i++) {
+                int idx = (i + 1) + s * ((j + 1) + s * (k + 1));
+                if (phi[idx] > _sparseTol || std::fabs(t[idx]) > _sparseTol) return true;
+                if (orientation && (std::fabs(ox[idx]) > _sparseTol || std::fabs(oy[idx]) > _sparseTol
+                                    || std::fabs(oz[idx] - 1.0f) > _sparseTol)) return true;
             }
+    return false;
+}
+
+// 每个格子一步内只受 6 个方向两格以内的格子影响（各向异性一格、通量项再一格），界面一步移动不到一格，
+// 所以只要每步为不是背景的砖块补齐 6 个相邻砖块，未分配的砖块在这一步里一定保持背景值。
+// 既不是背景、也不与这样的砖块相邻的砖块被释放（其中与背景的差别不超过 sparseTol）。
+// Dirichlet 边界的温度与背景不同时，贴着网格边界的砖块总会被加热，始终保留。
+void Kobayashi3D::_updateBricks()
+{
+    int nb[3] = { _bricksPerAxis[0], _bricksPerAxis[1], _bricksPerAxis[2] };
+    size_t total = _bricks.size();
+
+    // 1. 检查已分配的砖块
+    std::vector<unsigned char> busy(_brickList.size());
+    _pool->parallelFor(0, (int)_brickList.size(), [this, &busy](int b0, int b1) {
+        for (int b = b0; b < b1; b++) busy[b] = _brickBusy(*_brickList[b]);
+    }, 1);
+
+    // 2. 需要保留的砖块：不是背景的砖块及其 6 个相邻砖块（周期边界时按周期相邻）
+    std::vector<unsigned char> keep(total, 0);
+    auto mark = [&](int x, int y, int z) {
+        if (_boundary == Boundary::Periodic) {
+            x = (x + nb[0]) % nb[0]; y = (y + nb[1]) % nb[1]; z = (z + nb[2]) % nb[2];
+        } else if (x < 0 || x >= nb[0] || y < 0 || y >= nb[1] || z < 0 || z >= nb[2]) {
+            return;
         }
+        keep[(size_t)x + (size_t)nb[0] * (y + (size_t)nb[1] * z)] = 1;
+    };
+    for (size_t b = 0; b < _brickList.size(); b++) {
+        if (!busy[b]) continue;
+        const int* c = _brickList[b]->coord;
+        mark(c[0], c[1], c[2]);
+        for (int a = 0; a < 3; a++)
+            for (int d = -1; d <= 1; d += 2) {
+                int q[3] = { c[0], c[1], c[2] };
+                q[a] += d;
+                mark(q[0], q[1], q[2]);
+            }
     }
+    if (_boundary == Boundary::Dirichlet && _tBoundary != 0.0f) {
+        for (int z = 0; z < nb[2]; z++)
+            for (int y = 0; y < nb[1]; y++)
+                for (int x = 0; x < nb[0]; x++)
+                    if (x == 0 || y == 0 || z == 0 || x == nb[0] - 1 || y == nb[1] - 1 || z == nb[2] - 1) mark(x, y, z);
+    }
+
+    // 3. 按砖块坐标顺序重建 _brickList（与分配顺序无关），分配新砖块、释放多余的砖块
+    _brickList.clear();
+    for (int z = 0; z < nb[2]; z++)
+        for (int y = 0; y < nb[1]; y++)
+            for (int x = 0; x < nb[0]; x++) {
+                size_t id = (size_t)x + (size_t)nb[0] * (y + (size_t)nb[1] * z);
+                if (keep[id] && !_bricks[id]) _allocateBrick(x, y, z);
+                else if (keep[id]) _brickList.push_back(_bricks[id].get());
+                else _bricks[id].reset();
+            }
+}
+
+// 填充所有已分配砖块的幽灵面（内核只访问 6 个方向的邻居，棱和角不需要）：
+//   相邻砖块已分配：复制它贴着这一面的那层内部格
+//   相邻砖块是背景：取背景值；Adaptive 时由基础网格插值（_coarseValue）
+//   网格边界：周期边界取对侧的砖块；Dirichlet 的 phi、t 取固定值；其余复制本砖块的边界层（零通量）
+void Kobayashi3D::_fillBrickHalo(const int* fields, int count)
+{
+    int s = _brickSize + 2;
+    auto at = [s](int i, int j, int k) { return (i + 1) + s * ((j + 1) + s * (k + 1)); };
+    const bool adaptive = (_storage == Storage::Adaptive);
+    auto background = [this](int f) -> float {
+        if (f == FieldOmegaZ) return 1.0f;
+        if (f >= FieldEpsilon2) return _backgroundDerived[f - FieldEpsilon2];
+        return 0.0f;
+    };
+
+    _pool->parallelFor(0, (int)_brickList.size(), [&](int b0, int b1) {
+        for (int b = b0; b < b1; b++) {
+            Brick& brick = *_brickList[b];
+            for (int a = 0; a < 3; a++) {
+                for (int side = -1; side <= 1; side += 2) {
+                    // 相邻砖块
+                    int q[3] = { brick.coord[0], brick.coord[1], brick.coord[2] };
+                    q[a] += side;
+                    bool outside = q[a] < 0 || q[a] >= _bricksPerAxis[a];
+                    bool edge = outside && _boundary != Boundary::Periodic; // 非周期的网格边界
+                    bool fixedEdge = edge && _boundary == Boundary::Dirichlet;
+                    q[a] = (q[a] + _bricksPerAxis[a]) % _bricksPerAxis[a];
+                    const Brick* src = edge ? &brick : _brickAt(q[0], q[1], q[2]);
+
+                    // 幽灵层和来源层在 a 方向上的坐标
+                    int ghost = (side < 0) ? -1 : brick.n[a];
+                    int from = 0;
+                    if (edge) from = (side < 0) ? 0 : brick.n[a] - 1;
+                    else if (src) from = (side < 0) ? src->n[a] - 1 : 0;
+
+                    int u = (a + 1) % 3, v = (a + 2) % 3;
+                    for (int c = 0; c < count; c++) {
+                        int f = fields[c];
+                        float* dst = brick.data[f].data();
+                        bool fixed = fixedEdge && (f == FieldPhi || f == FieldT);
+                        float value = fixed ? (f == FieldT ? _tBoundary : 0.0f) : background(f);
+                        const float* from_f = (src && !fixed) ? src->data[f].data() : nullptr;
+                        bool coarse = adaptive && !from_f && !fixed;
+                        int p[3], r[3];
+                        for (int jv = 0; jv < brick.n[v]; jv++)
+                            for (int ju = 0; ju < brick.n[u]; ju++) {
+                                p[a] = ghost; p[u] = ju; p[v] = jv;
+                                r[a] = from;  r[u] = ju; r[v] = jv;
+                                float& out = dst[at(p[0], p[1], p[2])];
+                                if (from_f) out = from_f[at(r[0], r[1], r[2])];
+                                else if (coarse) out = _coarseValue(f, brick.coord[0] * _brickSize + p[0],
+                                                                    brick.coord[1] * _brickSize + p[1], brick.coord[2] * _brickSize + p[2]);
+                                else out = value;
+                            }
+                    }
+                }
+            }
+        }
+    }, 1);
+}
+
+void Kobayashi3D::_computeBrickAnisotropy()
+{
+    _pool->parallelFor(0, (int)_brickList.size(), [this](int b0, int b1) {
+        for (int b = b0; b < b1; b++) {
+            Block blk = _brickBlock(*_brickList[b]);
+            _computeAnisotropyBlock(blk, 0, blk.nz);
+        }
+    }, 1);
+}
+
+void Kobayashi3D::_solveBrickFields(BlockFn kernel)
+{
+    const bool orientation = _orientationEnabled();
+    const bool measure = diagnostics() && _storage == Storage::Sparse; // Adaptive 按基础网格统计
+    _pool->parallelFor(0, (int)_brickList.size(), [this, kernel, orientation, measure](int b0, int b1) {
+        for (int b = b0; b < b1; b++) {
+            Brick& brick = *_brickList[b];
+            Block blk = _brickBlock(brick);
+            (this->*kernel)(blk, 0, blk.nz);
+            if (measure)
+                _measureBlock(blk, blk.phiNext, blk.tNext, 0, blk.nz,
+                              brick.coord[0] * _brickSize, brick.coord[1] * _brickSize, brick.coord[2] * _brickSize);
+            brick.data[FieldPhi].swap(brick.data[FieldPhiNext]);
+            brick.data[FieldT].swap(brick.data[FieldTNext]);
+            if (orientation) {
+                for (int f = 0; f < 3; f++) brick.data[FieldOmegaX + f].swap(brick.data[FieldOmegaNextX + f]);
+            }
+        }
+    }, 1);
 }
 
 // ==========================================
-// 物理模拟核心：按论文Algorithm 2分离求解
+// Adaptive 存储：两层块结构自适应网格
 // ==========================================
 
-// 解相场方程(17)，计算并存储 ∂η/∂t
-// 公式(17)：∂η/∂t = M_η[∇·(ε²∇η) + ∂/∂z(...) + ∂/∂y(...) - ∂/∂z(ε·∂ε/∂θ·τ) - g'(η) - p'(η)(f_s - f_t + f_ori)]
-void Kobayashi::_solvePhaseField()
+// 加密比是 2 的幂，放大再缩小后 dx、dt 与原值逐位相同
+void Kobayashi3D::_scaleLevel(float factor)
 {
-    for (int k = 0; k < _objectCount.z; k++)
-    {
-        for (int j = 0; j < _objectCount.y; j++)
-        {
-            for (int i = 0; i < _objectCount.x; i++)
-            {
-                // 周期性边界条件
-                int i_plus = (i + 1) % _objectCount.x;
-                int i_minus = ((i - 1) + _objectCount.x) % _objectCount.x;
-                int j_plus = (j + 1) % _objectCount.y;
-                int j_minus = ((j - 1) + _objectCount.y) % _objectCount.y;
-                int k_plus = (k + 1) % _objectCount.z;
-                int k_minus = ((k - 1) + _objectCount.z) % _objectCount.z;
+    _dx *= factor;
+    _dy *= factor;
+    _dz *= factor;
+    _dt *= factor;
+}
 
-                int idx = _INDEX(i, j, k);
+// 一个基础步（Berger-Oliger 式的时间子循环）：
+//   0. 每隔 regrid 步重新划分加密砖块
+//   1. 基础网格以 _amrRatio 倍的间距和步长在整个区域上走一步，加密区下面的格子也照常计算，
+//      交换后 *Next 中是这一步起点的状态，再为终点状态填一次幽灵格
+//   2. 加密砖块走 _amrRatio 个子步。砖块之间的幽灵面取相邻砖块；没有相邻砖块的面由基础网格
+//      在空间上三线性插值，状态场在时间上按子步起点在起点和终点状态之间线性插值
+//   3. 加密砖块的结果平均后写回基础网格（限制），下一步基础网格界面附近的值来自细层
+// 细层与基础网格之间不做通量修正，粗细交界处的温度和相场不严格守恒
+void Kobayashi3D::_adaptiveStep()
+{
+    // 第一步也重新划分一次，按 setParam() 设置的 regrid、amrTol 覆盖晶核
+    if (_stepCount % _regridInterval == 0) _regrid();
+
+    _scaleLevel((float)_amrRatio);
+    _fillHalo();
+    _computeAnisotropy();
+    _solveFields();
+    _fillHalo();
+    _scaleLevel(1.0f / _amrRatio);
+
+    const int state[] = { FieldPhi, FieldT, FieldOmegaX, FieldOmegaY, FieldOmegaZ };
+    const int derived[] = { FieldEpsilon2, FieldFluxY, FieldFluxZ, FieldEpsTauTheta };
+    BlockFn kernel = _solveKernel<float>();
+    for (int s = 0; s < _amrRatio; s++) {
+        _amrTheta = (float)s / _amrRatio;
+        _fillBrickHalo(state, _orientationEnabled() ? 5 : 2);
+        _computeBrickAnisotropy();
+        _fillBrickHalo(derived, 4);
+        _solveBrickFields(kernel);
+    }
+    _restrictBricks();
+}
 
-                // ========== 计算驱动力 (Driving Force) ==========
-                // 驱动力由过冷度（T_eq - T）决定
-                // 公式：m = (α/π)·arctan(γ·(T_eq - T))
-                float m = _alpha / PI_F * atan(_gamma * (_tEq - _t[idx]));
-
-                // 保存旧值
-                float oldPhi = _phi[idx];
-                float oldT = _t[idx];
-                float oldOmegaX = _omega_ori_x[idx];
-                float oldOmegaY = _omega_ori_y[idx];
-                float oldOmegaZ = _omega_ori_z[idx];
-
-                // 获取当前点的各向异性参数
-                float eps = _epsilon[idx];
-                float eps_theta = _epsilonDerivTheta[idx];
-                float eps_phi = _epsilonDerivPhi[idx];
-                float tau = _tau_field[idx];
-                float gradPhiMag = _gradPhiMag[idx];
-
-                // ========== 公式(17)：相场演化方程 ==========
-                // ∂η/∂t = M_η[∇·(ε²∇η) + ∂/∂z(...) + ∂/∂y(...) - ∂/∂z(ε·∂ε/∂θ·τ) - g'(η) - p'(η)(f_s - f_t + f_ori)]
-
-                // 第一项：∇·(ε²∇η) = ε²∇²η + ∇(ε²)·∇η
-                float term_diffusion = eps * eps * _lapPhi[idx];
-
-                // ∇(ε²)·∇η
-                float gradEps2_x = (_epsilon[_INDEX(i_plus, j, k)] * _epsilon[_INDEX(i_plus, j, k)]
-                                  - _epsilon[_INDEX(i_minus, j, k)] * _epsilon[_INDEX(i_minus, j, k)]) / (2.0f * _dx);
-                float gradEps2_y = (_epsilon[_INDEX(i, j_plus, k)] * _epsilon[_INDEX(i, j_plus, k)]
-                                  - _epsilon[_INDEX(i, j_minus, k)] * _epsilon[_INDEX(i, j_minus, k)]) / (2.0f * _dy);
-                float gradEps2_z = (_epsilon[_INDEX(i, j, k_plus)] * _epsilon[_INDEX(i, j, k_plus)]
-                                  - _epsilon[_INDEX(i, j, k_minus)] * _epsilon[_INDEX(i, j, k_minus)]) / (2.0f * _dz);
-
-                float term_grad_eps2 = gradEps2_x * _gradPhiX[idx]
-                                     + gradEps2_y * _gradPhiY[idx]
-                                     + gradEps2_z * _gradPhiZ[idx];
-
-                // 第二项：∂/∂z[ε/τ·∂ε/∂θ·∂η/∂x - ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂y]
-                // 计算 z+ 和 z- 处的值
-                float val_z_plus, val_z_minus;
-                {
-                    int idx_zp = _INDEX(i, j, k_plus);
-                    float eps_zp = _epsilon[idx_zp];
-                    float tau_zp = _tau_field[idx_zp];
-                    float eps_theta_zp = _epsilonDerivTheta[idx_zp];
-                    float eps_phi_zp = _epsilonDerivPhi[idx_zp];
-                    float gradPhiMag2_zp = _gradPhiMag[idx_zp] * _gradPhiMag[idx_zp];
-
-                    // 添加数值稳定性：tau_zp 太小时设为 FLT_EPSILON
-                    float tau_zp_safe = fmax(tau_zp, FLT_EPSILON);
-                    val_z_plus = (eps_zp / tau_zp_safe) * eps_theta_zp * _gradPhiX[idx_zp]
-                               - (eps_zp / (tau_zp_safe * tau_zp_safe)) * eps_phi_zp * gradPhiMag2_zp * _gradPhiY[idx_zp];
-                }
-                {
-                    int idx_zm = _INDEX(i, j, k_minus);
-                    float eps_zm = _epsilon[idx_zm];
-                    float tau_zm = _tau_field[idx_zm];
-                    float eps_theta_zm = _epsilonDerivTheta[idx_zm];
-                    float eps_phi_zm = _epsilonDerivPhi[idx_zm];
-                    float gradPhiMag2_zm = _gradPhiMag[idx_zm] * _gradPhiMag[idx_zm];
-
-                    // 添加数值稳定性：tau_zm 太小时设为 FLT_EPSILON
-                    float tau_zm_safe = fmax(tau_zm, FLT_EPSILON);
-                    val_z_minus = (eps_zm / tau_zm_safe) * eps_theta_zm * _gradPhiX[idx_zm]
-                                - (eps_zm / (tau_zm_safe * tau_zm_safe)) * eps_phi_zm * gradPhiMag2_zm * _gradPhiY[idx_zm];
-                }
-                float term_z = (val_z_plus - val_z_minus) / (2.0f * _dz);
-
-                // 第三项：∂/∂y[ε/τ·∂ε/∂θ·∂η/∂z + ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂x]
-                float val_y_plus, val_y_minus;
-                {
-                    int idx_yp = _INDEX(i, j_plus, k);
-                    float eps_yp = _epsilon[idx_yp];
-                    float tau_yp = _tau_field[idx_yp];
-                    float eps_theta_yp = _epsilonDerivTheta[idx_yp];
-                    float eps_phi_yp = _epsilonDerivPhi[idx_yp];
-                    float gradPhiMag2_yp = _gradPhiMag[idx_yp] * _gradPhiMag[idx_yp];
-
-                    // 添加数值稳定性
-                    float tau_yp_safe = fmax(tau_yp, FLT_EPSILON);
-                    val_y_plus = (eps_yp / tau_yp_safe) * eps_theta_yp * _gradPhiZ[idx_yp]
-                               + (eps_yp / (tau_yp_safe * tau_yp_safe)) * eps_phi_yp * gradPhiMag2_yp * _gradPhiX[idx_yp];
+// 细层格子中心在基础网格坐标中位于 (g + 0.5)/r - 0.5，取它两侧的基础格三线性插值。
+// 细层坐标可以比内部格多出一格（幽灵格），用到的基础格不超出基础网格的幽灵层。
+// 通量项只在基础步起点计算，不做时间插值
+float Kobayashi3D::_coarseValue(int f, int gi, int gj, int gk) const
+{
+    const std::vector<float>* now = nullptr;
+    const std::vector<float>* old = nullptr;
+    switch (f) {
+    case FieldPhi:         now = &_phi;         old = &_phiNext; break;
+    case FieldT:           now = &_t;           old = &_tNext; break;
+    case FieldOmegaX:      now = &_omega_ori_x; old = &_omega_next_x; break;
+    case FieldOmegaY:      now = &_omega_ori_y; old = &_omega_next_y; break;
+    case FieldOmegaZ:      now = &_omega_ori_z; old = &_omega_next_z; break;
+    case FieldEpsilon2:    now = &_epsilon2; break;
+    case FieldFluxY:       now = &_fluxY; break;
+    case FieldFluxZ:       now = &_fluxZ; break;
+    case FieldEpsTauTheta: now = &_epsTauTheta; break;
+    default: return 0.0f;
+    }
+    if (f >= FieldOmegaX && f <= FieldOmegaZ && !_orientationEnabled()) old = nullptr; // H = 0 时取向场不变，*Next 没有交换
+
+    const float inv = 1.0f / _amrRatio;
+    int g[3] = { gi, gj, gk }, c0[3];
+    float w[3];
+    for (int a = 0; a < 3; a++) {
+        float x = (g[a] + 0.5f) * inv - 0.5f;
+        c0[a] = (int)std::floor(x);
+        w[a] = x - c0[a];
+    }
+    float value = 0.0f;
+    for (int dk = 0; dk < 2; dk++)
+        for (int dj = 0; dj < 2; dj++)
+            for (int di = 0; di < 2; di++) {
+                float weight = (di ? w[0] : 1.0f - w[0]) * (dj ? w[1] : 1.0f - w[1]) * (dk ? w[2] : 1.0f - w[2]);
+                int idx = _INDEX(c0[0] + di, c0[1] + dj, c0[2] + dk);
+                float v = (*now)[idx];
+                if (old && _amrTheta < 1.0f) v = (*old)[idx] + _amrTheta * (v - (*old)[idx]);
+                value += weight * v;
+            }
+    return value;
+}
+
+// 每个基础格取它覆盖的 _amrRatio³ 个细格的平均；取向场平均后重新归一化
+void Kobayashi3D::_restrictBricks()
+{
+    const bool orientation = _orientationEnabled();
+    const int r = _amrRatio, s = _brickSize + 2;
+    const float inv = 1.0f / (r * r * r);
+    _pool->parallelFor(0, (int)_brickList.size(), [&](int b0, int b1) {
+        for (int b = b0; b < b1; b++) {
+            const Brick& brick = *_brickList[b];
+            for (int k = 0; k < brick.n[2] / r; k++)
+                for (int j = 0; j < brick.n[1] / r; j++)
+                    for (int i = 0; i < brick.n[0] / r; i++) {
+                        float sum[5] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+                        for (int dk = 0; dk < r; dk++)
+                            for (int dj = 0; dj < r; dj++)
+                                for (int di = 0; di < r; di++) {
+                                    int idx = (i * r + di + 1) + s * ((j * r + dj + 1) + s * (k * r + dk + 1));
+                                    for (int f = 0; f < (orientation ? 5 : 2); f++) sum[f] += brick.data[FieldPhi + f][idx];
+                                }
+                        int idx = _INDEX(brick.coord[0] * _brickSize / r + i, brick.coord[1] * _brickSize / r + j,
+                                         brick.coord[2] * _brickSize / r + k);
+                        _phi[idx] = sum[0] * inv;
+                        _t[idx] = sum[1] * inv;
+                        if (orientation) {
+                            float len = std::sqrt(sum[2] * sum[2] + sum[3] * sum[3] + sum[4] * sum[4]);
+                            if (len > FLT_EPSILON) {
+                                _omega_ori_x[idx] = sum[2] / len;
+                                _omega_ori_y[idx] = sum[3] / len;
+                                _omega_ori_z[idx] = sum[4] / len;
+                            }
+                        }
+                    }
+        }
+    }, 1);
+}
+
+// 标记基础网格上 phi 与 6 个邻居的最大差超过 amrTol 的格子（界面带和尖锐的晶核），
+// 覆盖标记格向外 margin 格范围的细层砖块都要加密。界面一个细层子步移动不到一个细格，
+// 两次重新划分之间最多移动 regrid 个基础格，所以 margin = regrid + 1 时界面不会离开加密区。
+// 保留仍需要的砖块，新砖块由基础网格当前的状态插值，多余的砖块在限制后释放
+void Kobayashi3D::_regrid()
+{
+    int nx = _objectCount.x, ny = _objectCount.y, nz = _objectCount.z;
+    int nb[3] = { _bricksPerAxis[0], _bricksPerAxis[1], _bricksPerAxis[2] };
+    int cells = _brickSize / _amrRatio; // 一个砖块覆盖的基础格数
+    int margin = _regridInterval + 1;
+    _fillHalo(); // 限制后的状态，供标记和插值
+
+    // 1. 按 z 层并行标记基础格
+    std::vector<unsigned char> tagged((size_t)nx * ny * nz, 0);
+    _pool->parallelFor(0, nz, [&](int k0, int k1) {
+        for (int k = k0; k < k1; k++)
+            for (int j = 0; j < ny; j++)
+                for (int i = 0; i < nx; i++) {
+                    float c = _phi[_INDEX(i, j, k)];
+                    float lo = c, hi = c;
+                    const float nbr[6] = { _phi[_INDEX(i - 1, j, k)], _phi[_INDEX(i + 1, j, k)], _phi[_INDEX(i, j - 1, k)],
+                                           _phi[_INDEX(i, j + 1, k)], _phi[_INDEX(i, j, k - 1)], _phi[_INDEX(i, j, k + 1)] };
+                    for (float v : nbr) { lo = std::min(lo, v); hi = std::max(hi, v); }
+                    tagged[(size_t)i + (size_t)nx * (j + (size_t)ny * k)] = (hi - lo > _amrTol);
                 }
-                {
-                    int idx_ym = _INDEX(i, j_minus, k);
-                    float eps_ym = _epsilon[idx_ym];
-                    float tau_ym = _tau_field[idx_ym];
-                    float eps_theta_ym = _epsilonDerivTheta[idx_ym];
-                    float eps_phi_ym = _epsilonDerivPhi[idx_ym];
-                    float gradPhiMag2_ym = _gradPhiMag[idx_ym] * _gradPhiMag[idx_ym];
-
-                    // 添加数值稳定性
-                    float tau_ym_safe = fmax(tau_ym, FLT_EPSILON);
-                    val_y_minus = (eps_ym / tau_ym_safe) * eps_theta_ym * _gradPhiZ[idx_ym]
-                                + (eps_ym / (tau_ym_safe * tau_ym_safe)) * eps_phi_ym * gradPhiMag2_ym * _gradPhiX[idx_ym];
+    }, 1);
+
+    // 2. 需要的砖块：周期边界时按周期相邻，否则截断在网格内
+    std::vector<unsigned char> keep(_bricks.size(), 0);
+    auto range = [&](int c, int a, int& lo, int& hi) {
+        lo = (int)std::floor((float)(c - margin) / cells);
+        hi = (int)std::floor((float)(c + margin) / cells);
+        if (_boundary != Boundary::Periodic) { lo = std::max(lo, 0); hi = std::min(hi, nb[a] - 1); }
+    };
+    for (int k = 0; k < nz; k++)
+        for (int j = 0; j < ny; j++)
+            for (int i = 0; i < nx; i++) {
+                if (!tagged[(size_t)i + (size_t)nx * (j + (size_t)ny * k)]) continue;
+                int lo[3], hi[3], c[3] = { i, j, k };
+                for (int a = 0; a < 3; a++) range(c[a], a, lo[a], hi[a]);
+                for (int z = lo[2]; z <= hi[2]; z++)
+                    for (int y = lo[1]; y <= hi[1]; y++)
+                        for (int x = lo[0]; x <= hi[0]; x++) {
+                            int q[3] = { (x + nb[0]) % nb[0], (y + nb[1]) % nb[1], (z + nb[2]) % nb[2] };
+                            keep[(size_t)q[0] + (size_t)nb[0] * (q[1] + (size_t)nb[1] * q[2])] = 1;
+                        }
+            }
+
+    // 3. 按砖块坐标顺序重建 _brickList
+    std::vector<Brick*> created;
+    _brickList.clear();
+    for (int z = 0; z < nb[2]; z++)
+        for (int y = 0; y < nb[1]; y++)
+            for (int x = 0; x < nb[0]; x++) {
+                size_t id = (size_t)x + (size_t)nb[0] * (y + (size_t)nb[1] * z);
+                if (keep[id] && !_bricks[id]) created.push_back(_allocateBrick(x, y, z));
+                else if (keep[id]) _brickList.push_back(_bricks[id].get());
+                else _bricks[id].reset();
+            }
+
+    // 4. 新砖块的状态场由基础网格当前的状态插值
+    const bool orientation = _orientationEnabled();
+    const int s = _brickSize + 2;
+    _amrTheta = 1.0f;
+    _pool->parallelFor(0, (int)created.size(), [&](int b0, int b1) {
+        for (int b = b0; b < b1; b++) {
+            Brick& brick = *created[b];
+            for (int k = 0; k < brick.n[2]; k++)
+                for (int j = 0; j < brick.n[1]; j++)
+                    for (int i = 0; i < brick.n[0]; i++) {
+                        int idx = (i + 1) + s * ((j + 1) + s * (k + 1));
+                        int g[3] = { brick.coord[0] * _brickSize + i, brick.coord[1] * _brickSize + j, brick.coord[2] * _brickSize + k };
+                        for (int f = FieldPhi; f <= (orientation ? FieldOmegaZ : FieldT); f++)
+                            brick.data[f][idx] = _coarseValue(f, g[0], g[1], g[2]);
+                    }
+        }
+    }, 1);
+}
+
+// ==========================================
+// 双分辨率温度场
+// ==========================================
+
+void Kobayashi3D::setThermalGrid(int ratio, int pad) {
+    _snapshot.stepCount = -1;
+    if (_storage != Storage::Dense || _symmetry != Symmetry::None) return;
+    ratio = std::max(1, ratio);
+    if (ratio > 1) setPrecision(Precision::Single); // 双分辨率只支持 Single
+    pad = (ratio > 1 && _boundary != Boundary::Periodic) ? std::max(0, pad) : 0;
+    int nx = _objectCount.x, ny = _objectCount.y, nz = _objectCount.z;
+
+    // 现有的温度场先回到细网格
+    if (_thermalRatio > 1) {
+        fillHalo3D(_tCoarse, _thermalCount.x, _thermalCount.y, _thermalCount.z, _boundary, _tBoundary);
+        _t.assign(_phi.size(), 0.0f);
+        _tNext.assign(_phi.size(), 0.0f);
+        std::vector<float> column;
+        for (int k = 0; k < nz; k++)
+            for (int j = 0; j < ny; j++) _coarseTemperatureRow(j, k, column, &_t[_INDEX(0, j, k)]);
+    }
+    _thermalRatio = ratio;
+    _thermalPad = pad;
+    if (ratio == 1) {
+        _thermalCount = { 0, 0, 0 };
+        std::vector<float>().swap(_tCoarse);
+        std::vector<float>().swap(_tCoarseNext);
+        return;
+    }
+
+    int count[3] = { nx, ny, nz };
+    for (int a = 0; a < 3; a++) coarseInterpolation(count[a], ratio, pad, _thermalIndex[a], _thermalWeight[a]);
+    _thermalCount = { coarseCount(nx, ratio, pad), coarseCount(ny, ratio, pad), coarseCount(nz, ratio, pad) };
+    size_t size = (size_t)(_thermalCount.x + 2) * (_thermalCount.y + 2) * (_thermalCount.z + 2);
+    _tCoarse.assign(size, 0.0f);
+    _tCoarseNext.assign(size, 0.0f);
+    _restrictTemperature();
+    std::vector<float>().swap(_t);
+    std::vector<float>().swap(_tNext);
+}
+
+// 三线性插值，粗网格的幽灵格由 _fillHalo() 填好。先在 y、z 方向把相邻的 4 行粗格插值成一行，
+// 再在 x 方向插值到细格，每个粗格的 y、z 插值只做一次
+void Kobayashi3D::_coarseTemperatureRow(int j, int k, std::vector<float>& column, float* out) const
+{
+    const int cx = _thermalCount.x;
+    const int sy = cx + 2, sz = sy * (_thermalCount.y + 2);
+    const float* t = _tCoarse.data() + _COARSE(-1, _thermalIndex[1][j], _thermalIndex[2][k]);
+    float wy = _thermalWeight[1][j], wz = _thermalWeight[2][k];
+    auto lerp = [](float a, float b, float w) { return a + w * (b - a); };
+    column.resize(cx + 2);
+    for (int c = 0; c < cx + 2; c++)
+        column[c] = lerp(lerp(t[c], t[c + sy], wy), lerp(t[c + sz], t[c + sz + sy], wy), wz);
+    for (int i = 0; i < _objectCount.x; i++) {
+        int c = _thermalIndex[0][i] + 1;
+        out[i] = lerp(column[c], column[c + 1], _thermalWeight[0][i]);
+    }
+}
+
+// 求解之后 _phi 是新的相场、_phiNext 是旧的相场。每个粗格加上拉普拉斯算子（间距 ratio·dx，模板与细网格相同）的扩散，
+// 以及所覆盖细格 K·Δη 之和除以 ratio³，相场区域内的总热量与单一网格时相同。
+// 潜热取限制在 [0, 1] 之后的 Δη，与单一网格时的 K·∂η/∂t·dt 只在限制生效的格子上不同
+void Kobayashi3D::_thermalStep()
+{
+    const int r = _thermalRatio, pad = _thermalPad;
+    const int cx = _thermalCount.x, cy = _thermalCount.y;
+    const float dxc = r * _dx;
+    const float latentK = _K / (float)(r * r * r);
+    const int points = _stencilPoints();
+    const bool measure = diagnostics();
+    _pool->parallelFor(0, _thermalCount.z, [&](int k0, int k1) {
+        const float* t = _tCoarse.data();
+        auto at = [t](int n) { return t[n]; };
+        for (int K = k0; K < k1; K++)
+            for (int J = 0; J < cy; J++)
+                for (int I = 0; I < cx; I++) {
+                    int c = _COARSE(I, J, K);
+                    float lapT = stencilLaplacian<float>(at, c, cx + 2, (cx + 2) * (cy + 2), points, dxc * dxc);
+
+                    // 所覆盖的细格（相场网格外的粗格没有潜热）
+                    float latent = 0.0f;
+                    int i0 = std::max(0, (I - pad) * r), i1 = std::min(_objectCount.x, (I - pad + 1) * r);
+                    int j0 = std::max(0, (J - pad) * r), j1 = std::min(_objectCount.y, (J - pad + 1) * r);
+                    int kk0 = std::max(0, (K - pad) * r), kk1 = std::min(_objectCount.z, (K - pad + 1) * r);
+                    for (int k = kk0; k < kk1; k++)
+                        for (int j = j0; j < j1; j++)
+                            for (int i = i0; i < i1; i++) latent += _phi[_INDEX(i, j, k)] - _phiNext[_INDEX(i, j, k)];
+
+                    _tCoarseNext[c] = t[c] + _alpha_T * lapT * _dt + latentK * latent;
                 }
-                float term_y = (val_y_plus - val_y_minus) / (2.0f * _dy);
+        if (measure) {
+            GrowthStats s;
+            for (int K = k0; K < k1; K++)
+                for (int J = 0; J < cy; J++) s.addRow<float>(nullptr, &_tCoarseNext[_COARSE(0, J, K)], cx, 0, J, K);
+            std::lock_guard<std::mutex> lock(_statsLock);
+            _stepStats.merge(s);
+        }
+    }, 1);
+    _tCoarse.swap(_tCoarseNext);
+}
 
-                // 第四项：-∂/∂z(ε·∂ε/∂θ·τ)
-                float val_eps_tau_z_plus = _epsilon[_INDEX(i, j, k_plus)] * _epsilonDerivTheta[_INDEX(i, j, k_plus)] * _tau_field[_INDEX(i, j, k_plus)];
-                float val_eps_tau_z_minus = _epsilon[_INDEX(i, j, k_minus)] * _epsilonDerivTheta[_INDEX(i, j, k_minus)] * _tau_field[_INDEX(i, j, k_minus)];
-                float term_eps_tau = -(val_eps_tau_z_plus - val_eps_tau_z_minus) / (2.0f * _dz);
+// 每个粗格取所覆盖细格的平均，相场网格外的粗格取 Dirichlet 边界的温度（其余边界取 0）
+void Kobayashi3D::_restrictTemperature()
+{
+    const int r = _thermalRatio, pad = _thermalPad;
+    float outside = (_boundary == Boundary::Dirichlet) ? _tBoundary : 0.0f;
+    for (int K = 0; K < _thermalCount.z; K++)
+        for (int J = 0; J < _thermalCount.y; J++)
+            for (int I = 0; I < _thermalCount.x; I++) {
+                int i0 = std::max(0, (I - pad) * r), i1 = std::min(_objectCount.x, (I - pad + 1) * r);
+                int j0 = std::max(0, (J - pad) * r), j1 = std::min(_objectCount.y, (J - pad + 1) * r);
+                int k0 = std::max(0, (K - pad) * r), k1 = std::min(_objectCount.z, (K - pad + 1) * r);
+                float sum = 0.0f;
+                int count = 0;
+                for (int k = k0; k < k1; k++)
+                    for (int j = j0; j < j1; j++)
+                        for (int i = i0; i < i1; i++, count++) sum += _t[_INDEX(i, j, k)];
+                _tCoarse[_COARSE(I, J, K)] = count > 0 ? sum / count : outside;
+            }
+}
 
-                // 第五项：-g'(η)，其中 g(η) = η²(η-1)²/4
-                // g'(η) = η(η-1)(η-0.5)
-                float g_prime = oldPhi * (oldPhi - 1.0f) * (oldPhi - 0.5f);
+// ==========================================
+// 公式(19)的各向异性系数及其导数
+// ==========================================
 
-                // 第六项：-p'(η)(f_s - f_t + f_ori)
-                // p(η) = η²(3-2η), p'(η) = 6η(1-η)
-                float p_prime = 6.0f * oldPhi * (1.0f - oldPhi);
+// 原始实现（AnisotropyMode::Trig）：Ω = -∇η 经 Rodrigues 旋转到以 Ω_ori 为 z 轴的局部坐标，
+// 再用 acos/atan2 求局部球坐标 (θ̃, φ̃)，代入公式(19)
+template <class R>
+inline void trigCubicAnisotropy(R gradPhiX, R gradPhiY, R gradPhiZ, R gradPhiMag,
+                                R omega_p_x, R omega_p_y, R omega_p_z, R c1, R c2,
+                                R& eps, R& eps_theta, R& eps_phi)
+{
+    // Ω = -∇η (归一化)
+    R omega_x = 0.0f, omega_y = 0.0f, omega_z = 0.0f;
+    if (gradPhiMag > FLT_EPSILON) {
+        omega_x = -gradPhiX / gradPhiMag;
+        omega_y = -gradPhiY / gradPhiMag;
+        omega_z = -gradPhiZ / gradPhiMag;
+    }
 
-                // 使用已经计算好的取向场梯度模
-                float gradOmegaOriMag = _gradOmegaOriMag[idx];
+    // 将 Ω 从全局坐标转换到以 Ω_ori 为z轴的局部坐标
+    // 使用 Rodrigues 旋转公式
+    // k = u_ori × u0，Θ = θ_ori
+    R theta_ori = acos(fmax(-1.0f, fmin(1.0f, omega_p_z)));
+
+    // 旋转 Ω 到局部坐标系
+    R omega_rot_x, omega_rot_y, omega_rot_z;
+    rodriguesRotation(omega_x, omega_y, omega_z,
+                     omega_p_x, omega_p_y, omega_p_z,
+                     theta_ori,
+                     omega_rot_x, omega_rot_y, omega_rot_z);
+
+    // 从旋转后的向量计算局部球坐标 (θ̃, φ̃)
+    R theta_tilde = acos(fmax(-1.0f, fmin(1.0f, omega_rot_z)));
+    R phi_tilde = atan2(omega_rot_y, omega_rot_x);
+
+    // 计算三角函数值
+    R sin_theta_t = sin(theta_tilde);
+    R cos_theta_t = cos(theta_tilde);
+    R sin_phi_t = sin(phi_tilde);
+    R cos_phi_t = cos(phi_tilde);
+
+    R sin2_theta_t = sin_theta_t * sin_theta_t;
+    R cos2_theta_t = cos_theta_t * cos_theta_t;
+    R sin2_phi_t = sin_phi_t * sin_phi_t;
+    R cos2_phi_t = cos_phi_t * cos_phi_t;
+
+    R sin4_theta_t = sin2_theta_t * sin2_theta_t;
+    R cos4_theta_t = cos2_theta_t * cos2_theta_t;
+    R sin4_phi_t = sin2_phi_t * sin2_phi_t;
+    R cos4_phi_t = cos2_phi_t * cos2_phi_t;
+
+    // 公式(19)：ε_o(n) = c1 + c2(sin⁴θ̃(sin⁴φ̃ + cos⁴φ̃) + cos⁴θ̃)
+    eps = c1 + c2 * (sin4_theta_t * (sin4_phi_t + cos4_phi_t) + cos4_theta_t);
+
+    // 计算各向异性系数对 θ̃ 的导数
+    // ∂ε_o/∂θ̃ = c2 * (4sin³θ̃cosθ̃(sin⁴φ̃ + cos⁴φ̃) - 4cos³θ̃sinθ̃)
+    eps_theta = c2 * (4.0f * sin2_theta_t * sin_theta_t * cos_theta_t * (sin4_phi_t + cos4_phi_t)
+                     - 4.0f * cos2_theta_t * cos_theta_t * sin_theta_t);
+
+    // 计算各向异性系数对 φ̃ 的导数
+    // ∂ε_o/∂φ̃ = c2 * sin⁴θ̃ * 4sinφ̃cosφ̃(sin²φ̃ - cos²φ̃)
+    eps_phi = c2 * sin4_theta_t * 4.0f * sin_phi_t * cos_phi_t * (sin2_phi_t - cos2_phi_t);
+}
 
-                // f_s - f_t + f_ori
-                // f_t = 0 (液相自由能), f_s = -m/6 (固相自由能), f_ori = H·||∇Ω_ori||
-                float f_diff = -m / 6.0f + _H * gradOmegaOriMag;
+// 代数实现（AnisotropyMode::Algebraic）：只用乘加、两次倒数和一次倒数平方根
+//
+// 设旋转后的（未归一化）方向为 (X, Y, Z)，G² = X² + Y² + Z²，P = X² + Y²，则
+//   sinθ̃ = √P / G，cosθ̃ = Z / G，sinφ̃ = Y / √P，cosφ̃ = X / √P
+// 代入公式(19)，三角函数的四次方全部变成方向余弦的多项式：
+//   ε_o       = c1 + c2 (X⁴ + Y⁴ + Z⁴) / G⁴
+//   ∂ε_o/∂θ̃  = 4 c2 Z (X⁴ + Y⁴ - Z² P) / (G⁴ √P)
+//   ∂ε_o/∂φ̃  = 4 c2 X Y (Y² - X²) / G⁴
+// 局部坐标系的旋转（把 Ω_ori 转到 z 轴）也不需要角度：取 k = Ω_ori × e_z（未归一化，|k| = sinΘ），
+// Rodrigues 公式 v + sinΘ·K̂v + (1-cosΘ)·K̂²v 化为 v + Kv + K²v / (1 + cosΘ)，cosΘ = Ω_ori,z
+//
+// 与原始实现相同的约定：|∇η| ≤ FLT_EPSILON 时原始实现的旋转结果是零向量，acos(0)、atan2(0, 0)
+// 相当于局部方向 (1, 0, 0)；Ω_ori 与 z 轴平行时不旋转；√P = 0 时 ∂ε/∂θ̃ = 0
+template <class R>
+inline void algebraicCubicAnisotropy(R gradPhiX, R gradPhiY, R gradPhiZ,
+                                     R omega_p_x, R omega_p_y, R omega_p_z, R c1, R c2,
+                                     R& eps, R& eps_theta, R& eps_phi)
+{
+    const R tiny = FLT_EPSILON * FLT_EPSILON;
+
+    // Ω = -∇η，不需要归一化（下面的比值与长度无关）
+    R vx = -gradPhiX, vy = -gradPhiY, vz = -gradPhiZ;
+    bool flat = vx * vx + vy * vy + vz * vz <= tiny;
+
+    // 旋转到局部坐标：k = (u_y, -u_x, 0)
+    // 1 / (1 + cosΘ) 在 cosΘ → -1 时相消严重，此时改用等价的 (1 - cosΘ) / sin²Θ
+    R kx = omega_p_y, ky = -omega_p_x;
+    R s2 = kx * kx + ky * ky;
+    R w = omega_p_z >= 0.0f ? 1.0f / (1.0f + omega_p_z) : (1.0f - omega_p_z) / (s2 > tiny ? s2 : 1.0f);
+    w = s2 > tiny ? w : 0.0f;
+
+    // K·v 与 K²·v = (k·v)k - |k|²v（k_z = 0）
+    R Kv_x = ky * vz;
+    R Kv_y = -kx * vz;
+    R Kv_z = -ky * vx + kx * vy;
+    R kv = kx * vx + ky * vy;
+
+    R X = vx + Kv_x + (kv * kx - s2 * vx) * w;
+    R Y = vy + Kv_y + (kv * ky - s2 * vy) * w;
+    R Z = vz + Kv_z + (-s2 * vz) * w;
+    X = flat ? 1.0f : X;
+    Y = flat ? 0.0f : Y;
+    Z = flat ? 0.0f : Z;
+
+    R X2 = X * X, Y2 = Y * Y, Z2 = Z * Z;
+    R P = X2 + Y2;
+    R G2 = P + Z2;
+    R invG4 = 1.0f / (G2 * G2);
+    R invSqrtP = P > tiny * G2 ? 1.0f / std::sqrt(P > tiny * G2 ? P : 1.0f) : 0.0f;
+    R XY4 = X2 * X2 + Y2 * Y2;
+
+    eps = c1 + c2 * (XY4 + Z2 * Z2) * invG4;
+    eps_theta = 4.0f * c2 * Z * (XY4 - Z2 * P) * invG4 * invSqrtP;
+    eps_phi = 4.0f * c2 * X * Y * (Y2 - X2) * invG4;
+}
 
-                // 计算 ∂η/∂t 并存储，不更新 _phi
-                _dPhiDt[idx] = M_eta * (term_diffusion + term_grad_eps2 + term_z + term_y + term_eps_tau
-                                      - g_prime - p_prime * f_diff);
+// 由 ε 及其导数组合出相场方程(17)中邻居需要的量（见 _computeAnisotropyBlock()）。
+// τ 小于 FLT_EPSILON 时按 FLT_EPSILON 计算：∇η 几乎平行于 z 轴的格子上 ∂ε/∂θ̃ 的误差被放大到 1/FLT_EPSILON 倍
+template <class R>
+inline void anisotropyFluxes(R gradPhiX, R gradPhiY, R gradPhiZ, R gradPhiMag, R tau, R eps, R eps_theta, R eps_phi,
+                             R& epsilon2, R& fluxY, R& fluxZ, R& epsTauTheta)
+{
+    R tau_safe = fmax(tau, FLT_EPSILON);
+    R gradPhiMag2 = gradPhiMag * gradPhiMag;
+    epsilon2 = eps * eps;
+    fluxZ = (eps / tau_safe) * eps_theta * gradPhiX
+          - (eps / (tau_safe * tau_safe)) * eps_phi * gradPhiMag2 * gradPhiY;
+    fluxY = (eps / tau_safe) * eps_theta * gradPhiZ
+          + (eps / (tau_safe * tau_safe)) * eps_phi * gradPhiMag2 * gradPhiX;
+    epsTauTheta = eps * eps_theta * tau;
+}
+
+// ==========================================
+// 物理模拟核心：各向异性与通量项
+// ==========================================
+
+// 算法1：计算取向场梯度的模 ||∇Ω_ori||
+// 对 6 个邻居计算中心角 ρ 和立体投影角 λ，只在寄存器中使用，不写回内存
+// 参考：Algorithm 1 - Calculation of ∇Ω_ori
+template <class S>
+typename FieldTraits<S>::Real Kobayashi3D::_orientationGradientMag(const BlockOf<S>& blk, int idx, int idx_xp, int idx_xm, int idx_yp, int idx_ym, int idx_zp, int idx_zm)
+{
+    typedef FieldTraits<S> F;
+    typedef typename F::Real R;
+    auto omegaX = [&](int n) -> R { return F::load(blk.omegaX[n]); };
+    auto omegaY = [&](int n) -> R { return F::load(blk.omegaY[n]); };
+    auto omegaZ = [&](int n) -> R { return F::load(blk.omegaZ[n]); };
+
+    // 当前点的取向 ω_p
+    R omega_p_x = omegaX(idx);
+    R omega_p_y = omegaY(idx);
+    R omega_p_z = omegaZ(idx);
+
+    auto rho = [&](int idx_q) {
+        return centralAngle<R>(omega_p_x, omega_p_y, omega_p_z, omegaX(idx_q), omegaY(idx_q), omegaZ(idx_q));
+    };
+    auto lambda = [&](int idx_q) {
+        return stereographicAngle<R>(omega_p_x, omega_p_y, omega_p_z, omegaX(idx_q), omegaY(idx_q), omegaZ(idx_q));
+    };
+
+    // 使用 (ρ, λ) 场的梯度来近似
+    // ||∇Ω_ori|| ≈ sqrt((∂ρ/∂x)² + (∂ρ/∂y)² + (∂ρ/∂z)² + (∂λ/∂x)² + (∂λ/∂y)² + (∂λ/∂z)²)
+    // 注意：ρ 是中心角，范围 [0, π]，不需要特殊处理
+    R grad_rho_x = (rho(idx_xp) - rho(idx_xm)) / (2.0f * _dx);
+    R grad_rho_y = (rho(idx_yp) - rho(idx_ym)) / (2.0f * _dy);
+    R grad_rho_z = (rho(idx_zp) - rho(idx_zm)) / (2.0f * _dz);
+
+    // λ 是极坐标角度，范围 [0, 2π]，需要处理周期性
+    R grad_lambda_x = angleDifference<R>(lambda(idx_xp), lambda(idx_xm)) / (2.0f * _dx);
+    R grad_lambda_y = angleDifference<R>(lambda(idx_yp), lambda(idx_ym)) / (2.0f * _dy);
+    R grad_lambda_z = angleDifference<R>(lambda(idx_zp), lambda(idx_zm)) / (2.0f * _dz);
+
+    return sqrt(grad_rho_x * grad_rho_x + grad_rho_y * grad_rho_y + grad_rho_z * grad_rho_z
+              + grad_lambda_x * grad_lambda_x + grad_lambda_y * grad_lambda_y + grad_lambda_z * grad_lambda_z);
+}
+
+// 计算各向异性系数，以及相场方程(17)中需要在邻居处取值的组合量：
+//   _epsilon2    : ε²                                              （±x、±y、±z 邻居）
+//   _fluxZ       : ε/τ·∂ε/∂θ·∂η/∂x - ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂y      （±z 邻居）
+//   _fluxY       : ε/τ·∂ε/∂θ·∂η/∂z + ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂x      （±y 邻居）
+//   _epsTauTheta : ε·∂ε/∂θ·τ                                        （±z 邻居）
+// 梯度、τ、ε 的导数等只在寄存器中使用
+template <class S>
+void Kobayashi3D::_computeAnisotropyBlock(const BlockOf<S>& blk, int k0, int k1)
+{
+    typedef FieldTraits<S> F;
+    typedef typename F::Real R;
+    auto phi = [&](int n) -> R { return F::load(blk.phi[n]); };
+    auto omegaX = [&](int n) -> R { return F::load(blk.omegaX[n]); };
+    auto omegaY = [&](int n) -> R { return F::load(blk.omegaY[n]); };
+    auto omegaZ = [&](int n) -> R { return F::load(blk.omegaZ[n]); };
+    const bool algebraic = _anisotropyMode == AnisotropyMode::Algebraic;
+    const bool vector = algebraic && _simd && simdData(blk.phi); // 整行交给 SIMD 内核
+
+    for (RowWalk w(blk.ny, k0, k1); w.next(); )
+    {
+        const int j = w.j, k = w.k;
+        if (vector) {
+            int o = blk.index(0, j, k), d = blk.derivedIndex(0, j, k);
+            SimdAnisotropyRow3D row = { simdData(blk.phi) + o, simdData(blk.omegaX) + o, simdData(blk.omegaY) + o, simdData(blk.omegaZ) + o,
+                                        simdData(blk.epsilon2) + d, simdData(blk.fluxY) + d, simdData(blk.fluxZ) + d, simdData(blk.epsTauTheta) + d,
+                                        blk.nx, blk.sx, blk.sx * blk.sy, _dx, _dy, _dz, _c1, _c2 };
+            _simd->anisotropyRow3D(row);
+            continue;
+        }
+        for (int i = 0; i < blk.nx; i++)
+        {
+            // 邻居下标：边界外的邻居落在幽灵格上，已由 _fillHalo() 按边界条件填好
+            int i_plus = i + 1;
+            int i_minus = i - 1;
+            int j_plus = j + 1;
+            int j_minus = j - 1;
+            int k_plus = k + 1;
+            int k_minus = k - 1;
+
+            int idx = blk.index(i, j, k);
+
+            // ========== 1. 计算相场梯度 (Gradient / 梯度) ==========
+            // 物理意义：相场变化的”坡度”，用于确定界面法线方向
+            // 公式：∂η/∂x ≈ (η(i+1,j,k) - η(i-1,j,k)) / (2·Δx)  [中心差分法]
+            R gradPhiX = (phi(blk.index(i_plus, j, k)) - phi(blk.index(i_minus, j, k))) / (2.0f * _dx);
+            R gradPhiY = (phi(blk.index(i, j_plus, k)) - phi(blk.index(i, j_minus, k))) / (2.0f * _dy);
+            R gradPhiZ = (phi(blk.index(i, j, k_plus)) - phi(blk.index(i, j, k_minus))) / (2.0f * _dz);
+
+            // 计算梯度模：|∇η| = sqrt((∂η/∂x)² + (∂η/∂y)² + (∂η/∂z)²)
+            R gradPhiMag = sqrt(gradPhiX * gradPhiX + gradPhiY * gradPhiY + gradPhiZ * gradPhiZ);
+
+            // 计算 τ = sqrt((∂η/∂x)² + (∂η/∂y)²)
+            // 注意：τ 只包含 x 和 y 方向的梯度，不包含 z 方向
+            R tau = sqrt(gradPhiX * gradPhiX + gradPhiY * gradPhiY);
+
+            // ========== 2. 计算各向异性系数 ε(Ω, Ω_ori) 及其导数 ==========
+            // 物理意义：晶体在不同方向生长速度不同
+            // 计算局部相位前沿方向 Ω 和取向场 Ω_ori 之间的夹角
+            R eps, eps_theta, eps_phi;
+            if (algebraic) {
+                algebraicCubicAnisotropy<R>(gradPhiX, gradPhiY, gradPhiZ,
+                                            omegaX(idx), omegaY(idx), omegaZ(idx), _c1, _c2,
+                                            eps, eps_theta, eps_phi);
+            } else {
+                trigCubicAnisotropy<R>(gradPhiX, gradPhiY, gradPhiZ, gradPhiMag,
+                                       omegaX(idx), omegaY(idx), omegaZ(idx), _c1, _c2,
+                                       eps, eps_theta, eps_phi);
             }
+
+            // ========== 3. 组合成邻居需要的量 ==========
+            int d = blk.derivedIndex(i, j, k);
+            anisotropyFluxes<R>(gradPhiX, gradPhiY, gradPhiZ, gradPhiMag, tau, eps, eps_theta, eps_phi,
+                                blk.epsilon2[d], blk.fluxY[d], blk.fluxZ[d], blk.epsTauTheta[d]);
         }
     }
 }
 
-// 解取向场方程(18)
-// 公式(18)：∂Ω_ori/∂t = -M_ori·H·(1-p(η))·∇·[p(η)·∇Ω_ori/||∇Ω_ori||]
-// 只在非固定方向的位置更新
-void Kobayashi::_solveOrientationField()
+void Kobayashi3D::_anisotropyDeviation(AnisotropyDeviation& dev) const
 {
+    dev = AnisotropyDeviation();
+    if (_precision != Precision::Single || _storage != Storage::Dense) return;
     for (int k = 0; k < _objectCount.z; k++)
-    {
         for (int j = 0; j < _objectCount.y; j++)
-        {
             for (int i = 0; i < _objectCount.x; i++)
             {
                 int idx = _INDEX(i, j, k);
+                float gradPhiX = (_phi[_INDEX(i + 1, j, k)] - _phi[_INDEX(i - 1, j, k)]) / (2.0f * _dx);
+                float gradPhiY = (_phi[_INDEX(i, j + 1, k)] - _phi[_INDEX(i, j - 1, k)]) / (2.0f * _dy);
+                float gradPhiZ = (_phi[_INDEX(i, j, k + 1)] - _phi[_INDEX(i, j, k - 1)]) / (2.0f * _dz);
+                float gradPhiMag = sqrt(gradPhiX * gradPhiX + gradPhiY * gradPhiY + gradPhiZ * gradPhiZ);
+                float tau = sqrt(gradPhiX * gradPhiX + gradPhiY * gradPhiY);
+
+                float e[2], t[2], p[2], e2[2], fy[2], fz[2], ett[2];
+                trigCubicAnisotropy(gradPhiX, gradPhiY, gradPhiZ, gradPhiMag,
+                                    _omega_ori_x[idx], _omega_ori_y[idx], _omega_ori_z[idx], _c1, _c2, e[0], t[0], p[0]);
+                algebraicCubicAnisotropy(gradPhiX, gradPhiY, gradPhiZ,
+                                         _omega_ori_x[idx], _omega_ori_y[idx], _omega_ori_z[idx], _c1, _c2, e[1], t[1], p[1]);
+                for (int m = 0; m < 2; m++)
+                    anisotropyFluxes(gradPhiX, gradPhiY, gradPhiZ, gradPhiMag, tau, e[m], t[m], p[m], e2[m], fy[m], fz[m], ett[m]);
+                dev.eps = fmax(dev.eps, fabs(e[1] - e[0]));
+                dev.epsTheta = fmax(dev.epsTheta, fabs(t[1] - t[0]));
+                dev.epsPhi = fmax(dev.epsPhi, fabs(p[1] - p[0]));
+                dev.fluxY = fmax(dev.fluxY, fabs(fy[1] - fy[0]));
+                dev.fluxZ = fmax(dev.fluxZ, fabs(fz[1] - fz[0]));
+                dev.epsTauTheta = fmax(dev.epsTauTheta, fabs(ett[1] - ett[0]));
+                dev.fluxScale = fmax(dev.fluxScale, fmax(fabs(fy[0]), fabs(fz[0])));
+            }
+}
 
-                // 跳过固定方向的位置
-                if (_isOrientationFixed[idx]) continue;
-
-                // 周期性边界条件
-                int i_plus = (i + 1) % _objectCount.x;
-                int i_minus = ((i - 1) + _objectCount.x) % _objectCount.x;
-                int j_plus = (j + 1) % _objectCount.y;
-                int j_minus = ((j - 1) + _objectCount.y) % _objectCount.y;
-                int k_plus = (k + 1) % _objectCount.z;
-                int k_minus = ((k - 1) + _objectCount.z) % _objectCount.z;
-
-                float oldPhi = _phi[idx];
-                float oldOmegaX = _omega_ori_x[idx];
-                float oldOmegaY = _omega_ori_y[idx];
-                float oldOmegaZ = _omega_ori_z[idx];
+// ==========================================
+// 物理模拟核心：按论文Algorithm 2求解
+// ==========================================
 
-                float p_eta = oldPhi * oldPhi * (3.0f - 2.0f * oldPhi);
-                float gradOmegaOriMag = _gradOmegaOriMag[idx];
+// 在一次扫描中依次完成 Algorithm 2 的各个方程，每个格子只读取上一步的场：
+//   1. 相场方程(17)，得到 ∂η/∂t
+//   2. 取向场方程(18)（只在非固定方向的位置）
+//   3. 温度方程(5)
+//   4. 更新相场
+// 梯度、拉普拉斯算子、||∇Ω_ori|| 和 ∂η/∂t 只在格子自身用到，都在寄存器中计算
+// 模板参数在编译期去掉关闭的项（见 _solveFields() 的分派）：
+//   Orientation : H ≠ 0。为 false 时 f_ori = 0、方程(18)的右端恒为 0，取向场保持不变，
+//                 不计算算法1的 ||∇Ω_ori||，也不写 _omega_next_*
+//   FixedMask   : 存在固定取向的格子，需要逐格检查 _isOrientationFixed（只有 Dense 存储支持）
+//   UnitAlphaT  : a² = 1，温度方程省掉一次乘法
+//   CoarseT     : 双分辨率，温度由粗网格插值，不计算温度方程（只有 Dense 存储）
+template <class S, bool Orientation, bool FixedMask, bool UnitAlphaT, bool CoarseT>
+void Kobayashi3D::_solveFieldsBlock(const BlockOf<S>& blk, int k0, int k1)
+{
+    typedef FieldTraits<S> F;
+    typedef typename F::Real R;
+    auto phi = [&](int n) -> R { return F::load(blk.phi[n]); };
+    auto t = [&](int n) -> R { return F::load(blk.t[n]); };
+    auto omegaX = [&](int n) -> R { return F::load(blk.omegaX[n]); };
+    auto omegaY = [&](int n) -> R { return F::load(blk.omegaY[n]); };
+    auto omegaZ = [&](int n) -> R { return F::load(blk.omegaZ[n]); };
+    std::vector<float> coarseRow, coarseColumn; // CoarseT：当前行插值得到的温度
+    if (CoarseT) coarseRow.resize(blk.nx);
+    const bool vector = !Orientation && !CoarseT && _simd && simdData(blk.phi); // 整行交给 SIMD 内核
+    const int sy = blk.sx, sz = blk.sx * blk.sy; // 状态场 ±y、±z 邻居的下标步长
+    const int points = _stencilPoints();
+    const R h2 = _dx * _dx;
+    // 生长诊断：限制到 [0, 1] 之前的新相场的最小值、最大值和 x − x 之和，发散看门狗据此检查相场
+    const bool track = diagnostics();
+    float excursion[3] = { FLT_MAX, -FLT_MAX, 0.0f };
+    for (RowWalk w(blk.ny, k0, k1); w.next(); )
+    {
+        const int j = w.j, k = w.k;
+        if (vector) {
+            int o = blk.index(0, j, k), d = blk.derivedIndex(0, j, k);
+            SimdSolveRow3D row = { simdData(blk.phi) + o, simdData(blk.t) + o, simdData(blk.epsilon2) + d, simdData(blk.fluxY) + d,
+                                   simdData(blk.fluxZ) + d, simdData(blk.epsTauTheta) + d, simdData(blk.phiNext) + o, simdData(blk.tNext) + o,
+                                   blk.nx, sy, sz, blk.dsy, blk.dsz, points, _dx, _dy, _dz, _dt, _alpha, _gamma, _tEq, _K, _alpha_T, M_eta,
+                                   track ? excursion : nullptr };
+            _simd->solveRow3D(row);
+            continue;
+        }
+        if (CoarseT) _coarseTemperatureRow(j, k, coarseColumn, coarseRow.data());
+        for (int i = 0; i < blk.nx; i++)
+        {
+            // 邻居下标：状态场的幽灵格由 _fillHalo() 填好，通量项的幽灵格由 _computeAnisotropy() 填好
+            int i_plus = i + 1;
+            int i_minus = i - 1;
+            int j_plus = j + 1;
+            int j_minus = j - 1;
+            int k_plus = k + 1;
+            int k_minus = k - 1;
+
+            int idx = blk.index(i, j, k);
+            int idx_xp = blk.index(i_plus, j, k), idx_xm = blk.index(i_minus, j, k);
+            int idx_yp = blk.index(i, j_plus, k), idx_ym = blk.index(i, j_minus, k);
+            int idx_zp = blk.index(i, j, k_plus), idx_zm = blk.index(i, j, k_minus);
+            // 各向异性量的下标（见 DerivedLayout）
+            int d = blk.derivedIndex(i, j, k);
+            int d_xp = d + 1, d_xm = d - 1, d_yp = d + blk.dsy, d_ym = d - blk.dsy, d_zp = d + blk.dsz, d_zm = d - blk.dsz;
+
+            // 保存旧值
+            R oldPhi = phi(idx);
+            R oldT = CoarseT ? coarseRow[i] : t(idx);
+
+            // 相场梯度（中心差分）
+            R gradPhiX = (phi(idx_xp) - phi(idx_xm)) / (2.0f * _dx);
+            R gradPhiY = (phi(idx_yp) - phi(idx_ym)) / (2.0f * _dy);
+            R gradPhiZ = (phi(idx_zp) - phi(idx_zm)) / (2.0f * _dz);
+
+            // 拉普拉斯算子 - 3D 7/19/27 点模板（见 stencilLaplacian()）
+            // 7 点：∇²η ≈ (η_E + η_W + η_N + η_S + η_U + η_D - 6η_C) / Δx²
+            R lapPhi = stencilLaplacian<R>(phi, idx, sy, sz, points, h2);
+            R lapT = CoarseT ? 0.0f : stencilLaplacian<R>(t, idx, sy, sz, points, h2);
+
+            R gradOmegaOriMag = Orientation ? _orientationGradientMag(blk, idx, idx_xp, idx_xm, idx_yp, idx_ym, idx_zp, idx_zm) : 0.0f;
+
+            // ========== 计算驱动力 (Driving Force) ==========
+            // 驱动力由过冷度（T_eq - T）决定
+            // 公式：m = (α/π)·arctan(γ·(T_eq - T))
+            R m = _alpha / PI_F * atan(_gamma * (_tEq - oldT));
+
+            // ========== 公式(17)：相场演化方程 ==========
+            // ∂η/∂t = M_η[∇·(ε²∇η) + ∂/∂z(...) + ∂/∂y(...) - ∂/∂z(ε·∂ε/∂θ·τ) - g'(η) - p'(η)(f_s - f_t + f_ori)]
+
+            // 第一项：∇·(ε²∇η) = ε²∇²η + ∇(ε²)·∇η
+            R term_diffusion = blk.epsilon2[d] * lapPhi;
+
+            // ∇(ε²)·∇η
+            R gradEps2_x = (blk.epsilon2[d_xp] - blk.epsilon2[d_xm]) / (2.0f * _dx);
+            R gradEps2_y = (blk.epsilon2[d_yp] - blk.epsilon2[d_ym]) / (2.0f * _dy);
+            R gradEps2_z = (blk.epsilon2[d_zp] - blk.epsilon2[d_zm]) / (2.0f * _dz);
+
+            R term_grad_eps2 = gradEps2_x * gradPhiX
+                             + gradEps2_y * gradPhiY
+                             + gradEps2_z * gradPhiZ;
+
+            // 第二项：∂/∂z[ε/τ·∂ε/∂θ·∂η/∂x - ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂y]
+            R term_z = (blk.fluxZ[d_zp] - blk.fluxZ[d_zm]) / (2.0f * _dz);
+
+            // 第三项：∂/∂y[ε/τ·∂ε/∂θ·∂η/∂z + ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂x]
+            R term_y = (blk.fluxY[d_yp] - blk.fluxY[d_ym]) / (2.0f * _dy);
+
+            // 第四项：-∂/∂z(ε·∂ε/∂θ·τ)
+            R term_eps_tau = -(blk.epsTauTheta[d_zp] - blk.epsTauTheta[d_zm]) / (2.0f * _dz);
+
+            // 第五项：-g'(η)，其中 g(η) = η²(η-1)²/4
+            // g'(η) = η(η-1)(η-0.5)
+            R g_prime = oldPhi * (oldPhi - 1.0f) * (oldPhi - 0.5f);
+
+            // 第六项：-p'(η)(f_s - f_t + f_ori)
+            // p(η) = η²(3-2η), p'(η) = 6η(1-η)
+            R p_prime = 6.0f * oldPhi * (1.0f - oldPhi);
+
+            // f_s - f_t + f_ori
+            // f_t = 0 (液相自由能), f_s = -m/6 (固相自由能), f_ori = H·||∇Ω_ori||
+            R f_diff = Orientation ? -m / 6.0f + _H * gradOmegaOriMag : -m / 6.0f;
+
+            R dPhiDt = M_eta * (term_diffusion + term_grad_eps2 + term_z + term_y + term_eps_tau
+                              - g_prime - p_prime * f_diff);
+
+            // ========== 公式(18)：取向场方程 ==========
+            // ∂Ω_ori/∂t = -M_ori·H·(1-p(η))·∇·[p(η)·∇Ω_ori/||∇Ω_ori||]
+            if (!Orientation) {
+                // H = 0：取向场不演化
+            } else if (FixedMask && _isOrientationFixed[idx]) {
+                R oldOmegaX = omegaX(idx);
+                R oldOmegaY = omegaY(idx);
+                R oldOmegaZ = omegaZ(idx);
+
+                // 固定方向的位置保持原值
+                blk.omegaNextX[idx] = F::store(oldOmegaX);
+                blk.omegaNextY[idx] = F::store(oldOmegaY);
+                blk.omegaNextZ[idx] = F::store(oldOmegaZ);
+            } else {
+                R oldOmegaX = omegaX(idx);
+                R oldOmegaY = omegaY(idx);
+                R oldOmegaZ = omegaZ(idx);
+                R p_eta = oldPhi * oldPhi * (3.0f - 2.0f * oldPhi);
 
                 // 计算取向场的拉普拉斯算子（对每个分量）
-                float lapOmegaX = (_omega_ori_x[_INDEX(i_plus, j, k)] + _omega_ori_x[_INDEX(i_minus, j, k)]
-                                 + _omega_ori_x[_INDEX(i, j_plus, k)] + _omega_ori_x[_INDEX(i, j_minus, k)]
-                                 + _omega_ori_x[_INDEX(i, j, k_plus)] + _omega_ori_x[_INDEX(i, j, k_minus)]
-                                 - 6.0f * oldOmegaX) / (_dx * _dx);
-
-                float lapOmegaY = (_omega_ori_y[_INDEX(i_plus, j, k)] + _omega_ori_y[_INDEX(i_minus, j, k)]
-                                 + _omega_ori_y[_INDEX(i, j_plus, k)] + _omega_ori_y[_INDEX(i, j_minus, k)]
-                                 + _omega_ori_y[_INDEX(i, j, k_plus)] + _omega_ori_y[_INDEX(i, j, k_minus)]
-                                 - 6.0f * oldOmegaY) / (_dx * _dx);
-
-                float lapOmegaZ = (_omega_ori_z[_INDEX(i_plus, j, k)] + _omega_ori_z[_INDEX(i_minus, j, k)]
-                                 + _omega_ori_z[_INDEX(i, j_plus, k)] + _omega_ori_z[_INDEX(i, j_minus, k)]
-                                 + _omega_ori_z[_INDEX(i, j, k_plus)] + _omega_ori_z[_INDEX(i, j, k_minus)]
-                                 - 6.0f * oldOmegaZ) / (_dx * _dx);
+                R lapOmegaX = stencilLaplacian<R>(omegaX, idx, sy, sz, points, h2);
+                R lapOmegaY = stencilLaplacian<R>(omegaY, idx, sy, sz, points, h2);
+                R lapOmegaZ = stencilLaplacian<R>(omegaZ, idx, sy, sz, points, h2);
 
                 // 投影到切空间：去除法向分量
-                float lap_dot_omega = lapOmegaX * oldOmegaX + lapOmegaY * oldOmegaY + lapOmegaZ * oldOmegaZ;
-                float lapOmegaX_tangent = lapOmegaX - lap_dot_omega * oldOmegaX;
-                float lapOmegaY_tangent = lapOmegaY - lap_dot_omega * oldOmegaY;
-                float lapOmegaZ_tangent = lapOmegaZ - lap_dot_omega * oldOmegaZ;
+                R lap_dot_omega = lapOmegaX * oldOmegaX + lapOmegaY * oldOmegaY + lapOmegaZ * oldOmegaZ;
+                R lapOmegaX_tangent = lapOmegaX - lap_dot_omega * oldOmegaX;
+                R lapOmegaY_tangent = lapOmegaY - lap_dot_omega * oldOmegaY;
+                R lapOmegaZ_tangent = lapOmegaZ - lap_dot_omega * oldOmegaZ;
 
                 // 计算演化速率
-                float coeff = -M_ori * _H * (1.0f - p_eta) * p_eta;
+                R coeff = -M_ori * _H * (1.0f - p_eta) * p_eta;
                 if (gradOmegaOriMag > FLT_EPSILON) {
                     coeff /= gradOmegaOriMag;
                 } else {
                     coeff = 0.0f;
                 }
 
-                float dOmegaXDt = coeff * lapOmegaX_tangent;
-                float dOmegaYDt = coeff * lapOmegaY_tangent;
-                float dOmegaZDt = coeff * lapOmegaZ_tangent;
-
                 // 更新取向场
-                float newOmegaX = oldOmegaX + dOmegaXDt * _dt;
-                float newOmegaY = oldOmegaY + dOmegaYDt * _dt;
-                float newOmegaZ = oldOmegaZ + dOmegaZDt * _dt;
+                R newOmegaX = oldOmegaX + coeff * lapOmegaX_tangent * _dt;
+                R newOmegaY = oldOmegaY + coeff * lapOmegaY_tangent * _dt;
+                R newOmegaZ = oldOmegaZ + coeff * lapOmegaZ_tangent * _dt;
 
                 // 重新归一化到单位球面
-                float omegaNorm = sqrt(newOmegaX * newOmegaX + newOmegaY * newOmegaY + newOmegaZ * newOmegaZ);
+                R omegaNorm = sqrt(newOmegaX * newOmegaX + newOmegaY * newOmegaY + newOmegaZ * newOmegaZ);
                 if (omegaNorm > FLT_EPSILON) {
-                    _omega_ori_x[idx] = newOmegaX / omegaNorm;
-                    _omega_ori_y[idx] = newOmegaY / omegaNorm;
-                    _omega_ori_z[idx] = newOmegaZ / omegaNorm;
+                    blk.omegaNextX[idx] = F::store(newOmegaX / omegaNorm);
+                    blk.omegaNextY[idx] = F::store(newOmegaY / omegaNorm);
+                    blk.omegaNextZ[idx] = F::store(newOmegaZ / omegaNorm);
                 } else {
                     // 如果归一化失败，保持原值
-                    _omega_ori_x[idx] = oldOmegaX;
-                    _omega_ori_y[idx] = oldOmegaY;
-                    _omega_ori_z[idx] = oldOmegaZ;
+                    blk.omegaNextX[idx] = F::store(oldOmegaX);
+                    blk.omegaNextY[idx] = F::store(oldOmegaY);
+                    blk.omegaNextZ[idx] = F::store(oldOmegaZ);
                 }
             }
+
+            // ========== 公式(5)：温度方程 ==========
+            // ∂T/∂t = a²·∇²T + K·∂η/∂t（CoarseT 时由 _thermalStep() 在粗网格上计算）
+            R diffusionT = UnitAlphaT ? lapT : _alpha_T * lapT;
+            if (!CoarseT) blk.tNext[idx] = F::store(oldT + (diffusionT + _K * dPhiDt) * _dt);
+
+            // ========== 更新相场，并限制在 [0, 1] 范围内 ==========
+            R newPhi = oldPhi + dPhiDt * _dt;
+            if (track) {
+                excursion[0] = std::min(excursion[0], (float)newPhi);
+                excursion[1] = std::max(excursion[1], (float)newPhi);
+                excursion[2] += (float)(newPhi - newPhi);
+            }
+            blk.phiNext[idx] = F::store(fmax(0.0f, fmin(1.0f, newPhi)));
         }
     }
+    if (track) {
+        std::lock_guard<std::mutex> lock(_statsLock);
+        _stepStats.addPhiRange(excursion[0], excursion[1], excursion[2]);
+    }
 }
 
-// 解温度方程(5)
-// 公式(5)：∂T/∂t = a²·∇²T + K·∂η/∂t
-// 使用存储的 ∂η/∂t
-void Kobayashi::_solveTemperatureField()
-{
-    for (int k = 0; k < _objectCount.z; k++)
-    {
-        for (int j = 0; j < _objectCount.y; j++)
-        {
-            for (int i = 0; i < _objectCount.x; i++)
-            {
-                int idx = _INDEX(i, j, k);
-                float oldT = _t[idx];
+// ==========================================
+// 时间分块
+// ==========================================
 
-                // ∂T/∂t = a²·∇²T + K·∂η/∂t
-                _t[idx] = oldT + (_alpha_T * _lapT[idx] + _K * _dPhiDt[idx]) * _dt;
-            }
-        }
+// 连续 depth 步的 2·depth 个阶段按 z 层块的波前推进（见 wavefront()）：第 2m 个阶段是第 m 步的各向异性，
+// 第 2m+1 个阶段是第 m 步的求解。求解读第 m 层、写第 m+1 层，两层交替放在状态场和 Next 缓冲中；
+// 各向异性量只有一份，下一步的各向异性阶段覆盖它之前，这一步的求解已经读完相邻的块。
+// 每块 z 层数等于线程数，每层一个任务；每块写完后填充所含 z 层的幽灵格，与逐步推进时填的相同
+bool Kobayashi3D::_temporalBlock(int depth)
+{
+    if (_storage != Storage::Dense || _timeStepping != TimeStepping::Fixed || _thermalRatio > 1) return false;
+    switch (_precision) {
+    case Precision::Half: return _blockedSteps(depth, _packedBlock<Half>());
+    case Precision::BFloat16: return _blockedSteps(depth, _packedBlock<BFloat16>());
+    case Precision::Double: return _blockedSteps(depth, _packedBlock<double>());
+    default: return _blockedSteps(depth, _denseBlock());
     }
 }
 
-// 更新相场（使用存储的 ∂η/∂t）
-void Kobayashi::_updatePhaseField()
+template <class S>
+bool Kobayashi3D::_blockedSteps(int depth, const BlockOf<S>& blk)
 {
-    for (int k = 0; k < _objectCount.z; k++)
-    {
-        for (int j = 0; j < _objectCount.y; j++)
-        {
-            for (int i = 0; i < _objectCount.x; i++)
-            {
-                int idx = _INDEX(i, j, k);
-                float oldPhi = _phi[idx];
-
-                // 更新相场，并限制在 [0, 1] 范围内
-                _phi[idx] = fmax(0.0f, fmin(1.0f, oldPhi + _dPhiDt[idx] * _dt));
-            }
-        }
+    int nx = _objectCount.x, ny = _objectCount.y, nz = _objectCount.z;
+    int stages = 2 * depth;
+    int h = std::max(1, std::min(_pool->size(), nz / (2 * stages)));
+    int chunks = nz / h;
+    if (chunks < 2 * stages) return false;
+
+    _dt = _fixedDt;
+    _fillHalo();
+    _stepStats = GrowthStats();
+    const bool measure = diagnostics();
+
+    BlockOf<S> odd = blk;
+    std::swap(odd.phi, odd.phiNext);
+    std::swap(odd.t, odd.tNext);
+    const bool orientation = _orientationEnabled();
+    if (orientation) {
+        std::swap(odd.omegaX, odd.omegaNextX);
+        std::swap(odd.omegaY, odd.omegaNextY);
+        std::swap(odd.omegaZ, odd.omegaNextZ);
     }
+    BlockFnOf<S> kernel = _solveKernel<S>();
+    HaloSides sides = _haloSides(_boundary);
+    HaloSides omegaSides = _haloSides((_boundary == Boundary::Periodic) ? Boundary::Periodic : Boundary::Neumann);
+    auto plane = [nz, chunks](int c) { return (int)((long long)nz * c / chunks); };
+
+    wavefront(*_pool, stages, chunks, h,
+        [&](int s, int c, int p) {
+            const BlockOf<S>& b = (s / 2) % 2 ? odd : blk;
+            int k0 = plane(c), k1 = plane(c + 1);
+            int p0 = k0 + (k1 - k0) * p / h, p1 = k0 + (k1 - k0) * (p + 1) / h;
+            if (s % 2 == 0) _computeAnisotropyBlock(b, p0, p1);
+            else (this->*kernel)(b, p0, p1);
+            if (measure && s == stages - 1) _measureBlock(b, b.phiNext, b.tNext, p0, p1); // 只统计最后一步
+        },
+        [&](int s, int c) {
+            const BlockOf<S>& b = (s / 2) % 2 ? odd : blk;
+            int k0 = plane(c), k1 = plane(c + 1);
+            if (s % 2 == 0) {
+                // 通量项没有"固定值"的含义，非周期边界时一律复制相邻的内部格
+                for (auto* f : { b.epsilon2, b.fluxY, b.fluxZ, b.epsTauTheta })
+                    fillHaloStrided3D(f, nx, ny, nz, b.dsy, b.dsz, k0, k1, omegaSides);
+                return;
+            }
+            fillHaloPlanes3D(b.phiNext, nx, ny, nz, k0, k1, sides, 0.0f);
+            fillHaloPlanes3D(b.tNext, nx, ny, nz, k0, k1, sides, _tBoundary);
+            if (orientation) {
+                for (S* f : { b.omegaNextX, b.omegaNextY, b.omegaNextZ })
+                    fillHaloPlanes3D(f, nx, ny, nz, k0, k1, omegaSides);
+            }
+        });
+    if (depth % 2) _swapNext<S>();
+
+    _stepDt = _dt;
+    for (int s = 0; s < depth; s++) _time += _stepDt;
+    _stepCount += depth;
+    _finishStats();
+    return true;
 }
 
-// 主更新循环 - 按Algorithm 2实现
-void Kobayashi::update() {
-    if (!_updateFlag) return; // 如果暂停则不计算
-
-    // 为了加快视觉效果，每一帧渲染前，我们计算 10 次物理步骤
-    for (int i = 0; i < 10; i++) {
-        // Step 1: 计算梯度和拉普拉斯算子
-        _computeGradientLaplacian();
+// 推进 steps 个物理步骤 - 按Algorithm 2实现，不涉及任何渲染
+int Kobayashi3D::step(int steps) {
+    _stopReason = StopReason::None;
+    const long long start = _stepCount, end = _stepCount + steps;
+    while (_stepCount < end && _stopReason == StopReason::None) {
+        _saveSnapshot();
+        int depth = (int)std::min<long long>(end - _stepCount, _blockDepth);
+        if (depth <= 1 || !_temporalBlock(depth)) _advanceStep(FLT_MAX);
+        if (_divergence) _rollback();
+    }
+    return (int)(_stepCount - start);
+}
 
-        // Step 2: 解相场方程(17)，存储 ∂η/∂t
-        _solvePhaseField();
+int Kobayashi3D::advance(double duration, int maxSteps) {
+    double end = _time + duration;
+    int steps = 0;
+    _stopReason = StopReason::None;
+    // 剩余时间小于一步的万分之一时视为已经到达，避免为舍入误差多走一小步
+    while (steps < maxSteps && end - _time > 1e-4 * _stepDt && _stopReason == StopReason::None) {
+        _saveSnapshot();
+        _advanceStep((float)(end - _time));
+        steps++;
+        if (_divergence) _rollback();
+    }
+    return steps;
+}
 
-        // Step 3: 解取向场方程(18)（只在非固定方向的位置）
-        _solveOrientationField();
+// ==========================================
+// 生长诊断
+// ==========================================
 
-        // Step 4: 解温度方程(5)
-        _solveTemperatureField();
+// 各任务先在局部累加，最后加锁合并一次；计数和最值与合并顺序无关，结果不随线程数变化
+template <class S>
+void Kobayashi3D::_measureBlock(const BlockOf<S>& blk, const S* phi, const S* t, int k0, int k1, int oi, int oj, int ok)
+{
+    GrowthStats s;
+    const int* wx = _mirror[0] ? _foldWeight[0].data() : nullptr;
+    for (int k = k0; k < k1; k++)
+        for (int j = 0; j < blk.ny; j++) {
+            long long w = (long long)(_mirror[1] ? _foldWeight[1][j] : 1) * (_mirror[2] ? _foldWeight[2][k] : 1);
+            int n = blk.index(0, j, k);
+            s.addRow(phi + n, t ? t + n : nullptr, blk.nx, oi, oj + j, ok + k, w, wx, _simd ? _simd->growthRow : nullptr);
+        }
+    std::lock_guard<std::mutex> lock(_statsLock);
+    _stepStats.merge(s);
+}
 
-        // Step 5: 更新相场
-        _updatePhaseField();
+// 对称的方向上，存储坐标范围 [lo, hi] 展开为折叠到其中的所有完整网格坐标的范围
+void Kobayashi3D::_finishStats()
+{
+    if (!diagnostics()) return;
+    GrowthStats s = _stepStats;
+    _stepStats = GrowthStats();
+    if (_storage == Storage::Adaptive && s.hasSolid()) {
+        const long long cells = (long long)_amrRatio * _amrRatio * _amrRatio;
+        s.solidCells *= cells;
+        s.interfaceCells *= cells;
+        for (int a = 0; a < 3; a++) {
+            s.lo[a] *= _amrRatio;
+            s.hi[a] = s.hi[a] * _amrRatio + _amrRatio - 1;
+        }
     }
-}
+    if (_storage == Storage::Sparse && _brickList.size() < _bricks.size()) {
+        s.tMin = std::min(s.tMin, 0.0f);
+        s.tMax = std::max(s.tMax, 0.0f);
+    }
+    const int full[3] = { width(), height(), depth() };
+    for (int a = 0; a < 3 && s.hasSolid(); a++) {
+        if (!_mirror[a]) continue;
+        int lo = INT_MAX, hi = INT_MIN;
+        for (int i = 0; i < full[a]; i++) {
+            int f = _fold(a, i);
+            if (f < s.lo[a] || f > s.hi[a]) continue;
+            lo = std::min(lo, i);
+            hi = std::max(hi, i);
+        }
+        s.lo[a] = lo;
+        s.hi[a] = hi;
+    }
+    _stats = s;
 
-void Kobayashi::reset() {
-    _vectorInit();
+    // 发散的一步不检查停止条件，由 step()/advance() 回退
+    if (_watchdog.interval > 0 && (_divergence = divergence(_stats, _watchdog))) return;
+    StopReason reason = _monitor.check(_stats, _time, full, 3, _dx);
+    if (reason != StopReason::None) _stopReason = reason;
 }
 
 // ==========================================
-// 图形渲染部分 (OpenGL)
+// 发散看门狗
 // ==========================================
 
-// 初始化 OpenGL 设置
-void Kobayashi::glInit() {
-    // 启用深度测试（3D渲染必需）
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-
-    // 启用混合（用于半透明效果）
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+const int Kobayashi3D::_stateFields[5] = { FieldPhi, FieldT, FieldOmegaX, FieldOmegaY, FieldOmegaZ };
 
-    // 设置点的大小
-    glPointSize(2.0f);
+// 上一步已通过检查，当前状态可以作为回退点；回退之后 _stepCount 回到快照处，不会立即重存
+void Kobayashi3D::_saveSnapshot()
+{
+    if (_watchdog.interval <= 0) return;
+    if (_snapshot.stepCount >= 0 && _stepCount - _snapshot.stepCount < _watchdog.interval) return;
+    Snapshot& s = _snapshot;
+    s.phi = _phi;
+    s.t = _t;
+    s.omegaX = _omega_ori_x;
+    s.omegaY = _omega_ori_y;
+    s.omegaZ = _omega_ori_z;
+    s.tCoarse = _tCoarse;
+    _copyState(s.half, _halfFields);
+    _copyState(s.bfloat16, _bfloat16Fields);
+    _copyState(s.dbl, _doubleFields);
+    s.bricks.resize(_brickList.size());
+    for (size_t b = 0; b < _brickList.size(); b++) {
+        const Brick& from = *_brickList[b];
+        Brick& to = s.bricks[b];
+        for (int a = 0; a < 3; a++) {
+            to.coord[a] = from.coord[a];
+            to.n[a] = from.n[a];
+        }
+        for (int f : _stateFields) to.data[f] = from.data[f];
+    }
+    s.stepCount = _stepCount;
+    s.time = _time;
+    s.stepDt = _stepDt;
+    s.stats = _stats;
+    s.monitor = _monitor;
+    _retries = 0;
+}
 
-    // 设置背景颜色为深灰色
-    glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+// 双缓冲的另一半和各向异性量都在下一步重新计算；砖块表按快照重建，新砖块的其余场由 _allocateBrick() 分配
+void Kobayashi3D::_rollback()
+{
+    const Snapshot& s = _snapshot;
+    RollbackEvent e = { _stepCount, _time, s.stepCount, s.time, _stepDt, _divergence, false };
+    _divergence = nullptr;
+    e.gaveUp = s.stepCount < 0 || ++_retries > _watchdog.maxRetries;
+    if (s.stepCount >= 0) {
+        _phi = s.phi;
+        _t = s.t;
+        _omega_ori_x = s.omegaX;
+        _omega_ori_y = s.omegaY;
+        _omega_ori_z = s.omegaZ;
+        _tCoarse = s.tCoarse;
+        _copyState(_halfFields, s.half);
+        _copyState(_bfloat16Fields, s.bfloat16);
+        _copyState(_doubleFields, s.dbl);
+        if (_storage != Storage::Dense) {
+            for (std::unique_ptr<Brick>& slot : _bricks) slot.reset();
+            _brickList.clear();
+            for (const Brick& from : s.bricks) {
+                Brick* brick = _allocateBrick(from.coord[0], from.coord[1], from.coord[2]);
+                for (int f : _stateFields) brick->data[f] = from.data[f];
+            }
+        }
+        _stepCount = s.stepCount;
+        _time = s.time;
+        _stepDt = s.stepDt;
+        _stats = s.stats;
+        StopConditions conditions = _monitor.conditions();
+        _monitor = s.monitor;
+        _monitor.setConditions(conditions);
+    }
+    if (e.gaveUp) {
+        _stopReason = StopReason::Diverged;
+    } else {
+        _fixedDt *= 0.5f;
+        _cfl *= 0.5f;
+    }
+    _rollbacks.push_back(e);
 }
 
-// 3D渲染函数 - 使用点云渲染晶体
-void Kobayashi::glRender() {
-    // 清除颜色和深度缓冲区
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// 显式格式的稳定上限（见 explicitStableStep），拉普拉斯算子的谱半径 7 点是 12/dx²，19 点是 16/(3·dx²)，27 点是 92/(15·dx²)：
+// 相场：ε ≤ c1 + c2，扩散系数 M_η·ε²；反应项 M_η·(g'(η) + p'(η)·m/6) 在 η = 0、1 处的斜率不超过 M_η·(0.5 + α/2)（|m| < α/2）
+// 温度场：扩散系数 a²，潜热项只依赖相场；双分辨率时在间距为 ratio·dx 的粗网格上。
+// H ≠ 0 时取向场方程(18)的系数含 1/||∇Ω_ori||，没有与参数相关的上限，不在这里考虑
+void Kobayashi3D::stableTimeSteps(float& dtPhi, float& dtT) const {
+    float radius = (_stencilPoints() == 7) ? 12.0f : (_stencilPoints() == 19) ? 16.0f / 3.0f : 92.0f / 15.0f;
+    float lap = radius / (_dx * _dx);
+    float eps = std::fabs(_c1) + std::fabs(_c2);
+    dtPhi = explicitStableStep(std::fabs(M_eta) * eps * eps, lap, std::fabs(M_eta) * (0.5f + 0.5f * std::fabs(_alpha)));
+    dtT = explicitStableStep(std::fabs(_alpha_T), lap / (float)(_thermalRatio * _thermalRatio), 0.0f);
+}
 
-    // 设置投影矩阵
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    float aspect = 1.0f; // 假设窗口是正方形
-    gluPerspective(45.0, aspect, 0.1, 100.0);
+// 推进一步：Fixed 用构造时的 dt，Adaptive 每步重新取两个稳定上限中较小的乘以 cfl，都不超过 maxDt。
+// Adaptive 存储时 dt 是细层的步长，一步推进 _amrRatio·dt，基础网格的一步也要满足它自己的稳定上限
+void Kobayashi3D::_advanceStep(float maxDt) {
+    const int ratio = _levelRatio();
+    _dt = std::min(_fixedDt, maxDt / ratio);
+    if (_timeStepping != TimeStepping::Fixed) {
+        float dtPhi, dtT;
+        stableTimeSteps(dtPhi, dtT);
+        if (_storage == Storage::Adaptive) {
+            float coarsePhi, coarseT;
+            _scaleLevel((float)ratio);
+            stableTimeSteps(coarsePhi, coarseT);
+            _scaleLevel(1.0f / ratio);
+            dtPhi = std::min(dtPhi, coarsePhi / ratio);
+            dtT = std::min(dtT, coarseT / ratio);
+        }
+        _dt = std::min(_cfl * std::min(dtPhi, dtT), maxDt / ratio);
+    }
 
-    // 设置模型视图矩阵
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    _stepStats = GrowthStats();
+    if (_storage == Storage::Adaptive) {
+        _adaptiveStep();
+    } else {
+        // Step 0: Sparse 存储先更新砖块，再按边界条件填充幽灵格
+        if (_storage == Storage::Sparse) _updateBricks();
+        _fillHalo();
 
-    // 相机位置：从远处观察晶体
-    static float angle = 0.0f;
-    angle += 0.5f; // 自动旋转
-    float camDist = 3.0f;
-    gluLookAt(camDist * cos(angle * PI_F / 180.0f), camDist * 0.5f, camDist * sin(angle * PI_F / 180.0f),  // 相机位置
-              0.0f, 0.0f, 0.0f,   // 看向原点
-              0.0f, 1.0f, 0.0f);  // 上方向
+        // Step 1: 计算各向异性系数和相场方程中的通量项
+        _computeAnisotropy();
 
-    // 将晶体居中并缩放到合适大小
-    glTranslatef(-0.5f, -0.5f, -0.5f); // 移动到原点
-    float scale = 1.0f / (float)_objectCount.x;
-    glScalef(scale, scale, scale);
+        // Step 2: 解相场方程(17)、取向场方程(18)、温度方程(5)，更新相场
+        _solveFields();
 
-    // 绘制晶体体素
-    glBegin(GL_POINTS);
+        // Step 3: 双分辨率时温度方程(5)在粗网格上求解
+        if (_thermalRatio > 1) _thermalStep();
+    }
 
-    // 定义颜色映射
-    auto getColor = [](float phi) -> void {
-        if (phi < 0.1f) {
-            // 液相：不绘制或半透明蓝色
-            return;
-        } else if (phi < 0.5f) {
-            // 界面区域：蓝色到青色渐变
-            float t = (phi - 0.1f) / 0.4f;
-            glColor4f(0.2f, 0.5f + 0.5f * t, 1.0f, 0.3f + 0.4f * t);
-        } else if (phi < 0.9f) {
-            // 过渡区域：青色到白色
-            float t = (phi - 0.5f) / 0.4f;
-            glColor4f(0.5f + 0.5f * t, 0.8f + 0.2f * t, 1.0f, 0.7f + 0.3f * t);
-        } else {
-            // 固相中心：白色
-            glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-        }
-    };
+    _stepDt = _dt * ratio;
+    _time += _stepDt;
+    _stepCount++;
+    _finishStats();
+}
 
-    // 遍历所有体素，只绘制相场值大于阈值的点
-    int skip = 1; // 采样间隔，可以调整以提高性能
-    for (int k = 0; k < _objectCount.z; k += skip) {
-        for (int j = 0; j < _objectCount.y; j += skip) {
-            for (int i = 0; i < _objectCount.x; i += skip) {
-                int idx = _INDEX(i, j, k);
-                float phi = _phi[idx];
+// 主更新循环
+void Kobayashi3D::update() {
+    if (!_updateFlag) return; // 如果暂停则不计算
 
-                if (phi > 0.1f) { // 只绘制相场值大于0.1的点
-                    getColor(phi);
-                    glVertex3f((float)i, (float)j, (float)k);
-                }
-            }
-        }
-    }
+    // 为了加快视觉效果，每一帧渲染前，我们计算 10 次物理步骤；满足停止条件时暂停
+    step(10);
+    if (_stopReason != StopReason::None) _updateFlag = false;
+}
 
-    glEnd();
+void Kobayashi3D::reset() {
+    _vectorInit();
+}
 
-    // 交换缓冲区
-    glutSwapBuffers();
+// 按名字修改物理常数，供批处理程序从命令行或配置文件传入
+bool Kobayashi3D::setParam(const std::string& name, float value) {
+    if (name == "tau") { _tau = value; M_eta = 1 / _tau; } // M_η = 1/τ 随 τ 一起更新
+    else if (name == "M_eta") M_eta = value;
+    else if (name == "K") _K = value;
+    else if (name == "alpha") _alpha = value;
+    else if (name == "gamma") _gamma = value;
+    else if (name == "tEq") _tEq = value;
+    else if (name == "alpha_T") _alpha_T = value;
+    else if (name == "H") { _H = value; _allocateOrientationNext(); }
+    else if (name == "M_ori") M_ori = value;
+    else if (name == "c1") _c1 = value;
+    else if (name == "c2") _c2 = value;
+    else if (name == "tBoundary") _tBoundary = value;
+    else if (name == "sparseTol") _sparseTol = value;
+    else if (name == "regrid") _regridInterval = std::max(1, (int)value);
+    else if (name == "amrTol") _amrTol = value;
+    else if (name == "cfl") _cfl = value;
+    else if (name == "dx") _dx = value;
+    else if (name == "dy") _dy = value;
+    else if (name == "dz") _dz = value;
+    else return false;
+    return true;
 }
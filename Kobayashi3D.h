@@ -1,23 +1,165 @@
 #pragma once
 #include <vector>
+#include <string>
 #include <cmath>
 #include <ctime>
 #include <iostream>
-#include <GL/freeglut.h>
+#include <memory>
+#include <climits>
+#include <mutex>
+#include "KobayashiCommon.h"
+#include "ThreadPool.h"
 
-const float PI_F = 3.14159265358979f;
+struct SimdKernels;
 
-class Kobayashi
+// 内核按 y 方向的条带遍历 z 层时每个条带的行数（见 Kobayashi3D::RowWalk），0（默认）表示逐层遍历整层。
+// 只改变遍历顺序，场的存储仍是按行连续的。编译时用 -DKOBAYASHI3D_TILE_ROWS=8 等打开：
+// 一层场放不进 L3 的宽网格（如 1536² × 12）快 15–22%，立方体网格在大 L3 的机器上没有差别（见 README）
+#ifndef KOBAYASHI3D_TILE_ROWS
+#define KOBAYASHI3D_TILE_ROWS 0
+#endif
+
+class Kobayashi3D
 {
 public:
-    Kobayashi(int x, int y, int z, float timeStep);
-    ~Kobayashi();
+    // 场的存储方式，只能在构造时选择：
+    //   Dense  : 每个场是一个 (x+2)(y+2)(z+2) 的数组
+    //   Sparse : 网格按 _brickSize³ 分成砖块，只为晶体、温度前沿及其相邻的砖块分配内存，
+    //            其余区域是隐式的背景液体（phi = 0、t = 0、Ω_ori = (0, 0, 1)），各阶段只遍历已分配的砖块
+    //   Adaptive : 两层块结构自适应网格。Dense 的数组存放间距为 _amrRatio·dx 的基础网格，
+    //            相场界面附近覆盖间距为 dx 的加密砖块（与 Sparse 相同的砖块结构），每隔 regrid 步按界面位置重新划分；
+    //            构造时的 x、y、z 是细层的格子数（向上取整为 _amrRatio 的倍数），一步推进 _amrRatio·dt
+    enum class Storage { Dense, Sparse, Adaptive };
+
+    Kobayashi3D(int x, int y, int z, float timeStep, Storage storage = Storage::Dense);
+    ~Kobayashi3D();
 
     // 核心模拟逻辑
     void update();
     void reset();
 
-    // 渲染逻辑
+    // 无窗口批处理接口：推进 steps 个物理步，不做任何渲染相关工作；满足停止条件时提前返回，返回 stepCount() 的增量。
+    // 看门狗回退时重新走回退掉的步
+    int step(int steps);
+    // 推进 duration 的物理时间，最后一步缩短到恰好到达；最多走 maxSteps 步（含回退前走过的步），返回所用的步数
+    int advance(double duration, int maxSteps = INT_MAX);
+
+    // 生长诊断（见 GrowthStats）：打开后求解内核每步顺带统计固相体积、界面格数、固相在各方向的范围和温度的最值，
+    // growthStats() 是最近一步结束时的值。镜像对称时按完整网格计；Sparse 时未分配的砖块按背景（phi = 0、t = 0）计；
+    // Adaptive 时按基础网格统计，每个基础格代表 _amrRatio³ 个细格；双分辨率时温度的最值取粗网格
+    void setDiagnostics(bool enabled) { _diagnostics = enabled; }
+    bool diagnostics() const { return _diagnostics || _monitor.active() || _watchdog.interval > 0; }
+    const GrowthStats& growthStats() const { return _stats; }
+
+    // 自动停止条件（见 StopConditions），设置任何条件时同时打开生长诊断。
+    // step()/advance() 在满足条件的那一步之后返回，stopReason() 是最近一次调用提前返回的原因；update() 此时暂停。
+    // 时间分块时每 depth 步检查一次
+    void setStopConditions(const StopConditions& conditions) { _monitor.setConditions(conditions); }
+    const GrowthMonitor& growthMonitor() const { return _monitor; }
+    StopReason stopReason() const { return _stopReason; }
+
+    // 发散看门狗（见 WatchdogSettings），interval > 0 时打开，同时打开生长诊断：每步用诊断的统计量检查 NaN/Inf
+    // 和 phi、t 的范围，不另外遍历场。每隔 interval 步把状态场（Sparse/Adaptive 时连同砖块）复制一份到内存，
+    // 发散时回到这份快照，dt（Adaptive 时是 cfl）减半后继续，每次回退记入 rollbacks()；
+    // 从同一快照回退 maxRetries 次仍发散时停在快照处，stopReason() 为 Diverged。
+    // 求解内核把相场限制到 [0, 1]，phi 的范围和 NaN 检查的是限制之前的新值（Adaptive 时包括加密砖块）
+    void setWatchdog(const WatchdogSettings& settings) { _watchdog = settings; _snapshot = Snapshot(); }
+    const WatchdogSettings& watchdog() const { return _watchdog; }
+    const std::vector<RollbackEvent>& rollbacks() const { return _rollbacks; }
+
+    // 时间步长控制（见 TimeStepping）：默认 Fixed；Adaptive 的安全系数是参数 cfl。
+    // 3D 的相场和温度场在同一个内核中更新，Subcycled 按 Adaptive 推进
+    void setTimeStepping(TimeStepping mode) { _timeStepping = mode; }
+    TimeStepping timeStepping() const { return _timeStepping; }
+    // 按当前参数计算相场和温度场各自的显式稳定上限（未乘 cfl）
+    void stableTimeSteps(float& dtPhi, float& dtT) const;
+
+    // 每个阶段按 z 切片并行，threads <= 0 表示使用全部核心；结果与线程数无关
+    void setThreadCount(int threads);
+    int threadCount() const { return _pool->size(); }
+
+    // 公式(19)各向异性系数的计算方式：
+    //   Algebraic（默认）：旋转和局部球坐标都化成方向余弦的多项式，不调用 acos/atan2/sin/cos
+    //   Trig：Rodrigues 旋转 + acos/atan2 求 (θ̃, φ̃) 再代入公式(19) 的原始实现
+    // 两者在数学上相同。单精度下 ∇η 接近 Ω_ori 方向（τ → 0）的格子上，Trig 的 acos 丢掉 θ̃，
+    // 除以 τ 的通量项 fluxY 相差可达其本身的大小，所以默认的 3D 轨迹与 Trig 不同（见 README）
+    enum class AnisotropyMode { Algebraic, Trig };
+    void setAnisotropyMode(AnisotropyMode mode) { _anisotropyMode = mode; }
+    AnisotropyMode anisotropyMode() const { return _anisotropyMode; }
+
+    // 边界条件：Periodic（默认）、Neumann 零通量、Dirichlet（幽灵格 phi = 0，t = tBoundary，即恒定过冷度的液体浴）
+    // 取向场在非周期边界时总是零通量
+    void setBoundary(Boundary boundary) { _boundary = boundary; }
+    Boundary boundary() const { return _boundary; }
+
+    // 双分辨率（只支持 Dense 存储且没有镜像对称，其它情况忽略）：温度场放在每个方向粗 ratio 倍的网格上，
+    // 非周期边界时粗网格在相场网格外每侧再多 pad 个粗格（在 setBoundary() 之后调用）。
+    // 求解内核由粗网格三线性插值得到驱动力中的温度，不再在细网格上存储和扩散温度；
+    // 每步之后潜热 K·Δη 平均到粗格上，扩散在粗网格上计算。切换时现有的温度场在两种网格之间转换
+    void setThermalGrid(int ratio, int pad = 0);
+    int thermalRatio() const { return _thermalRatio; }
+
+    // 相场、温度场和取向场的存储精度（见 Precision），只支持 Dense 存储且 thermalRatio = 1，
+    // 其它情况设置不起作用。各向异性量（ε² 和通量项）按计算类型存放。切换时现有的场在两种存储类型之间转换
+    void setPrecision(Precision precision);
+    Precision precision() const { return _precision; }
+
+    // 相场、温度场和取向场的拉普拉斯算子（见 stencilLaplacian()），只支持 Dense 存储，其它存储方式设置不起作用：
+    //   Point7（默认）：6 个面邻居，网格的各向异性使枝晶偏向坐标轴，需要较小的 dx
+    //   Point19：再加 12 个棱邻居；Point27：再加 8 个角邻居。两者的截断误差主项各向同性，可以用更粗的网格
+    // Fixed 以外的时间步长按所选模板的谱半径取稳定上限（19、27 点比 7 点大约 2 倍）
+    enum class LaplacianStencil { Point7, Point19, Point27 };
+    void setLaplacianStencil(LaplacianStencil stencil);
+    LaplacianStencil laplacianStencil() const { return _stencil; }
+
+    // 各向异性量（ε² 和三个通量项）的排列方式，只支持 Dense 存储，其它存储方式设置不起作用：
+    //   Separate（默认）：四个独立的数组，下标与状态场相同
+    //   Bundled：四个量按行交错存放在一个数组中，(j, k) 行依次是 ε²、fluxY、fluxZ、εε'τ 的一整行。
+    //            求解一行时读入的 11 行各向异性量集中在 5 段连续内存中，减少同时活跃的数据流和 TLB 项
+    // 两者的结果逐位相同；切换时各向异性量清零，下一步开始时重新计算
+    enum class DerivedLayout { Separate, Bundled };
+    void setDerivedLayout(DerivedLayout layout);
+    DerivedLayout derivedLayout() const { return _derivedLayout; }
+
+    // 镜像对称约化（只支持 Dense 存储且 thermalRatio = 1，其它情况设置不起作用，在 setBoundary() 之后调用）：
+    // 晶核在网格中心，方程又关于过中心的坐标面镜像对称时，只计算这些面一侧的部分网格：
+    //   None（默认）、Half：z 方向、Quarter：y、z 方向、Octant：x、y、z 方向都只算中心层及其以上的一半
+    // 对称面上的幽灵格按镜像填充（HaloSide::Reflect），周期边界时网格另一端也是对称面。
+    // width()/height()/depth()、phiAt()、exportPhi() 和渲染仍按完整网格，其余部分由镜像得到。
+    // 公式(17)的通量项 fluxY、fluxZ 在 x、y、z 镜像下都不对称，c2 ≠ 0 时完整网格的解并不对称，
+    // 约化的结果是强加了对称性的另一个解；c2 = 0（界面能各向同性）时两者只差舍入误差（见 README）。
+    // 所以 c2 ≠ 0 时只有 imposed 为 true（明确接受强加的对称性）才约化。
+    // 不满足条件时不做任何改变并返回 false；切换时重新初始化所有场（同 reset()）
+    enum class Symmetry { None, Half, Quarter, Octant };
+    bool setSymmetry(Symmetry symmetry, bool imposed = false);
+    Symmetry symmetry() const { return _symmetry; }
+    bool mirrorSymmetric() const { return _c2 == 0.0f; } // 按当前参数方程是否关于过中心的坐标面镜像对称
+
+    // 显式向量化的行内核（见 Simd.h）：默认使用 CPU 支持的最高指令集，超过 CPU 支持的级别自动降级，Scalar 使用原来的标量代码。
+    // 覆盖 Single 精度下代数路径的各向异性和通量项，以及 H = 0、温度与相场同一网格时的相场/温度求解（所有存储方式）。
+    // 各指令集的结果逐位相同，与 Scalar 的差别只来自驱动力中 atan 的多项式近似
+    void setSimd(SimdLevel level);
+    SimdLevel simd() const { return _simdLevel; }
+
+    // 时间分块：step() 把连续 depth 步的各向异性和求解两个阶段按 z 层块的波前推进（见 wavefront()），
+    // 一块 z 层在缓存中连续经过 2·depth 个阶段；depth = 1 表示逐步推进，两者的结果逐位相同。
+    // 只用于 Dense 存储、Fixed 时间步长和单一网格的温度场，其余情况以及 z 层数少于 4·depth 时仍逐步推进；
+    // advance() 总是逐步推进
+    void setTemporalBlocking(int depth) { _blockDepth = std::max(1, depth); }
+    int temporalBlocking() const { return _blockDepth; }
+
+    // 所有场数组实际占用的内存（字节，含幽灵格）
+    size_t memoryBytes() const;
+
+    Storage storage() const { return _storage; }
+    size_t brickCount() const { return _brickList.size(); } // Sparse/Adaptive：已分配的砖块数
+    size_t brickTotal() const { return _bricks.size(); }    // Sparse/Adaptive：网格划分出的砖块总数
+
+    // 按名字修改 _initParams() 中的物理常数（以及 dx/dy/dz、Sparse 的 sparseTol、时间步长的 cfl、
+    // Adaptive 的 regrid 和 amrTol），名字不存在时返回 false
+    bool setParam(const std::string& name, float value);
+
+    // 渲染逻辑（实现在 Kobayashi3DGL.cpp，批处理程序不需要链接）
     void glInit();
     void glRender();
 
@@ -25,50 +167,215 @@ public:
     void togglePause() { _updateFlag = !_updateFlag; }
     bool isPaused() const { return !_updateFlag; }
 
+    // 查询接口（Adaptive 时是细层的格子数，镜像对称时是完整网格的格子数）
+    int width() const { return _mirror[0] ? _fullCount.x : _objectCount.x * _levelRatio(); }
+    int height() const { return _mirror[1] ? _fullCount.y : _objectCount.y * _levelRatio(); }
+    int depth() const { return _mirror[2] ? _fullCount.z : _objectCount.z * _levelRatio(); }
+    long long stepCount() const { return _stepCount; }
+    double time() const { return _time; }      // 已推进的物理时间
+    float timeStep() const { return _stepDt; } // 最近一步的 dt（Adaptive 时是基础网格的一步）
+    void exportPhi(std::vector<float>& out) const; // 只导出内部格，width() × height() × depth()
+    float phiAt(int i, int j, int k) const;         // 内部格 (i, j, k) 的相场，各种存储方式通用；Adaptive 时未加密处取基础网格的值
+
 private:
+    friend struct Kobayashi3DBench; // 基准测试需要单独调用每个求解阶段
+
     // 3D 网格参数
     struct int3 { int x; int y; int z; };
-    int3 _objectCount = { 0, 0, 0 };
-    inline int _INDEX(int i, int j, int k) { return (i + _objectCount.x * (j + _objectCount.y * k)); };
+    int3 _objectCount = { 0, 0, 0 }; // Dense 数组的格子数（Adaptive 时是基础网格，镜像对称时是约化后的网格）
+    // 场数组每个方向两端各多一个幽灵格，内部格坐标从 0 开始，幽灵格坐标为 -1 和 n
+    inline int _INDEX(int i, int j, int k) const { return (i + 1) + (_objectCount.x + 2) * ((j + 1) + (_objectCount.y + 2) * (k + 1)); };
 
     float _dx, _dy, _dz, _dt;
+    float _fixedDt;    // 构造时给定的 dt，Fixed 模式每步使用
+    float _cfl = 0.7f; // Adaptive 的安全系数
+    TimeStepping _timeStepping = TimeStepping::Fixed;
     float _tau, M_eta, _K, _alpha, _gamma, _tEq;
     float _alpha_T; // 热扩散系数 a² (thermal diffusivity)
     float _H; // 取向场驱动力系数
     float M_ori; // 取向场迁移率
     float _c1, _c2; // 公式(19)中的各向异性系数：ε_o(n) = c1 + c2*(sin⁴θ̃(sin⁴φ̃ + cos⁴φ̃) + cos⁴θ̃)
+    float _tBoundary = 0.0f; // Dirichlet 边界的温度
+    float _sparseTol = 1e-6f; // Sparse：砖块内 phi、t、Ω_ori 与背景的差都不超过它时视为背景
+    int _regridInterval = 4;  // Adaptive：每隔多少步重新划分加密砖块
+    float _amrTol = 0.01f;    // Adaptive：基础格与 6 个邻居的 phi 最大差超过它时需要加密
+    float _amrTheta = 0.0f;   // Adaptive：细层子步的起点在基础步内的位置（0 为起点，1 为终点）
+    static constexpr int _amrRatio = 2; // Adaptive：加密比
+    Boundary _boundary = Boundary::Periodic;
+    Storage _storage = Storage::Dense;
+    AnisotropyMode _anisotropyMode = AnisotropyMode::Algebraic;
+    LaplacianStencil _stencil = LaplacianStencil::Point7;
+    int _stencilPoints() const; // 7、19 或 27
 
-    // 相场、温度场
-    std::vector<float> _phi, _t;
-    std::vector<float> _dPhiDt; // 存储 ∂η/∂t，用于温度方程
-
-    // 固定方向场标记
-    std::vector<bool> _isOrientationFixed;
+    // 镜像对称：_fullCount 是构造时的完整网格，_mirror[a] 表示第 a 个方向只存放中心层 c = n/2 起的一半
+    Symmetry _symmetry = Symmetry::None;
+    int3 _fullCount = { 0, 0, 0 };
+    bool _mirror[3] = { false, false, false };
+    int _fold(int a, int i) const;         // 完整网格第 a 个方向的坐标 i 对应的存储坐标
+    std::vector<int> _foldWeight[3];        // 对称的方向上每个存储坐标代表的完整网格格子数
+    HaloSides _haloSides(Boundary b) const; // 边界条件 b 加上对称面
 
-    // 相场梯度和拉普拉斯算子
-    std::vector<float> _gradPhiX, _gradPhiY, _gradPhiZ;
-    std::vector<float> _lapPhi, _lapT;
+    // 以下是 Dense 存储的场（Sparse 时为空，Adaptive 时是基础网格）
+    // 相场、温度场，以及 _solveFields() 写入的下一步的值
+    std::vector<float> _phi, _t;
+    std::vector<float> _phiNext, _tNext;
 
-    // 相场梯度模和局部方向角
-    std::vector<float> _gradPhiMag; // |∇η|
-    std::vector<float> _tau_field;  // τ = sqrt((∂η/∂x)² + (∂η/∂y)²)
-    std::vector<float> _theta, _phi_angle; // 局部相位前沿方向 Ω = (θ, φ)
+    // 双分辨率温度场：粗网格的温度及其双缓冲（含幽灵格），以及细格到粗格的插值表；ratio = 1 时为空，
+    // ratio > 1 时细网格的 _t/_tNext 为空
+    int _thermalRatio = 1, _thermalPad = 0;
+    int3 _thermalCount = { 0, 0, 0 };
+    std::vector<float> _tCoarse, _tCoarseNext;
+    std::vector<int> _thermalIndex[3];
+    std::vector<float> _thermalWeight[3];
+    inline int _COARSE(int i, int j, int k) const { return (i + 1) + (_thermalCount.x + 2) * ((j + 1) + (_thermalCount.y + 2) * (k + 1)); }
+    void _coarseTemperatureRow(int j, int k, std::vector<float>& column, float* out) const; // 第 (j, k) 行内部格由粗网格插值的温度，column 是工作区
+    void _thermalStep();          // 粗网格温度的一步：扩散加上这一步相场变化的潜热
+    void _restrictTemperature();  // 细网格温度平均到粗网格（setThermalGrid() 转换现有的温度场）
 
-    // 各向异性系数及其导数
-    std::vector<float> _epsilon, _epsilonDerivTheta, _epsilonDerivPhi;
+    // 固定方向场标记；设置任何一个标记时要同时置位 _hasFixedOrientation，否则求解时不检查
+    std::vector<bool> _isOrientationFixed;
+    bool _hasFixedOrientation = false;
 
     // 取向场：Ω_ori 用单位球上的点表示
     // 使用笛卡尔坐标 (x, y, z) 存储单位向量
     std::vector<float> _omega_ori_x, _omega_ori_y, _omega_ori_z;
+    std::vector<float> _omega_next_x, _omega_next_y, _omega_next_z; // 取向场方程的双缓冲
+
+    // 相场方程(17)中需要在邻居处取值的量，由 _computeAnisotropy() 计算
+    // 其余导数（梯度、拉普拉斯算子、||∇Ω_ori||、∂η/∂t）只在格子自身用到，不常驻内存
+    // Bundled 时四个量交错存放在 _epsilon2 中（ε² 是每组的第一行），其余三个数组为空
+    std::vector<float> _epsilon2;    // ε²
+    std::vector<float> _fluxZ;       // ε/τ·∂ε/∂θ·∂η/∂x - ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂y
+    std::vector<float> _fluxY;       // ε/τ·∂ε/∂θ·∂η/∂z + ε/τ²·∂ε/∂φ·|∇η|²·∂η/∂x
+    std::vector<float> _epsTauTheta; // ε·∂ε/∂θ·τ
+
+    // 一块带一圈幽灵格的场数据，求解内核只通过它访问场：Dense 时是整个网格，Sparse 时是一个砖块，
+    // Adaptive 时是基础网格或一个加密砖块。S 是状态场的存储类型，各向异性量按计算类型存放
+    template <class S> struct BlockOf
+    {
+        typedef typename FieldTraits<S>::Real Real;
+        int nx, ny, nz; // 内部格数
+        int sx, sy;     // 含幽灵格的 x、y 方向长度
+        S *phi, *t, *phiNext, *tNext;
+        S *omegaX, *omegaY, *omegaZ, *omegaNextX, *omegaNextY, *omegaNextZ;
+        Real *epsilon2, *fluxY, *fluxZ, *epsTauTheta;
+        int dsy, dsz;   // 各向异性量相邻行、相邻层的下标步长（Separate 时与状态场相同）
+        inline int index(int i, int j, int k) const { return (i + 1) + sx * ((j + 1) + sy * (k + 1)); }
+        inline int derivedIndex(int i, int j, int k) const { return (i + 1) + dsy * (j + 1) + dsz * (k + 1); }
+    };
+    typedef BlockOf<float> Block;
+    Block _denseBlock();
+
+    // 内核遍历一块场数据中 [k0, k1) 层各行的顺序。y 方向切成 KOBAYASHI3D_TILE_ROWS 行的条带，
+    // 条带内逐层推进，再转到下一个条带：第 j 行读的 ±z 邻居（状态场和各向异性量）是几行之前刚访问过的，
+    // 仍在 L1/L2 中，而逐层遍历时它们相隔整整一层，大网格上每层都要重新从内存读入。
+    // 每行仍是连续的 x 方向，SIMD 行内核和幽灵格不受影响；各行的计算互不依赖，结果与遍历顺序无关
+    struct RowWalk
+    {
+        int j, k; // 当前行
+        RowWalk(int ny, int k0, int k1)
+            : j(-1), k(k0), _ny(ny), _k0(k0), _k1(k1), _band(KOBAYASHI3D_TILE_ROWS > 0 ? KOBAYASHI3D_TILE_ROWS : ny), _j0(0) {}
+        // 移到下一行，全部走完时返回 false
+        bool next()
+        {
+            if (_k0 >= _k1 || _j0 >= _ny) return false;
+            if (++j < std::min(_j0 + _band, _ny)) return true;
+            j = _j0;
+            if (++k < _k1) return true;
+            _j0 += _band; // 下一个条带
+            j = _j0;
+            k = _k0;
+            return _j0 < _ny;
+        }
+    private:
+        int _ny, _k0, _k1, _band, _j0;
+    };
 
-    // 取向场的局部极坐标表示 (ρ, λ)
-    // ρ: 中心角（大圆距离）
-    // λ: 立体投影后的极坐标角度
-    std::vector<float> _rho_x_plus, _rho_x_minus, _rho_y_plus, _rho_y_minus, _rho_z_plus, _rho_z_minus;
-    std::vector<float> _lambda_x_plus, _lambda_x_minus, _lambda_y_plus, _lambda_y_minus, _lambda_z_plus, _lambda_z_minus;
+    // Single 以外的精度：Dense 的场按存储类型 S 存放在对应的 FieldSet 中，此时上面的 float 数组为空
+    template <class S> struct FieldSet
+    {
+        typedef typename FieldTraits<S>::Real Real;
+        std::vector<S> phi, t, phiNext, tNext, omegaX, omegaY, omegaZ, omegaNextX, omegaNextY, omegaNextZ;
+        std::vector<Real> epsilon2, fluxY, fluxZ, epsTauTheta;
+        size_t bytes() const
+        {
+            return (phi.capacity() + t.capacity() + phiNext.capacity() + tNext.capacity() + omegaX.capacity() + omegaY.capacity()
+                    + omegaZ.capacity() + omegaNextX.capacity() + omegaNextY.capacity() + omegaNextZ.capacity()) * sizeof(S)
+                 + (epsilon2.capacity() + fluxY.capacity() + fluxZ.capacity() + epsTauTheta.capacity()) * sizeof(Real);
+        }
+    };
+    Precision _precision = Precision::Single;
+    DerivedLayout _derivedLayout = DerivedLayout::Separate;
+    template <class R> // 按 _derivedLayout 分配并清零
+    void _allocateDerived(std::vector<R>& epsilon2, std::vector<R>& fluxY, std::vector<R>& fluxZ, std::vector<R>& epsTauTheta, size_t cells) const;
+    template <class S> void _bundleDerived(BlockOf<S>& blk) const; // Bundled 时把各向异性量的指针和步长指向交错的数组
+    FieldSet<Half> _halfFields;
+    FieldSet<BFloat16> _bfloat16Fields;
+    FieldSet<double> _doubleFields;
+    template <class S> FieldSet<S>& _fieldSet();
+    template <class S> BlockOf<S> _packedBlock();
+    void _convertFields(bool pack);          // 在 float 的场与当前精度的 FieldSet 之间转换
+    template <class S> void _packFields();   // float 的场转换成 FieldSet<S> 并释放
+    template <class S> void _unpackFields(); // FieldSet<S> 转换回 float 的场
+    template <class S> void _fillPackedHalo();
+    template <class S> void _solvePackedFields();
 
-    // 取向场梯度：∇Ω_ori（使用 (ρ, λ) 计算）
-    std::vector<float> _gradOmegaOriMag; // ||∇Ω_ori||
+    // Sparse 存储：砖块按砖块坐标存放在 _bricks 中，未分配（nullptr）的砖块是背景
+    // Adaptive 存储：同样的砖块表覆盖细层网格，未分配的砖块处只有基础网格
+    // 每个砖块的场都是 (_brickSize + 2)³ 的数组，外面一圈是幽灵格；网格边缘的砖块内部格可以不满
+    enum BrickField {
+        FieldPhi, FieldT, FieldOmegaX, FieldOmegaY, FieldOmegaZ,
+        FieldPhiNext, FieldTNext, FieldOmegaNextX, FieldOmegaNextY, FieldOmegaNextZ,
+        FieldEpsilon2, FieldFluxY, FieldFluxZ, FieldEpsTauTheta, FieldCount
+    };
+    struct Brick
+    {
+        int coord[3]; // 砖块坐标
+        int n[3];     // 内部格数
+        std::vector<float> data[FieldCount]; // 取向场的 Next 缓冲只在 H ≠ 0 时分配
+    };
+    static constexpr int _brickSize = 16;
+    int _bricksPerAxis[3] = { 0, 0, 0 };
+    std::vector<std::unique_ptr<Brick>> _bricks;
+    std::vector<Brick*> _brickList; // 已分配的砖块，各阶段按它并行
+    float _backgroundDerived[4] = { 0.0f, 0.0f, 0.0f, 0.0f }; // 背景处的 ε²、fluxY、fluxZ、εε'τ
+
+    long long _stepCount = 0;
+    double _time = 0.0;
+    float _stepDt = 0.0f;
+    std::shared_ptr<ThreadPool> _pool;
+    SimdLevel _simdLevel = SimdLevel::Scalar;
+    const SimdKernels* _simd = nullptr; // Scalar 时为空
+    int _blockDepth = 1;                // 时间分块的步数
+
+    // 生长诊断：_stepStats 在一步内由各个任务合并（存储坐标），步末转换到完整网格后存入 _stats
+    bool _diagnostics = false;
+    GrowthStats _stats, _stepStats;
+    std::mutex _statsLock;
+    GrowthMonitor _monitor;
+    StopReason _stopReason = StopReason::None;
+
+    // 发散看门狗：快照是状态场（Single 以外的精度时是 FieldSet 中的状态场）、已分配砖块的状态场以及步数、时间和诊断，
+    // stepCount < 0 表示没有快照；_divergence 是最近一步发散的原因，_retries 是从当前快照连续回退的次数
+    struct Snapshot
+    {
+        std::vector<float> phi, t, omegaX, omegaY, omegaZ, tCoarse;
+        FieldSet<Half> half;
+        FieldSet<BFloat16> bfloat16;
+        FieldSet<double> dbl;
+        std::vector<Brick> bricks; // 按 _brickList 的顺序，只有 FieldPhi、FieldT 和取向场非空
+        long long stepCount = -1;
+        double time = 0.0;
+        float stepDt = 0.0f;
+        GrowthStats stats;
+        GrowthMonitor monitor;
+    };
+    WatchdogSettings _watchdog;
+    Snapshot _snapshot;
+    const char* _divergence = nullptr;
+    int _retries = 0;
+    std::vector<RollbackEvent> _rollbacks;
+    static const int _stateFields[5]; // 砖块的状态场
 
     // OpenGL 相关
     bool _updateFlag = true;
@@ -76,9 +383,70 @@ private:
     void _initParams();
     void _vectorInit();
     void _createNucleus(int x, int y, int z);
-    void _computeGradientLaplacian();
-    void _solvePhaseField();       // 解相场方程(17)，存储 ∂η/∂t
-    void _solveOrientationField(); // 解取向场方程(18)
-    void _solveTemperatureField(); // 解温度方程(5)
-    void _updatePhaseField();      // 更新相场
+    float& _phiRef(int i, int j, int k); // Sparse/Adaptive 时按需分配砖块
+    int _levelRatio() const { return _storage == Storage::Adaptive ? _amrRatio : 1; }
+    void _advanceStep(float maxDt); // 推进一步，dt 不超过 maxDt
+    void _fillHalo();          // 每步开始前按边界条件填充 _phi/_t/_omega_ori_* 的幽灵格
+    void _computeAnisotropy(); // 各向异性系数和通量项
+    void _solveFields();       // 解方程(17)(18)(5)并更新相场
+    template <class S> void _denseAnisotropy(const BlockOf<S>& blk); // Dense：计算并填充幽灵格
+    template <class S> void _swapNext(); // Dense：交换状态场和 Next 缓冲（H = 0 时取向场不交换）
+    bool _temporalBlock(int depth);      // 时间分块推进 depth 步，不满足条件时返回 false
+    template <class S> bool _blockedSteps(int depth, const BlockOf<S>& blk);
+    // 生长诊断：[k0, k1) 层的新值 phi、t（可以为空）计入 _stepStats，(oi, oj, ok) 是这块场数据的坐标原点
+    template <class S> void _measureBlock(const BlockOf<S>& blk, const S* phi, const S* t, int k0, int k1, int oi = 0, int oj = 0, int ok = 0);
+    void _finishStats(); // 步末：统计转换到完整网格，检查发散和停止条件
+    void _saveSnapshot(); // 看门狗：距上一个快照满 interval 步时保存当前状态
+    void _rollback();     // 看门狗：回到快照，dt 减半
+    template <class S> static void _copyState(FieldSet<S>& to, const FieldSet<S>& from)
+    {
+        to.phi = from.phi;
+        to.t = from.t;
+        to.omegaX = from.omegaX;
+        to.omegaY = from.omegaY;
+        to.omegaZ = from.omegaZ;
+    }
+
+    // H = 0 时取向场方程(18)的右端和 f_ori 都恒为 0
+    bool _orientationEnabled() const { return _H != 0.0f; }
+
+    // 各阶段在一块场数据的 z ∈ [k0, k1) 切片上的实现
+    template <class S> void _computeAnisotropyBlock(const BlockOf<S>& blk, int k0, int k1);
+    template <class S, bool Orientation, bool FixedMask, bool UnitAlphaT, bool CoarseT>
+    void _solveFieldsBlock(const BlockOf<S>& blk, int k0, int k1);
+    template <class S> using BlockFnOf = void (Kobayashi3D::*)(const BlockOf<S>&, int, int);
+    typedef BlockFnOf<float> BlockFn;
+    template <class S> BlockFnOf<S> _solveKernel() const; // 按当前参数选择 _solveFieldsBlock 的特化版本
+    int _planeGrain() const; // Dense 各阶段每个任务块的 z 层数
+
+    // Sparse 存储
+    Brick* _brickAt(int bx, int by, int bz) const;
+    Brick* _allocateBrick(int bx, int by, int bz);
+    void _allocateOrientationNext(); // H 改为非零时为已分配的砖块补上取向场的 Next 缓冲
+    Block _brickBlock(Brick& brick);
+    bool _brickBusy(const Brick& brick) const;
+    void _updateBricks(); // 每步开始前：为不是背景的砖块分配 6 个相邻砖块，释放远离它们的砖块
+    void _fillBrickHalo(const int* fields, int count);
+    void _computeBrickAnisotropy();         // 在所有已分配的砖块上计算各向异性量（不填幽灵格）
+    void _solveBrickFields(BlockFn kernel); // 在所有已分配的砖块上求解并交换双缓冲
+
+    // Adaptive 存储
+    void _scaleLevel(float factor); // dx、dy、dz、dt 乘以 factor，在细层和基础网格之间切换
+    void _adaptiveStep();           // 基础网格走一步，加密砖块走 _amrRatio 个子步，再把结果限制回基础网格
+    float _coarseValue(int f, int gi, int gj, int gk) const; // 细层格子（可以是幽灵格）处由基础网格插值的场 f
+    void _restrictBricks();         // 加密砖块按 _amrRatio³ 平均写回基础网格
+    void _regrid();                 // 按基础网格上的界面重新划分加密砖块，新砖块由基础网格插值
+
+    // Algebraic 与 Trig 在同一状态上的最大绝对差：ε 及其导数，以及由它们组合出的通量项（fluxScale 是 Trig 通量项的最大绝对值）
+    struct AnisotropyDeviation
+    {
+        float eps = 0.0f, epsTheta = 0.0f, epsPhi = 0.0f;
+        float fluxY = 0.0f, fluxZ = 0.0f, epsTauTheta = 0.0f, fluxScale = 0.0f;
+    };
+    // 在当前状态的所有内部格上同时用两种方式计算（只支持 Dense、Single），基准测试用它检查 Algebraic 与 Trig 的一致性
+    void _anisotropyDeviation(AnisotropyDeviation& dev) const;
+
+    // 算法1：由 6 个邻居的取向计算 ||∇Ω_ori||
+    template <class S>
+    typename FieldTraits<S>::Real _orientationGradientMag(const BlockOf<S>& blk, int idx, int idx_xp, int idx_xm, int idx_yp, int idx_ym, int idx_zp, int idx_zm);
 };
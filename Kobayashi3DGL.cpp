@@ -0,0 +1,94 @@
+#include "Kobayashi3D.h"
+#include <GL/freeglut.h>
+
+// ==========================================
+// 图形渲染部分 (OpenGL)
+// ==========================================
+
+// 初始化 OpenGL 设置
+void Kobayashi3D::glInit() {
+    // 启用深度测试（3D渲染必需）
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    // 启用混合（用于半透明效果）
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // 设置点的大小
+    glPointSize(2.0f);
+
+    // 设置背景颜色为深灰色
+    glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+}
+
+// 3D渲染函数 - 使用点云渲染晶体
+void Kobayashi3D::glRender() {
+    // 清除颜色和深度缓冲区
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // 设置投影矩阵
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    float aspect = 1.0f; // 假设窗口是正方形
+    gluPerspective(45.0, aspect, 0.1, 100.0);
+
+    // 设置模型视图矩阵
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    // 相机位置：从远处观察晶体
+    static float angle = 0.0f;
+    angle += 0.5f; // 自动旋转
+    float camDist = 3.0f;
+    gluLookAt(camDist * cos(angle * PI_F / 180.0f), camDist * 0.5f, camDist * sin(angle * PI_F / 180.0f),  // 相机位置
+              0.0f, 0.0f, 0.0f,   // 看向原点
+              0.0f, 1.0f, 0.0f);  // 上方向
+
+    // 将晶体居中并缩放到合适大小
+    glTranslatef(-0.5f, -0.5f, -0.5f); // 移动到原点
+    float scale = 1.0f / (float)width();
+    glScalef(scale, scale, scale);
+
+    // 绘制晶体体素
+    glBegin(GL_POINTS);
+
+    // 定义颜色映射
+    auto getColor = [](float phi) -> void {
+        if (phi < 0.1f) {
+            // 液相：不绘制或半透明蓝色
+            return;
+        } else if (phi < 0.5f) {
+            // 界面区域：蓝色到青色渐变
+            float t = (phi - 0.1f) / 0.4f;
+            glColor4f(0.2f, 0.5f + 0.5f * t, 1.0f, 0.3f + 0.4f * t);
+        } else if (phi < 0.9f) {
+            // 过渡区域：青色到白色
+            float t = (phi - 0.5f) / 0.4f;
+            glColor4f(0.5f + 0.5f * t, 0.8f + 0.2f * t, 1.0f, 0.7f + 0.3f * t);
+        } else {
+            // 固相中心：白色
+            glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+        }
+    };
+
+    // 遍历所有体素，只绘制相场值大于阈值的点
+    int skip = 1; // 采样间隔，可以调整以提高性能
+    for (int k = 0; k < depth(); k += skip) {
+        for (int j = 0; j < height(); j += skip) {
+            for (int i = 0; i < width(); i += skip) {
+                float phi = phiAt(i, j, k); // 稀疏存储时未分配的砖块返回背景值
+
+                if (phi > 0.1f) { // 只绘制相场值大于0.1的点
+                    getColor(phi);
+                    glVertex3f((float)i, (float)j, (float)k);
+                }
+            }
+        }
+    }
+
+    glEnd();
+
+    // 交换缓冲区
+    glutSwapBuffers();
+}
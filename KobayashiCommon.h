@@ -0,0 +1,668 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// 2D 与 3D 求解器共用的常量
+// 两个求解器可以链接进同一个程序（例如基准测试），公共定义只能出现在这里
+
+const float PI_F = 3.14159265358979f;
+
+// ==========================================
+// 场的存储精度
+// ==========================================
+
+// 状态场（相场、温度，3D 还有取向）的存储类型；计算总是在寄存器中用 FieldTraits<S>::Real 进行：
+//   Single   : float 存储、float 计算（默认）
+//   Half     : IEEE binary16 存储（10 位尾数，最大 65504），float 计算
+//   BFloat16 : bfloat16 存储（float 的高 16 位，7 位尾数，范围与 float 相同），float 计算
+//   Double   : double 存储、double 计算，作为其它精度的参考解
+// 模板内核受内存带宽限制，16 位存储使状态场的流量减半，代价是每步写回时的舍入误差
+enum class Precision { Single, Half, BFloat16, Double };
+
+struct Half { uint16_t bits; };
+struct BFloat16 { uint16_t bits; };
+
+inline uint32_t floatBits(float v) { uint32_t u; std::memcpy(&u, &v, sizeof(u)); return u; }
+inline float bitsFloat(uint32_t u) { float v; std::memcpy(&v, &u, sizeof(v)); return v; }
+
+// 存储类型 S 的读写：load() 把存储值放宽成计算类型，store() 就近舍入（平局取偶）回存储类型
+template <class S> struct FieldTraits;
+
+template <> struct FieldTraits<float>
+{
+    typedef float Real;
+    static float load(float v) { return v; }
+    static float store(float v) { return v; }
+};
+
+template <> struct FieldTraits<double>
+{
+    typedef double Real;
+    static double load(double v) { return v; }
+    static double store(double v) { return v; }
+};
+
+// binary16 与 float 的转换只用整数运算和选择，内循环中可以向量化：
+// 规格化数直接调整指数偏置（15 → 127）；非规格化数先当作指数为 1 的数，再减去 2^-14；Inf/NaN 的指数全为 1
+template <> struct FieldTraits<Half>
+{
+    typedef float Real;
+#if defined(__F16C__)
+    // 编译时打开 F16C（-mf16c 或 -march=native）用硬件转换指令，舍入方式与下面的软件实现相同
+    static float load(Half h) { return _cvtsh_ss(h.bits); }
+    static Half store(float v)
+    {
+        Half h;
+        h.bits = (uint16_t)_cvtss_sh(v, _MM_FROUND_TO_NEAREST_INT);
+        return h;
+    }
+#else
+    static float load(Half h)
+    {
+        uint32_t bits = (uint32_t)(h.bits & 0x7fff) << 13;
+        uint32_t exp = bits & (0x7c00u << 13);
+        bits += (127 - 15) << 23;
+        bits += (exp == (0x7c00u << 13)) ? (128 - 16) << 23 : 0;
+        float v = bitsFloat(exp == 0 ? bits + (1 << 23) : bits);
+        v = (exp == 0) ? v - bitsFloat(113u << 23) : v;
+        return bitsFloat(floatBits(v) | (uint32_t)(h.bits & 0x8000) << 16);
+    }
+    // 绝对值不小于 65520 的数变成 Inf，小于 2^-24 的一半变成 0
+    static Half store(float v)
+    {
+        uint32_t u = floatBits(v);
+        uint32_t sign = (u >> 16) & 0x8000;
+        u &= 0x7fffffff;
+        Half h;
+        if (u >= (127u + 16) << 23) {
+            h.bits = (uint16_t)(sign | (u > 0x7f800000u ? 0x7e00 : 0x7c00));
+        } else if (u < 113u << 23) {
+            // 非规格化：加上 2^-1 使尾数的最低位对齐 2^-24，浮点加法本身完成舍入
+            h.bits = (uint16_t)(sign | (floatBits(bitsFloat(u) + 0.5f) - 0x3f000000u));
+        } else {
+            uint32_t odd = (u >> 13) & 1;
+            u += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+            h.bits = (uint16_t)(sign | (u >> 13));
+        }
+        return h;
+    }
+#endif
+};
+
+template <> struct FieldTraits<BFloat16>
+{
+    typedef float Real;
+    static float load(BFloat16 h) { return bitsFloat((uint32_t)h.bits << 16); }
+    static BFloat16 store(float v)
+    {
+        uint32_t u = floatBits(v);
+        BFloat16 h;
+        if ((u & 0x7fffffff) > 0x7f800000u) h.bits = (uint16_t)((u >> 16) | 0x40); // NaN 保持为 quiet NaN
+        else h.bits = (uint16_t)((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+        return h;
+    }
+};
+
+// 整个数组在 float 和存储类型 S 之间转换（切换精度时使用）
+template <class S> inline void narrowField(const std::vector<float>& in, std::vector<S>& out)
+{
+    out.resize(in.size());
+    for (size_t n = 0; n < in.size(); n++) out[n] = FieldTraits<S>::store(in[n]);
+}
+
+template <class S> inline void widenField(const std::vector<S>& in, std::vector<float>& out)
+{
+    out.resize(in.size());
+    for (size_t n = 0; n < in.size(); n++) out[n] = (float)FieldTraits<S>::load(in[n]);
+}
+
+// ==========================================
+// 幽灵格（halo）与边界条件
+// ==========================================
+
+// 两个求解器的场都在每个方向多存一圈幽灵格，每步开始前按边界条件填好，
+// 内部循环访问邻居时只需加减固定步长，不再对下标取模。
+//   Periodic : 周期边界，幽灵格取对侧的内部格
+//   Neumann  : 零通量，幽灵格复制相邻的内部格
+//   Dirichlet: 幽灵格取固定值（例如恒温浴的温度）
+enum class Boundary { Periodic, Neumann, Dirichlet };
+
+// 坐标 g ∈ [-1, n] 取值时对应的内部格坐标（Dirichlet 的固定值由调用者处理，这里按 Neumann 复制）
+inline int haloSource(int g, int n, Boundary b)
+{
+    if (g >= 0 && g < n) return g;
+    if (b == Boundary::Periodic) return (g + n) % n;
+    return g < 0 ? 0 : n - 1;
+}
+
+// 填充 (nx + 2) × (ny + 2) 的 2D 场中 [j0, j1) 行的幽灵格：先填这些行的左右两列，
+// 第一行或最后一行在范围内时再整行填相应的上下幽灵行（四个角随之填好）。
+// 上下幽灵行只依赖第 0 行和第 ny-1 行，所以按行块依次填充与一次填完整个场的结果相同
+// T 是场的存储类型（见 FieldTraits）
+template <class T>
+inline void fillHaloRows2D(T* f, int nx, int ny, int j0, int j1, Boundary b, float value = 0.0f)
+{
+    int sx = nx + 2;
+    auto at = [&](int i, int j) -> T& { return f[(i + 1) + sx * (j + 1)]; };
+    bool fixed = (b == Boundary::Dirichlet);
+    T fixedValue = FieldTraits<T>::store(value);
+
+    for (int j = j0; j < j1; j++) {
+        at(-1, j) = fixed ? fixedValue : at(haloSource(-1, nx, b), j);
+        at(nx, j) = fixed ? fixedValue : at(haloSource(nx, nx, b), j);
+    }
+    // 幽灵行 g 复制内部行 haloSource(g)：周期边界时第 0 行决定第 ny 行，第 ny-1 行决定第 -1 行
+    for (int g : { -1, ny }) {
+        int src = haloSource(g, ny, b);
+        if (src < j0 || src >= j1) continue;
+        for (int i = -1; i <= nx; i++) at(i, g) = fixed ? fixedValue : at(i, src);
+    }
+}
+
+// 填充整个 2D 场的幽灵格
+template <class T>
+inline void fillHalo2D(std::vector<T>& f, int nx, int ny, Boundary b, float value = 0.0f)
+{
+    fillHaloRows2D(f.data(), nx, ny, 0, ny, b, value);
+}
+
+// 3D 场一个方向一端的幽灵格：
+//   Wrap    : 取对侧的内部格（周期）
+//   Copy    : 复制相邻的内部格（零通量）
+//   Reflect : 复制隔一层的内部格，即镜像对称面穿过最外层内部格的格心（见 Kobayashi3D::setSymmetry()）
+//   Fixed   : 固定值
+enum class HaloSide { Wrap, Copy, Reflect, Fixed };
+
+// 3D 场六个面的幽灵格，lo[a]、hi[a] 是第 a 个方向坐标 -1 和 n 的一端。
+// 可以由 Boundary 隐式构造，六个面取同一种边界条件
+struct HaloSides
+{
+    HaloSide lo[3], hi[3];
+    HaloSides(Boundary b)
+    {
+        HaloSide side = (b == Boundary::Periodic) ? HaloSide::Wrap : (b == Boundary::Dirichlet) ? HaloSide::Fixed : HaloSide::Copy;
+        for (int a = 0; a < 3; a++) lo[a] = hi[a] = side;
+    }
+};
+
+// 坐标 g ∈ [-1, n] 取值时对应的内部格坐标，side 是 g 所在一端（Fixed 的固定值由调用者处理，这里按 Copy）
+inline int haloSource(int g, int n, HaloSide side)
+{
+    if (g >= 0 && g < n) return g;
+    if (side == HaloSide::Wrap) return (g + n) % n;
+    if (side == HaloSide::Reflect) return g < 0 ? 1 : n - 2;
+    return g < 0 ? 0 : n - 1;
+}
+
+// 填充 (nx + 2) × (ny + 2) × (nz + 2) 的 3D 场中 [k0, k1) 层的幽灵格，依次处理 x、y 方向，
+// 源层在范围内时再填相应的 z 方向幽灵层（与 fillHaloRows2D() 相同）。
+// 相邻行、相邻层的下标相差 rowStride、planeStride，几个场逐行交错存放时大于 nx + 2、(nx + 2)(ny + 2)
+template <class T>
+inline void fillHaloStrided3D(T* f, int nx, int ny, int nz, int rowStride, int planeStride, int k0, int k1, const HaloSides& sides, float value = 0.0f)
+{
+    auto at = [&](int i, int j, int k) -> T& { return f[(i + 1) + rowStride * (j + 1) + (size_t)planeStride * (k + 1)]; };
+    T fixedValue = FieldTraits<T>::store(value);
+    const int n[3] = { nx, ny, nz };
+    // 第 a 个方向坐标 g 处幽灵格的来源，-1 表示固定值
+    auto source = [&](int a, int g) {
+        HaloSide side = g < 0 ? sides.lo[a] : sides.hi[a];
+        return side == HaloSide::Fixed ? -1 : haloSource(g, n[a], side);
+    };
+
+    for (int k = k0; k < k1; k++) {
+        for (int g : { -1, nx }) {
+            int src = source(0, g);
+            for (int j = 0; j < ny; j++) at(g, j, k) = src < 0 ? fixedValue : at(src, j, k);
+        }
+        for (int g : { -1, ny }) {
+            int src = source(1, g);
+            for (int i = -1; i <= nx; i++) at(i, g, k) = src < 0 ? fixedValue : at(i, src, k);
+        }
+    }
+    // z 方向的幽灵层由源层（固定值时是相邻的内部层）所在的层块填充
+    for (int g : { -1, nz }) {
+        int src = source(2, g), owner = src < 0 ? (g < 0 ? 0 : nz - 1) : src;
+        if (owner < k0 || owner >= k1) continue;
+        for (int j = -1; j <= ny; j++)
+            for (int i = -1; i <= nx; i++) at(i, j, g) = src < 0 ? fixedValue : at(i, j, src);
+    }
+}
+
+// 按行存放的 3D 场中 [k0, k1) 层的幽灵格
+template <class T>
+inline void fillHaloPlanes3D(T* f, int nx, int ny, int nz, int k0, int k1, const HaloSides& sides, float value = 0.0f)
+{
+    fillHaloStrided3D(f, nx, ny, nz, nx + 2, (nx + 2) * (ny + 2), k0, k1, sides, value);
+}
+
+// 填充整个 3D 场的幽灵格
+template <class T>
+inline void fillHalo3D(std::vector<T>& f, int nx, int ny, int nz, const HaloSides& sides, float value = 0.0f)
+{
+    fillHaloPlanes3D(f.data(), nx, ny, nz, 0, nz, sides, value);
+}
+
+// ==========================================
+// 时间分块
+// ==========================================
+
+// 波前调度：stages 个前后依赖的阶段（连续的时间步，或一步中的几个阶段）沿一个方向切成 chunks 块交错执行。
+// 阶段 s 依次处理第 s, s+1, ..., s-1 块（对 chunks 取模），比阶段 s-1 晚 3 个波次；
+// 每块只读前一阶段第 c-1、c、c+1 块的结果，只写自己这一块，于是
+//   - 阶段 s 处理第 c 块时，前面的阶段都已写完这三块，也已读完第 c 块上要被覆盖的旧值
+//     （从第 s 块开始，周期边界时首尾两块之间的依赖同样满足）；
+//   - 同一波次中相邻阶段相隔 2 块，chunks >= 2·stages 时各阶段读写的范围互不重叠。
+// 每个波次的 (阶段, 块) 各切成 parts 份，一起交给 parallelFor()：run(stage, chunk, part)；
+// 屏障之后依次调用 finish(stage, chunk)，例如填充这一块的幽灵格。
+// 一个块在缓存中连续经过所有阶段，而不是每个阶段都把整个场读写一遍
+template <class Pool, class Run, class Finish>
+inline void wavefront(Pool& pool, int stages, int chunks, int parts, Run run, Finish finish)
+{
+    std::vector<int> active; // 本波次的 (阶段, 块)，交替存放
+    for (int w = 0; w < chunks + 3 * (stages - 1); w++) {
+        active.clear();
+        for (int s = 0; s < stages; s++) {
+            int q = w - 3 * s;
+            if (q < 0 || q >= chunks) continue;
+            active.push_back(s);
+            active.push_back((s + q) % chunks);
+        }
+        int tasks = (int)active.size() / 2;
+        pool.parallelFor(0, tasks * parts, [&](int b, int e) {
+            for (int n = b; n < e; n++) run(active[2 * (n / parts)], active[2 * (n / parts) + 1], n % parts);
+        }, 1);
+        for (int n = 0; n < tasks; n++) finish(active[2 * n], active[2 * n + 1]);
+    }
+}
+
+// ==========================================
+// 时间步长
+// ==========================================
+
+// 时间步长控制：
+//   Fixed     : 每步使用构造时给定的 dt
+//   Adaptive  : 每步由当前参数求出显式格式的稳定上限，乘以安全系数 cfl 作为 dt
+//   Subcycled : 相场和温度场各取自己的稳定上限，上限较大的场走一大步，另一个场在这一步内走若干小步
+enum class TimeStepping { Fixed, Adaptive, Subcycled };
+
+// 显式欧拉推进 ∂u/∂t = D·∇²u + f(u) 的稳定步长上限：
+// 离散拉普拉斯算子的特征值在 [-laplacianRadius, 0] 内、|f'(u)| ≤ reactionRate 时，
+// 放大因子 |1 - dt·(D·laplacianRadius + reactionRate)| ≤ 1 要求 dt ≤ 2 / (D·laplacianRadius + reactionRate)
+inline float explicitStableStep(float diffusivity, float laplacianRadius, float reactionRate)
+{
+    return 2.0f / (diffusivity * laplacianRadius + reactionRate);
+}
+
+// ==========================================
+// 双分辨率温度场
+// ==========================================
+
+// 温度场可以放在每个方向粗 ratio 倍的网格上，并在相场网格外每侧多 pad 个粗格：
+// 长度 n 的相场方向对应 (n + ratio - 1) / ratio + 2·pad 个粗格，细格 i 属于粗格 i / ratio + pad
+inline int coarseCount(int n, int ratio, int pad)
+{
+    return (n + ratio - 1) / ratio + 2 * pad;
+}
+
+// 细格 i 的中心在粗网格坐标中位于 (i + 0.5)/ratio - 0.5 + pad，线性插值取粗格 index[i] 和 index[i] + 1，
+// 权重分别是 1 - weight[i] 和 weight[i]；粗格下标可以是幽灵格 -1 或 coarseCount
+inline void coarseInterpolation(int n, int ratio, int pad, std::vector<int>& index, std::vector<float>& weight)
+{
+    index.resize(n);
+    weight.resize(n);
+    for (int i = 0; i < n; i++) {
+        float x = (i + 0.5f) / ratio - 0.5f + pad;
+        int c = (x < 0.0f) ? -1 : (int)x;
+        index[i] = c;
+        weight[i] = x - c;
+    }
+}
+
+// ==========================================
+// SIMD 指令集
+// ==========================================
+
+// 热点行内核的实现方式（见 Simd.h）：Scalar 是原来的标量代码，其余是对应指令集的显式向量化版本
+//   SSE4   : 4 路 float（SSE4.1）
+//   AVX2   : 8 路 float
+//   AVX512 : 16 路 float（AVX-512F）
+enum class SimdLevel { Scalar, SSE4, AVX2, AVX512 };
+
+inline const char* simdName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::SSE4: return "sse4";
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+// ==========================================
+// 生长诊断与停止条件
+// ==========================================
+
+// GrowthStats::addRow() 中一行的计数和最值：phi、t 可以为空，solid、band 从 0 累加，最值在初值上更新。
+// residue 累加每个值的 x - x，全部有限时保持 0，遇到 NaN/Inf 变成 NaN（所以不能用 -ffast-math 编译）
+struct GrowthRowCount
+{
+    const float *phi, *t;
+    int n;
+    int solid, band;
+    float tMin, tMax;
+    float phiMin, phiMax;
+    float residue;
+};
+typedef void (*GrowthRowFn)(GrowthRowCount&);
+
+// 一步结束时场的统计量。求解内核写完一段行后顺带累加，这些行还在缓存中，不另外遍历整个场。
+// 坐标是完整网格的格子坐标，2D 时第三个方向不用
+struct GrowthStats
+{
+    long long solidCells = 0;     // phi > 0.5 的格子数（固相体积）
+    long long interfaceCells = 0; // 0.1 < phi < 0.9 的格子数（扩散界面层）
+    int lo[3] = { INT_MAX, INT_MAX, INT_MAX }; // phi > 0.5 的格子在各方向的最小、最大坐标，没有固相时 lo > hi
+    int hi[3] = { INT_MIN, INT_MIN, INT_MIN };
+    float tMin = FLT_MAX, tMax = -FLT_MAX;
+    float phiMin = FLT_MAX, phiMax = -FLT_MAX;
+    bool finite = true; // phi、t 中没有 NaN/Inf
+
+    bool hasSolid() const { return lo[0] <= hi[0]; }
+
+    void merge(const GrowthStats& o)
+    {
+        solidCells += o.solidCells;
+        interfaceCells += o.interfaceCells;
+        for (int a = 0; a < 3; a++) {
+            lo[a] = std::min(lo[a], o.lo[a]);
+            hi[a] = std::max(hi[a], o.hi[a]);
+        }
+        tMin = std::min(tMin, o.tMin);
+        tMax = std::max(tMax, o.tMax);
+        phiMin = std::min(phiMin, o.phiMin);
+        phiMax = std::max(phiMax, o.phiMax);
+        finite = finite && o.finite;
+    }
+
+    // 计入没有经过 addRow() 的一组 phi 值的最值和 x − x 之和 residue（例如 3D 求解内核中限制到 [0, 1] 之前的新值，
+    // 限制会把失稳的值和 NaN 变成 0 或 1）
+    void addPhiRange(float lo, float hi, float residue)
+    {
+        phiMin = std::min(phiMin, lo);
+        phiMax = std::max(phiMax, hi);
+        finite = finite && residue == 0.0f;
+    }
+
+    // 计入坐标为 (x0 .. x0 + n - 1, j, k) 的一行格子，phi、t 指向这一行的第一个格子（不统计的场传空指针）。
+    // 每个格子计 weight 次，colWeight 非空时再乘以 colWeight[i]（镜像对称时一个存储格代表的完整格子数）。
+    // count 是 float 存储时计数和求最值的 SIMD 行内核（见 Simd.h），为空或其它存储类型时用 countRow()
+    template <class S>
+    void addRow(const S* phi, const S* t, int n, int x0, int j, int k, long long weight = 1, const int* colWeight = nullptr,
+                GrowthRowFn count = nullptr)
+    {
+        GrowthRowCount c = { nullptr, nullptr, n, 0, 0, tMin, tMax, phiMin, phiMax, 0.0f };
+        if (count && std::is_same<S, float>::value) {
+            c.phi = floatRow(phi);
+            c.t = floatRow(t);
+            count(c);
+        } else {
+            countRow(phi, t, c);
+        }
+        tMin = c.tMin;
+        tMax = c.tMax;
+        phiMin = c.phiMin;
+        phiMax = c.phiMax;
+        finite = finite && c.residue == 0.0f;
+        if (!phi) return;
+
+        // 整行是液体时不必再找固相的范围
+        int solid = c.solid, band = c.band;
+        if (solid > 0) {
+            int first = 0, last = n - 1;
+            while ((float)FieldTraits<S>::load(phi[first]) <= 0.5f) first++;
+            while ((float)FieldTraits<S>::load(phi[last]) <= 0.5f) last--;
+            lo[0] = std::min(lo[0], x0 + first);
+            hi[0] = std::max(hi[0], x0 + last);
+            lo[1] = std::min(lo[1], j);
+            hi[1] = std::max(hi[1], j);
+            lo[2] = std::min(lo[2], k);
+            hi[2] = std::max(hi[2], k);
+        }
+        if (colWeight && (solid > 0 || band > 0)) {
+            solid = band = 0;
+            for (int i = 0; i < n; i++) {
+                float p = (float)FieldTraits<S>::load(phi[i]);
+                solid += (p > 0.5f) ? colWeight[i] : 0;
+                band += (p > 0.1f && p < 0.9f) ? colWeight[i] : 0;
+            }
+        }
+        solidCells += (long long)solid * weight;
+        interfaceCells += (long long)band * weight;
+    }
+
+    // 一行的计数和最值的标量实现。按 8 个独立的累加器分组，编译器可以把组内展开成向量比较和 min/max
+    template <class S>
+    static void countRow(const S* phi, const S* t, GrowthRowCount& c)
+    {
+        const int L = 8;
+        const int n = c.n;
+        float r8[L] = {};
+        if (phi) {
+            int s8[L] = {}, b8[L] = {};
+            float m0[L], m1[L];
+            for (int l = 0; l < L; l++) {
+                m0[l] = c.phiMin;
+                m1[l] = c.phiMax;
+            }
+            int i = 0;
+            for (; i + L <= n; i += L)
+                for (int l = 0; l < L; l++) {
+                    float p = (float)FieldTraits<S>::load(phi[i + l]);
+                    s8[l] += p > 0.5f;
+                    b8[l] += (p > 0.1f) & (p < 0.9f);
+                    m0[l] = p < m0[l] ? p : m0[l];
+                    m1[l] = p > m1[l] ? p : m1[l];
+                    r8[l] += p - p;
+                }
+            for (; i < n; i++) {
+                float p = (float)FieldTraits<S>::load(phi[i]);
+                s8[0] += p > 0.5f;
+                b8[0] += (p > 0.1f) & (p < 0.9f);
+                m0[0] = std::min(m0[0], p);
+                m1[0] = std::max(m1[0], p);
+                r8[0] += p - p;
+            }
+            for (int l = 0; l < L; l++) {
+                c.solid += s8[l];
+                c.band += b8[l];
+                c.phiMin = std::min(c.phiMin, m0[l]);
+                c.phiMax = std::max(c.phiMax, m1[l]);
+            }
+        }
+        if (t) {
+            float m0[L], m1[L];
+            for (int l = 0; l < L; l++) {
+                m0[l] = c.tMin;
+                m1[l] = c.tMax;
+            }
+            int i = 0;
+            for (; i + L <= n; i += L)
+                for (int l = 0; l < L; l++) {
+                    float v = (float)FieldTraits<S>::load(t[i + l]);
+                    m0[l] = v < m0[l] ? v : m0[l];
+                    m1[l] = v > m1[l] ? v : m1[l];
+                    r8[l] += v - v;
+                }
+            for (; i < n; i++) {
+                float v = (float)FieldTraits<S>::load(t[i]);
+                m0[0] = std::min(m0[0], v);
+                m1[0] = std::max(m1[0], v);
+                r8[0] += v - v;
+            }
+            for (int l = 0; l < L; l++) {
+                c.tMin = std::min(c.tMin, m0[l]);
+                c.tMax = std::max(c.tMax, m1[l]);
+            }
+        }
+        for (int l = 0; l < L; l++) c.residue += r8[l];
+    }
+
+private:
+    static const float* floatRow(const float* p) { return p; }
+    template <class S> static const float* floatRow(const S*) { return nullptr; }
+};
+
+// 自动停止条件，取 0 的条件不检查：
+//   tipFraction : 尖端到晶核（网格中心）的距离达到晶核到网格边界距离的这个比例。
+//                 周期边界时为 1 即晶体碰到自己在相邻周期中的像，之后的结果不再代表孤立的晶体
+//   endTime     : 物理时间
+//   steadyTolerance : 尖端速度进入稳态。尖端每前进一格记下时刻，最近两段各 steadyCells 格的平均速度
+//                 之差不超过后一段的这个比例时停止
+struct StopConditions
+{
+    float tipFraction = 0.0f;
+    double endTime = 0.0;
+    float steadyTolerance = 0.0f;
+    int steadyCells = 8;
+};
+
+enum class StopReason { None, TipReach, EndTime, SteadyTip, Diverged };
+
+inline const char* stopReasonName(StopReason reason)
+{
+    switch (reason) {
+    case StopReason::TipReach: return "tip reached box fraction";
+    case StopReason::EndTime: return "end time reached";
+    case StopReason::SteadyTip: return "steady tip speed";
+    case StopReason::Diverged: return "diverged after repeated rollbacks";
+    default: return "none";
+    }
+}
+
+// 每步结束时按 GrowthStats 检查停止条件，并记录尖端前进的历史
+class GrowthMonitor
+{
+public:
+    void setConditions(const StopConditions& conditions) { _conditions = conditions; }
+    const StopConditions& conditions() const { return _conditions; }
+    bool active() const { return _conditions.tipFraction > 0.0f || _conditions.endTime > 0.0 || _conditions.steadyTolerance > 0.0f; }
+
+    // 清空尖端历史，所有条件重新检查（重新初始化场时调用）
+    void reset()
+    {
+        _tipTimes.clear();
+        _tipStart = -1;
+        _fraction = 0.0f;
+        for (bool& f : _fired) f = false;
+    }
+
+    // 网格各方向有 count[a] 个格子，晶核在 count[a] / 2，spacing 是格子间距。
+    // 每个条件第一次满足时返回一次，之后不再返回，停下后继续推进不会立即再停
+    StopReason check(const GrowthStats& s, double time, const int* count, int dims, float spacing)
+    {
+        _spacing = spacing;
+        int reach = -1;
+        _fraction = 0.0f;
+        if (s.hasSolid()) {
+            for (int a = 0; a < dims; a++) {
+                int c = count[a] / 2;
+                int r = std::max(c - s.lo[a], s.hi[a] - c);
+                reach = std::max(reach, r);
+                _fraction = std::max(_fraction, (float)r / std::max(1, count[a] - c));
+            }
+        }
+        // 晶核本身的半径不是生长，从第一次检查时的尖端位置开始记录
+        if (_tipStart < 0) _tipStart = reach;
+        while (reach >= 0 && _tipStart + (int)_tipTimes.size() < reach) _tipTimes.push_back(time);
+
+        if (!_fired[0] && _conditions.tipFraction > 0.0f && _fraction >= _conditions.tipFraction) {
+            _fired[0] = true;
+            return StopReason::TipReach;
+        }
+        if (!_fired[1] && _conditions.endTime > 0.0 && time >= _conditions.endTime * (1.0 - 1e-6)) {
+            _fired[1] = true;
+            return StopReason::EndTime;
+        }
+        int w = std::max(1, _conditions.steadyCells);
+        if (!_fired[2] && _conditions.steadyTolerance > 0.0f && (int)_tipTimes.size() > 2 * w) {
+            double v1 = tipSpeed(), v0 = _speed((int)_tipTimes.size() - 1 - w);
+            if (v0 > 0.0 && v1 > 0.0 && std::fabs(v1 - v0) <= _conditions.steadyTolerance * v1) {
+                _fired[2] = true;
+                return StopReason::SteadyTip;
+            }
+        }
+        return StopReason::None;
+    }
+
+    // 最近一次检查时尖端到晶核的距离占晶核到边界距离的比例（各方向取最大）
+    float tipFraction() const { return _fraction; }
+    // 最近 steadyCells 格的平均尖端速度（长度/时间），记录不足时为 0
+    double tipSpeed() const { return _speed((int)_tipTimes.size() - 1); }
+
+private:
+    StopConditions _conditions;
+    std::vector<double> _tipTimes; // 尖端到达离晶核 _tipStart + r + 1 格的时刻
+    int _tipStart = -1;
+    float _fraction = 0.0f;
+    float _spacing = 1.0f;
+    bool _fired[3] = { false, false, false };
+
+    // 以第 last 次前进结束的一段 steadyCells 格内的平均速度
+    double _speed(int last) const
+    {
+        int w = std::max(1, _conditions.steadyCells);
+        if (last - w < 0) return 0.0;
+        double dt = _tipTimes[last] - _tipTimes[last - w];
+        return dt > 0.0 ? w * _spacing / dt : 0.0;
+    }
+};
+
+// ==========================================
+// 发散看门狗
+// ==========================================
+
+// 发散检查与回退（见 Kobayashi::setWatchdog()），interval 取 0 时关闭：
+//   interval   : 每隔多少步在内存中保存一次状态快照
+//   phiMin/phiMax、tLimit : 一步结束时 phi 超出 [phiMin, phiMax] 或 |t| 超过 tLimit 视为发散，NaN/Inf 总是发散。
+//                3D 检查的是限制到 [0, 1] 之前的新相场，限制使失稳的相场每步只越界一点，所以 phi 的默认范围
+//                只留出正常过冲（稳定的 dt 下约 0.05 以内）的余量
+//   maxRetries : 从同一个快照连续回退的次数上限，超过后停在快照处（StopReason::Diverged）
+struct WatchdogSettings
+{
+    int interval = 0;
+    float phiMin = -0.1f, phiMax = 1.1f;
+    float tLimit = 100.0f;
+    int maxRetries = 8;
+};
+
+// 一次回退：在 step 步（时间 time）检测到 reason，回到 restoredStep 步（时间 restoredTime），
+// 发散那一步的 dt 是 dt，之后的 dt 减半（Fixed 的 dt 和 Adaptive 的 cfl 都减半）。
+// 放弃时 restoredStep 仍是快照的步数，gaveUp 为 true，dt 不再减半
+struct RollbackEvent
+{
+    long long step;
+    double time;
+    long long restoredStep;
+    double restoredTime;
+    float dt;
+    const char* reason;
+    bool gaveUp;
+};
+
+// 按 w 检查一步结束时的统计量，正常时返回 nullptr，否则返回发散的原因
+inline const char* divergence(const GrowthStats& s, const WatchdogSettings& w)
+{
+    if (!s.finite) return "NaN/Inf";
+    if (s.phiMin < w.phiMin || s.phiMax > w.phiMax) return "phi out of range";
+    if (s.tMin < -w.tLimit || s.tMax > w.tLimit) return "t out of range";
+    return nullptr;
+}
@@ -0,0 +1,85 @@
+#include "Kobayashi.h"
+#include <GL/freeglut.h>
+
+// ==========================================
+// 图形渲染部分 (OpenGL)
+// ==========================================
+
+// 初始化 OpenGL 纹理设置
+void Kobayashi::glInit() {
+    glEnable(GL_TEXTURE_2D); // 开启 2D 纹理功能
+    glGenTextures(1, &_textureID); // 申请一个纹理 ID
+    glBindTexture(GL_TEXTURE_2D, _textureID); // 绑定这个 ID 为当前操作对象
+
+    // 设置纹理过滤方式 (Linear = 线性插值，图像放大时会模糊平滑，而不是马赛克)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    
+    // 设置纹理包裹方式 (Clamp = 边缘拉伸，防止纹理重复平铺)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+    // 立即上传一次纹理，确保初始画面不是黑的
+    _updateTexture();
+}
+
+// 释放显存中的纹理资源，需要在 OpenGL 上下文销毁前调用
+void Kobayashi::glRelease() {
+    if (_textureID) glDeleteTextures(1, &_textureID);
+    _textureID = 0;
+}
+
+// 将颜色数据 (_pixelBuffer) 上传到显卡
+void Kobayashi::_updateTexture()
+{
+    _fillPixelBuffer();
+
+    // --- 上传纹理到 GPU ---
+    glBindTexture(GL_TEXTURE_2D, _textureID);
+    // glTexImage2D 参数解释：
+    // GL_TEXTURE_2D: 目标类型
+    // 0: Mipmap 层级 (0是原图)
+    // GL_RGBA: 显卡内部存储格式
+    // width, height: 纹理尺寸
+    // 0: 边框 (必须是0)
+    // GL_RGBA: 我们提供的数据格式
+    // GL_UNSIGNED_BYTE: 我们提供的数据类型 (uchar)
+    // data: 数据指针
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _objectCount.x, _objectCount.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, _pixelBuffer.data());
+    _textureDirty = false;
+}
+
+// 实际的绘制函数，每帧调用一次
+void Kobayashi::glRender() {
+    // 1. 清除屏幕颜色
+    glClear(GL_COLOR_BUFFER_BIT);
+    
+    // 2. 绑定我们要使用的纹理
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, _textureID);
+    
+    // 设置绘制颜色为白色 (这样纹理会保持原色，不会被染色)
+    glColor3f(1.0f, 1.0f, 1.0f);
+
+    // 场数据变化后才重新生成并上传纹理
+    if (_textureDirty) _updateTexture();
+
+    // 3. 绘制一个四边形 (Quad)，充满整个视口
+    // OpenGL 的坐标系：中心是 (0,0)，左下是 (-1,-1)，右上是 (1,1)
+    // 纹理坐标 (TexCoord)：左下是 (0,0)，右上是 (1,1)
+    // 我们的任务是将纹理的四个角对应到四边形的四个角上
+    glBegin(GL_QUADS);
+        // 左下角
+        glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, -1.0f);
+        // 右下角
+        glTexCoord2f(1.0f, 0.0f); glVertex2f( 1.0f, -1.0f);
+        // 右上角
+        glTexCoord2f(1.0f, 1.0f); glVertex2f( 1.0f,  1.0f);
+        // 左上角
+        glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f,  1.0f);
+    glEnd();
+    
+    // 4. 交换缓冲区 (Double Buffering)
+    // 我们在一个隐藏的缓冲区画画，画好后瞬间交换到前台显示，防止闪烁
+    glutSwapBuffers(); 
+}
@@ -0,0 +1,266 @@
+#pragma once
+#include "KobayashiCommon.h"
+#include <cfloat>
+#include <cmath>
+
+// ==========================================
+// 显式 SIMD 行内核与运行时指令集分派
+// ==========================================
+
+// 热点内核按行写成与向量宽度无关的模板（SimdKernels.h），在这里对每个指令集各实例化一次：
+//   2D 融合扫描：一行梯度、代数各向异性和演化（见 Kobayashi::_fusedBlock()）
+//   3D：代数各向异性和通量项、H = 0 时的相场/温度求解（见 Kobayashi3D::_computeAnisotropyBlock()、_solveFieldsBlock()）
+//   生长诊断：刚写完的一行的计数和温度最值（见 GrowthStats::addRow()）
+// 每个实例放在 #pragma GCC target 区域内，不需要用 -mavx2 之类的选项编译整个程序，
+// detectSimd() 在运行时检查 CPU（和操作系统）支持的指令集，同一个可执行文件在每个节点上使用最好的实现。
+// 行尾不足一个向量的格子用同一模板的 1 路实例计算。
+// 各实例的运算顺序相同且不做 FMA 收缩，所以各指令集的结果逐位相同；
+// 与标量代码的差别只在 atan 用多项式近似（与 double 的 atan 相比最大误差约 3 ulp）。
+// 只在 x86 上用 GCC 编译时可用，其它编译器和平台 detectSimd() 返回 Scalar
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define KOBAYASHI_SIMD 1
+#include <immintrin.h>
+#else
+#define KOBAYASHI_SIMD 0
+#endif
+
+// 2D 一行梯度：gradX[c] = (phi[c+1] - phi[c-1]) / dx，gradY[c] = (phi[c+stride] - phi[c-stride]) / dy
+struct SimdGradientRow2D
+{
+    const float* phi; // 本行第一个格子
+    float *gradX, *gradY;
+    int n, stride;
+    float dx, dy;
+};
+
+// 2D 一行代数各向异性（见 algebraicAnisotropyRow()），anisotropy 为 4 或 6
+struct SimdAnisotropyRow2D
+{
+    const float *gradX, *gradY;
+    float *eps, *epsDeriv;
+    int n, anisotropy;
+    float epsilonBar, delta;
+};
+
+// 2D 融合扫描一行的演化：场指针指向本行第一个要更新的格子，上下行相差 stride；
+// 导数指针是三行滚动缓冲中同一列的位置（M、0、P 分别是 j-1、j、j+1 行）
+struct SimdEvolutionRow2D
+{
+    const float *phi, *t;
+    const float *epsM, *eps0, *epsP, *derM, *der0, *derP, *gxM, *gx0, *gxP, *gy0;
+    float *phiNext, *tNext;
+    int n, stride;
+    float dx, dy, dt, dtT, tau, alpha, gamma, tEq, K, latentK;
+    bool temperature; // false：相场子循环的后续小步，温度不变，潜热累加到 tNext
+};
+
+// 3D 一行代数各向异性和通量项：指针指向行首格子，y、z 方向的邻居相差 sy、sz
+struct SimdAnisotropyRow3D
+{
+    const float *phi, *omegaX, *omegaY, *omegaZ;
+    float *epsilon2, *fluxY, *fluxZ, *epsTauTheta;
+    int n, sy, sz;
+    float dx, dy, dz, c1, c2;
+};
+
+// 3D 一行相场/温度求解（H = 0，温度在同一网格上）
+struct SimdSolveRow3D
+{
+    const float *phi, *t, *epsilon2, *fluxY, *fluxZ, *epsTauTheta;
+    float *phiNext, *tNext;
+    int n, sy, sz;
+    int dsy, dsz; // 各向异性量的行、层步长（见 Kobayashi3D::DerivedLayout）
+    int points;   // 拉普拉斯算子的点数：7、19 或 27（见 Kobayashi3D::LaplacianStencil）
+    float dx, dy, dz, dt, alpha, gamma, tEq, K, alphaT, Meta;
+    float* excursion; // 非空时在 [0] [1] [2] 上累加限制到 [0, 1] 之前的新相场的最小值、最大值和 x − x 之和（见 GrowthRowCount）
+};
+
+// 一个指令集的全部行内核
+struct SimdKernels
+{
+    SimdLevel level;
+    void (*gradientRow2D)(const SimdGradientRow2D&);
+    void (*anisotropyRow2D)(const SimdAnisotropyRow2D&);
+    void (*evolutionRow2D)(const SimdEvolutionRow2D&);
+    void (*anisotropyRow3D)(const SimdAnisotropyRow3D&);
+    void (*solveRow3D)(const SimdSolveRow3D&);
+    GrowthRowFn growthRow; // 生长诊断一行的计数和温度最值
+};
+
+// float 存储时返回场的指针，其它存储类型返回 nullptr（行内核只处理 float）
+template <class T> inline float* simdData(T*) { return nullptr; }
+template <class T> inline const float* simdData(const T*) { return nullptr; }
+inline float* simdData(float* p) { return p; }
+inline const float* simdData(const float* p) { return p; }
+
+#if KOBAYASHI_SIMD
+
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+// 行尾用的 1 路"向量"，每个指令集的命名空间里各有一份（需要与宽向量在同一个 target 区域内实例化）
+#define KOBAYASHI_SIMD_SCALAR_LANE                                                                  \
+    struct V1                                                                                       \
+    {                                                                                               \
+        float v;                                                                                    \
+        enum { W = 1 };                                                                             \
+        static V1 set(float x) { V1 r = { x }; return r; }                                          \
+        static V1 load(const float* p) { V1 r = { *p }; return r; }                                 \
+        void store(float* p) const { *p = v; }                                                      \
+    };                                                                                              \
+    inline V1 operator+(V1 a, V1 b) { return V1::set(a.v + b.v); }                                  \
+    inline V1 operator-(V1 a, V1 b) { return V1::set(a.v - b.v); }                                  \
+    inline V1 operator*(V1 a, V1 b) { return V1::set(a.v * b.v); }                                  \
+    inline V1 operator/(V1 a, V1 b) { return V1::set(a.v / b.v); }                                  \
+    inline V1 operator-(V1 a) { return V1::set(-a.v); }                                             \
+    inline bool operator<(V1 a, V1 b) { return a.v < b.v; }                                         \
+    inline bool operator>(V1 a, V1 b) { return a.v > b.v; }                                         \
+    inline bool operator<=(V1 a, V1 b) { return a.v <= b.v; }                                       \
+    inline bool operator>=(V1 a, V1 b) { return a.v >= b.v; }                                       \
+    inline V1 select(bool m, V1 a, V1 b) { return m ? a : b; }                                      \
+    inline V1 sqrt(V1 a) { return V1::set(std::sqrt(a.v)); }                                        \
+    inline V1 vmin(V1 a, V1 b) { return a.v < b.v ? a : b; } /* 与 minps 相同：有 NaN 时取 b */      \
+    inline V1 vmax(V1 a, V1 b) { return a.v > b.v ? a : b; }                                        \
+    inline V1 vabs(V1 a) { return V1::set(std::fabs(a.v)); }
+
+// ---------- SSE4.1：4 路 ----------
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+namespace SimdSSE4
+{
+struct V
+{
+    __m128 v;
+    enum { W = 4 };
+    static V set(float x) { V r = { _mm_set1_ps(x) }; return r; }
+    static V load(const float* p) { V r = { _mm_loadu_ps(p) }; return r; }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+inline V make(__m128 x) { V r = { x }; return r; }
+inline V operator+(V a, V b) { return make(_mm_add_ps(a.v, b.v)); }
+inline V operator-(V a, V b) { return make(_mm_sub_ps(a.v, b.v)); }
+inline V operator*(V a, V b) { return make(_mm_mul_ps(a.v, b.v)); }
+inline V operator/(V a, V b) { return make(_mm_div_ps(a.v, b.v)); }
+inline V operator-(V a) { return make(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))); }
+inline __m128 operator<(V a, V b) { return _mm_cmplt_ps(a.v, b.v); }
+inline __m128 operator>(V a, V b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline __m128 operator<=(V a, V b) { return _mm_cmple_ps(a.v, b.v); }
+inline __m128 operator>=(V a, V b) { return _mm_cmpge_ps(a.v, b.v); }
+inline V select(__m128 m, V a, V b) { return make(_mm_blendv_ps(b.v, a.v, m)); }
+inline V sqrt(V a) { return make(_mm_sqrt_ps(a.v)); }
+inline V vmin(V a, V b) { return make(_mm_min_ps(a.v, b.v)); }
+inline V vmax(V a, V b) { return make(_mm_max_ps(a.v, b.v)); }
+inline V vabs(V a) { return make(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+KOBAYASHI_SIMD_SCALAR_LANE
+const SimdLevel level = SimdLevel::SSE4;
+#include "SimdKernels.h"
+}
+#pragma GCC pop_options
+
+// ---------- AVX2：8 路 ----------
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace SimdAVX2
+{
+struct V
+{
+    __m256 v;
+    enum { W = 8 };
+    static V set(float x) { V r = { _mm256_set1_ps(x) }; return r; }
+    static V load(const float* p) { V r = { _mm256_loadu_ps(p) }; return r; }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+inline V make(__m256 x) { V r = { x }; return r; }
+inline V operator+(V a, V b) { return make(_mm256_add_ps(a.v, b.v)); }
+inline V operator-(V a, V b) { return make(_mm256_sub_ps(a.v, b.v)); }
+inline V operator*(V a, V b) { return make(_mm256_mul_ps(a.v, b.v)); }
+inline V operator/(V a, V b) { return make(_mm256_div_ps(a.v, b.v)); }
+inline V operator-(V a) { return make(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))); }
+inline __m256 operator<(V a, V b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline __m256 operator>(V a, V b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline __m256 operator<=(V a, V b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline __m256 operator>=(V a, V b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline V select(__m256 m, V a, V b) { return make(_mm256_blendv_ps(b.v, a.v, m)); }
+inline V sqrt(V a) { return make(_mm256_sqrt_ps(a.v)); }
+inline V vmin(V a, V b) { return make(_mm256_min_ps(a.v, b.v)); }
+inline V vmax(V a, V b) { return make(_mm256_max_ps(a.v, b.v)); }
+inline V vabs(V a) { return make(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+KOBAYASHI_SIMD_SCALAR_LANE
+const SimdLevel level = SimdLevel::AVX2;
+#include "SimdKernels.h"
+}
+#pragma GCC pop_options
+
+// ---------- AVX-512F：16 路，比较结果是位掩码 ----------
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace SimdAVX512
+{
+struct V
+{
+    __m512 v;
+    enum { W = 16 };
+    static V set(float x) { V r = { _mm512_set1_ps(x) }; return r; }
+    static V load(const float* p) { V r = { _mm512_loadu_ps(p) }; return r; }
+    void store(float* p) const { _mm512_storeu_ps(p, v); }
+};
+inline V make(__m512 x) { V r = { x }; return r; }
+inline V operator+(V a, V b) { return make(_mm512_add_ps(a.v, b.v)); }
+inline V operator-(V a, V b) { return make(_mm512_sub_ps(a.v, b.v)); }
+inline V operator*(V a, V b) { return make(_mm512_mul_ps(a.v, b.v)); }
+inline V operator/(V a, V b) { return make(_mm512_div_ps(a.v, b.v)); }
+inline V operator-(V a) { return make(_mm512_sub_ps(_mm512_setzero_ps(), a.v)); }
+inline __mmask16 operator<(V a, V b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+inline __mmask16 operator>(V a, V b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+inline __mmask16 operator<=(V a, V b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ); }
+inline __mmask16 operator>=(V a, V b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ); }
+inline V select(__mmask16 m, V a, V b) { return make(_mm512_mask_blend_ps(m, b.v, a.v)); }
+// sqrt/min/max 用全掩码的 mask 版本：不带掩码的版本以 _mm512_undefined_ps() 为穿透值，GCC 12 在 -Wall 下报
+// '__Y' 未初始化；全掩码时两者生成同一条指令
+inline V sqrt(V a) { return make(_mm512_mask_sqrt_ps(a.v, 0xFFFF, a.v)); }
+inline V vmin(V a, V b) { return make(_mm512_mask_min_ps(a.v, 0xFFFF, a.v, b.v)); }
+inline V vmax(V a, V b) { return make(_mm512_mask_max_ps(a.v, 0xFFFF, a.v, b.v)); }
+inline V vabs(V a) { return make(_mm512_abs_ps(a.v)); }
+KOBAYASHI_SIMD_SCALAR_LANE
+const SimdLevel level = SimdLevel::AVX512;
+#include "SimdKernels.h"
+}
+#pragma GCC pop_options
+
+#undef KOBAYASHI_SIMD_SCALAR_LANE
+#pragma GCC pop_options
+
+#endif // KOBAYASHI_SIMD
+
+// CPU 支持的最高指令集（只检测一次）
+inline SimdLevel detectSimd()
+{
+#if KOBAYASHI_SIMD
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE4;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+// 请求的指令集降到 CPU 支持的级别后对应的内核；Scalar 时返回 nullptr（使用求解器中的标量代码）
+inline const SimdKernels* simdKernels(SimdLevel& level)
+{
+    if (level > detectSimd()) level = detectSimd();
+#if KOBAYASHI_SIMD
+    switch (level) {
+    case SimdLevel::SSE4: return &SimdSSE4::kernels;
+    case SimdLevel::AVX2: return &SimdAVX2::kernels;
+    case SimdLevel::AVX512: return &SimdAVX512::kernels;
+    default: break;
+    }
+#endif
+    return nullptr;
+}
@@ -0,0 +1,372 @@
+// 行内核模板，由 Simd.h 在每个指令集的命名空间里各包含一次（没有 include guard）
+// 包含前需要定义：向量类型 V（W 路）、行尾用的 1 路类型 V1、它们的算术运算和比较，
+// 以及 select(m, a, b)、sqrt、vmin、vmax（有 NaN 时取第二个参数）、vabs 和 level
+// 每个 *At<T>() 计算从下标 i 开始的 T::W 个格子，运算顺序与求解器中的标量代码逐项相同
+
+// atan 的多项式近似（Cephes atanf 的区间缩减）：|x| > tan(3π/8) 时用 π/2 + atan(-1/|x|)，
+// |x| > tan(π/8) 时用 π/4 + atan((|x|-1)/(|x|+1))，缩减后的参数都在 [-tan(π/8), tan(π/8)] 内
+template <class T> inline T atanV(T x)
+{
+    const T one = T::set(1.0f), zero = T::set(0.0f);
+    T ax = vabs(x);
+    auto big = ax > T::set(2.414213562f);
+    auto mid = ax > T::set(0.414213562f);
+    T num = select(big, -one, select(mid, ax - one, ax));
+    T den = select(big, ax, select(mid, ax + one, one));
+    T base = select(big, T::set(0.5f * PI_F), select(mid, T::set(0.25f * PI_F), zero));
+    T r = num / den;
+    T z = r * r;
+    T poly = ((T::set(8.05374449538e-2f) * z - T::set(1.38776856032e-1f)) * z + T::set(1.99777106478e-1f)) * z
+           - T::set(3.33329491539e-1f);
+    T y = base + (poly * z * r + r);
+    return select(x < zero, -y, y);
+}
+
+// ---------- 2D ----------
+
+// 见 Kobayashi::_deriveRow()
+template <class T> inline void gradient2DAt(const SimdGradientRow2D& a, int i)
+{
+    const float* p = a.phi + i;
+    ((T::load(p + 1) - T::load(p - 1)) / T::set(a.dx)).store(a.gradX + i);
+    ((T::load(p + a.stride) - T::load(p - a.stride)) / T::set(a.dy)).store(a.gradY + i);
+}
+
+// 见 Kobayashi.cpp 的 algebraicAnisotropyRow() 和 angularHarmonic()
+template <class T, int N> inline void anisotropy2DAt(const SimdAnisotropyRow2D& a, int i)
+{
+    const T one = T::set(1.0f), tiny = T::set(FLT_EPSILON * FLT_EPSILON);
+    T gx = T::load(a.gradX + i), gy = T::load(a.gradY + i);
+    T r2 = gx * gx + gy * gy;
+    auto nonFlat = r2 > tiny;
+    T inv = one / sqrt(select(nonFlat, r2, one));
+    T c = select(nonFlat, gx * inv, one);
+    T s = select(nonFlat, gy * inv, T::set(0.0f));
+
+    T c2 = c * c, s2 = s * s, cosN, sinN;
+    if (N == 4) {
+        cosN = c2 * c2 - T::set(6.0f) * c2 * s2 + s2 * s2;
+        sinN = T::set(4.0f) * c * s * (c2 - s2);
+    } else {
+        cosN = c2 * c2 * c2 - T::set(15.0f) * c2 * c2 * s2 + T::set(15.0f) * c2 * s2 * s2 - s2 * s2 * s2;
+        sinN = c * s * (T::set(6.0f) * c2 * c2 - T::set(20.0f) * c2 * s2 + T::set(6.0f) * s2 * s2);
+    }
+    (T::set(a.epsilonBar) * (one + T::set(a.delta) * cosN)).store(a.eps + i);
+    (T::set(-a.epsilonBar) * T::set((float)N) * T::set(a.delta) * sinN).store(a.epsDeriv + i);
+}
+
+// 见 Kobayashi::_fusedBlock()
+template <class T> inline void evolution2DAt(const SimdEvolutionRow2D& a, int i)
+{
+    const int s = a.stride;
+    const T two = T::set(2.0f), twelve = T::set(12.0f), one = T::set(1.0f);
+    const T lapScale = T::set(3.0f * a.dx * a.dx);
+    auto laplacian = [&](const float* f) {
+        return (two * (T::load(f + 1) + T::load(f - 1) + T::load(f + s) + T::load(f - s))
+            + T::load(f + s + 1) + T::load(f - s - 1) + T::load(f + s - 1) + T::load(f - s + 1)
+            - twelve * T::load(f)) / lapScale;
+    };
+    const float* p = a.phi + i;
+    const float* t = a.t + i;
+    T lapPhi = laplacian(p);
+
+    T e0 = T::load(a.eps0 + i), e0P = T::load(a.eps0 + i + 1), e0M = T::load(a.eps0 + i - 1);
+    T eP = T::load(a.epsP + i), eM = T::load(a.epsM + i);
+    T dx = T::set(a.dx), dy = T::set(a.dy);
+    T gradEpsPowX = (e0P * e0P - e0M * e0M) / dx;
+    T gradEpsPowY = (eP * eP - eM * eM) / dy;
+
+    T term1 = (eP * T::load(a.derP + i) * T::load(a.gxP + i) - eM * T::load(a.derM + i) * T::load(a.gxM + i)) / dy;
+    T term2 = -(e0P * T::load(a.der0 + i + 1) * T::load(a.gy0 + i + 1) - e0M * T::load(a.der0 + i - 1) * T::load(a.gy0 + i - 1)) / dx;
+    T term3 = gradEpsPowX * T::load(a.gx0 + i) + gradEpsPowY * T::load(a.gy0 + i);
+
+    T oldPhi = T::load(p);
+    T oldT = T::load(t);
+    T m = T::set(a.alpha / PI_F) * atanV(T::set(a.gamma) * (T::set(a.tEq) - oldT));
+
+    T newPhi = oldPhi +
+        (term1 + term2 + e0 * e0 * lapPhi + term3
+            + oldPhi * (one - oldPhi) * (oldPhi - T::set(0.5f) + m)) * T::set(a.dt) / T::set(a.tau);
+    newPhi.store(a.phiNext + i);
+    if (a.temperature) (oldT + laplacian(t) * T::set(a.dtT) + T::set(a.latentK) * (newPhi - oldPhi)).store(a.tNext + i);
+    else (T::load(a.tNext + i) + T::set(a.K) * (newPhi - oldPhi)).store(a.tNext + i);
+}
+
+// ---------- 3D ----------
+
+// 见 Kobayashi3D.cpp 的 algebraicCubicAnisotropy()
+template <class T>
+inline void cubicAnisotropyV(T gradPhiX, T gradPhiY, T gradPhiZ, T omega_p_x, T omega_p_y, T omega_p_z,
+                             T c1, T c2, T& eps, T& eps_theta, T& eps_phi)
+{
+    const T tiny = T::set(FLT_EPSILON * FLT_EPSILON), one = T::set(1.0f), zero = T::set(0.0f);
+
+    T vx = -gradPhiX, vy = -gradPhiY, vz = -gradPhiZ;
+    auto flat = vx * vx + vy * vy + vz * vz <= tiny;
+
+    T kx = omega_p_y, ky = -omega_p_x;
+    T s2 = kx * kx + ky * ky;
+    auto rotate = s2 > tiny;
+    T w = select(omega_p_z >= zero, one / (one + omega_p_z), (one - omega_p_z) / select(rotate, s2, one));
+    w = select(rotate, w, zero);
+
+    T Kv_x = ky * vz;
+    T Kv_y = -kx * vz;
+    T Kv_z = -ky * vx + kx * vy;
+    T kv = kx * vx + ky * vy;
+
+    T X = vx + Kv_x + (kv * kx - s2 * vx) * w;
+    T Y = vy + Kv_y + (kv * ky - s2 * vy) * w;
+    T Z = vz + Kv_z + (-s2 * vz) * w;
+    X = select(flat, one, X);
+    Y = select(flat, zero, Y);
+    Z = select(flat, zero, Z);
+
+    T X2 = X * X, Y2 = Y * Y, Z2 = Z * Z;
+    T P = X2 + Y2;
+    T G2 = P + Z2;
+    T invG4 = one / (G2 * G2);
+    auto tilted = P > tiny * G2;
+    T invSqrtP = select(tilted, one / sqrt(select(tilted, P, one)), zero);
+    T XY4 = X2 * X2 + Y2 * Y2;
+
+    const T four = T::set(4.0f);
+    eps = c1 + c2 * (XY4 + Z2 * Z2) * invG4;
+    eps_theta = four * c2 * Z * (XY4 - Z2 * P) * invG4 * invSqrtP;
+    eps_phi = four * c2 * X * Y * (Y2 - X2) * invG4;
+}
+
+// 见 Kobayashi3D::_computeAnisotropyBlock()
+template <class T> inline void anisotropy3DAt(const SimdAnisotropyRow3D& a, int i)
+{
+    const float* p = a.phi + i;
+    T gradPhiX = (T::load(p + 1) - T::load(p - 1)) / T::set(2.0f * a.dx);
+    T gradPhiY = (T::load(p + a.sy) - T::load(p - a.sy)) / T::set(2.0f * a.dy);
+    T gradPhiZ = (T::load(p + a.sz) - T::load(p - a.sz)) / T::set(2.0f * a.dz);
+    T gradPhiMag = sqrt(gradPhiX * gradPhiX + gradPhiY * gradPhiY + gradPhiZ * gradPhiZ);
+    T tau = sqrt(gradPhiX * gradPhiX + gradPhiY * gradPhiY);
+
+    T eps, eps_theta, eps_phi;
+    cubicAnisotropyV(gradPhiX, gradPhiY, gradPhiZ,
+                     T::load(a.omegaX + i), T::load(a.omegaY + i), T::load(a.omegaZ + i), T::set(a.c1), T::set(a.c2),
+                     eps, eps_theta, eps_phi);
+
+    T tau_safe = vmax(tau, T::set(FLT_EPSILON));
+    T gradPhiMag2 = gradPhiMag * gradPhiMag;
+
+    (eps * eps).store(a.epsilon2 + i);
+    ((eps / tau_safe) * eps_theta * gradPhiX
+        - (eps / (tau_safe * tau_safe)) * eps_phi * gradPhiMag2 * gradPhiY).store(a.fluxZ + i);
+    ((eps / tau_safe) * eps_theta * gradPhiZ
+        + (eps / (tau_safe * tau_safe)) * eps_phi * gradPhiMag2 * gradPhiX).store(a.fluxY + i);
+    (eps * eps_theta * tau).store(a.epsTauTheta + i);
+}
+
+// 见 Kobayashi3D::_solveFieldsBlock()（Orientation、CoarseT 为 false），Points 是拉普拉斯算子的点数（见 stencilLaplacian()）
+// Track 时 lo、hi、residue 累加限制之前的新相场（见 SimdSolveRow3D::excursion）
+template <class T, int Points, bool Track> inline void solve3DAt(const SimdSolveRow3D& a, int i, T& lo, T& hi, T& residue)
+{
+    const int sy = a.sy, sz = a.sz;
+    const T six = T::set(6.0f), one = T::set(1.0f);
+    const T dx2 = T::set(2.0f * a.dx), dy2 = T::set(2.0f * a.dy), dz2 = T::set(2.0f * a.dz);
+    const float h2 = a.dx * a.dx;
+    auto laplacian = [&](const float* f, T center) {
+        auto at = [f](int o) { return T::load(f + o); };
+        T faces = at(1) + at(-1)
+                + at(sy) + at(-sy)
+                + at(sz) + at(-sz);
+        if (Points == 7) return (faces - six * center) / T::set(h2);
+        T edges = at(1 + sy) + at(-1 + sy) + at(1 - sy) + at(-1 - sy)
+                + at(1 + sz) + at(-1 + sz) + at(1 - sz) + at(-1 - sz)
+                + at(sy + sz) + at(-sy + sz) + at(sy - sz) + at(-sy - sz);
+        if (Points == 19) return (T::set(2.0f) * faces + edges - T::set(24.0f) * center) / T::set(6.0f * h2);
+        T corners = at(1 + sy + sz) + at(-1 + sy + sz) + at(1 - sy + sz) + at(-1 - sy + sz)
+                  + at(1 + sy - sz) + at(-1 + sy - sz) + at(1 - sy - sz) + at(-1 - sy - sz);
+        return (T::set(14.0f) * faces + T::set(3.0f) * edges + corners - T::set(128.0f) * center) / T::set(30.0f * h2);
+    };
+    auto centralDiff = [&](const float* f, int s, T h2) { return (T::load(f + s) - T::load(f - s)) / h2; };
+
+    const float* p = a.phi + i;
+    T oldPhi = T::load(p);
+    T oldT = T::load(a.t + i);
+
+    T gradPhiX = centralDiff(p, 1, dx2);
+    T gradPhiY = centralDiff(p, sy, dy2);
+    T gradPhiZ = centralDiff(p, sz, dz2);
+    T lapPhi = laplacian(p, oldPhi);
+    T lapT = laplacian(a.t + i, oldT);
+
+    T m = T::set(a.alpha / PI_F) * atanV(T::set(a.gamma) * (T::set(a.tEq) - oldT));
+
+    const int dsy = a.dsy, dsz = a.dsz;
+    const float* e2 = a.epsilon2 + i;
+    T term_diffusion = T::load(e2) * lapPhi;
+    T term_grad_eps2 = centralDiff(e2, 1, dx2) * gradPhiX
+                     + centralDiff(e2, dsy, dy2) * gradPhiY
+                     + centralDiff(e2, dsz, dz2) * gradPhiZ;
+    T term_z = centralDiff(a.fluxZ + i, dsz, dz2);
+    T term_y = centralDiff(a.fluxY + i, dsy, dy2);
+    T term_eps_tau = -(T::load(a.epsTauTheta + i + dsz) - T::load(a.epsTauTheta + i - dsz)) / dz2;
+
+    T g_prime = oldPhi * (oldPhi - one) * (oldPhi - T::set(0.5f));
+    T p_prime = six * oldPhi * (one - oldPhi);
+    T f_diff = -m / six;
+
+    T dPhiDt = T::set(a.Meta) * (term_diffusion + term_grad_eps2 + term_z + term_y + term_eps_tau
+                               - g_prime - p_prime * f_diff);
+
+    // a² = 1 时乘法是精确的，与标量代码省掉乘法的结果相同
+    T dt = T::set(a.dt);
+    (oldT + (T::set(a.alphaT) * lapT + T::set(a.K) * dPhiDt) * dt).store(a.tNext + i);
+    T newPhi = oldPhi + dPhiDt * dt;
+    if (Track) {
+        lo = vmin(newPhi, lo);
+        hi = vmax(newPhi, hi);
+        residue = residue + (newPhi - newPhi);
+    }
+    vmax(vmin(newPhi, one), T::set(0.0f)).store(a.phiNext + i);
+}
+
+// ---------- 行驱动：整向量部分用 V，行尾用 V1 ----------
+// 参数先复制到局部变量：输出指针与参数结构体中的 float 不会别名，常量可以提到循环外
+
+inline void gradientRow2D(const SimdGradientRow2D& args)
+{
+    const SimdGradientRow2D a = args;
+    int i = 0;
+    for (; i + V::W <= a.n; i += V::W) gradient2DAt<V>(a, i);
+    for (; i < a.n; i++) gradient2DAt<V1>(a, i);
+}
+
+template <int N> inline void anisotropyRow2DN(const SimdAnisotropyRow2D& a)
+{
+    int i = 0;
+    for (; i + V::W <= a.n; i += V::W) anisotropy2DAt<V, N>(a, i);
+    for (; i < a.n; i++) anisotropy2DAt<V1, N>(a, i);
+}
+
+inline void anisotropyRow2D(const SimdAnisotropyRow2D& args)
+{
+    const SimdAnisotropyRow2D a = args;
+    if (a.anisotropy == 4) anisotropyRow2DN<4>(a);
+    else anisotropyRow2DN<6>(a);
+}
+
+inline void evolutionRow2D(const SimdEvolutionRow2D& args)
+{
+    const SimdEvolutionRow2D a = args;
+    int i = 0;
+    for (; i + V::W <= a.n; i += V::W) evolution2DAt<V>(a, i);
+    for (; i < a.n; i++) evolution2DAt<V1>(a, i);
+}
+
+inline void anisotropyRow3D(const SimdAnisotropyRow3D& args)
+{
+    const SimdAnisotropyRow3D a = args;
+    int i = 0;
+    for (; i + V::W <= a.n; i += V::W) anisotropy3DAt<V>(a, i);
+    for (; i < a.n; i++) anisotropy3DAt<V1>(a, i);
+}
+
+template <int Points, bool Track> inline void solveRow3DN(const SimdSolveRow3D& a)
+{
+    V lo = V::set(FLT_MAX), hi = V::set(-FLT_MAX), residue = V::set(0.0f);
+    V1 lo1 = V1::set(FLT_MAX), hi1 = V1::set(-FLT_MAX), residue1 = V1::set(0.0f);
+    int i = 0;
+    for (; i + V::W <= a.n; i += V::W) solve3DAt<V, Points, Track>(a, i, lo, hi, residue);
+    for (; i < a.n; i++) solve3DAt<V1, Points, Track>(a, i, lo1, hi1, residue1);
+    if (!Track) return;
+    float lanes[3][V::W];
+    lo.store(lanes[0]);
+    hi.store(lanes[1]);
+    residue.store(lanes[2]);
+    float* e = a.excursion;
+    for (int l = 0; l < V::W; l++) {
+        e[0] = std::min(e[0], lanes[0][l]);
+        e[1] = std::max(e[1], lanes[1][l]);
+        e[2] += lanes[2][l];
+    }
+    e[0] = std::min(e[0], lo1.v);
+    e[1] = std::max(e[1], hi1.v);
+    e[2] += residue1.v;
+}
+
+template <bool Track> inline void solveRow3DT(const SimdSolveRow3D& a)
+{
+    if (a.points == 27) solveRow3DN<27, Track>(a);
+    else if (a.points == 19) solveRow3DN<19, Track>(a);
+    else solveRow3DN<7, Track>(a);
+}
+
+inline void solveRow3D(const SimdSolveRow3D& args)
+{
+    const SimdSolveRow3D a = args;
+    if (a.excursion) solveRow3DT<true>(a);
+    else solveRow3DT<false>(a);
+}
+
+// 生长诊断一行的计数和最值（见 GrowthStats::addRow()）。计数在每一路上按 float 累加，
+// 每路不超过 2^24 格时是精确的；最值与标量代码相同（没有 NaN 时与顺序无关），NaN/Inf 由 residue 发现
+inline void growthRow(GrowthRowCount& c)
+{
+    const V one = V::set(1.0f), zero = V::set(0.0f);
+    const int n = c.n;
+    float lanes[4][V::W];
+    V residue = zero;
+    if (c.phi) {
+        const V half = V::set(0.5f), lo = V::set(0.1f), hi = V::set(0.9f);
+        V solid = zero, band = zero, pMin = V::set(c.phiMin), pMax = V::set(c.phiMax);
+        int i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            V p = V::load(c.phi + i);
+            solid = solid + select(p > half, one, zero);
+            band = band + select(p > lo, select(p < hi, one, zero), zero);
+            pMin = vmin(p, pMin);
+            pMax = vmax(p, pMax);
+            residue = residue + (p - p);
+        }
+        solid.store(lanes[0]);
+        band.store(lanes[1]);
+        pMin.store(lanes[2]);
+        pMax.store(lanes[3]);
+        for (int l = 0; l < V::W; l++) {
+            c.solid += (int)lanes[0][l];
+            c.band += (int)lanes[1][l];
+            c.phiMin = std::min(c.phiMin, lanes[2][l]);
+            c.phiMax = std::max(c.phiMax, lanes[3][l]);
+        }
+        for (; i < n; i++) {
+            float p = c.phi[i];
+            c.solid += p > 0.5f;
+            c.band += (p > 0.1f) & (p < 0.9f);
+            c.phiMin = std::min(c.phiMin, p);
+            c.phiMax = std::max(c.phiMax, p);
+            c.residue += p - p;
+        }
+    }
+    if (c.t) {
+        V tMin = V::set(c.tMin), tMax = V::set(c.tMax);
+        int i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            V v = V::load(c.t + i);
+            tMin = vmin(v, tMin);
+            tMax = vmax(v, tMax);
+            residue = residue + (v - v);
+        }
+        tMin.store(lanes[0]);
+        tMax.store(lanes[1]);
+        for (int l = 0; l < V::W; l++) {
+            c.tMin = std::min(c.tMin, lanes[0][l]);
+            c.tMax = std::max(c.tMax, lanes[1][l]);
+        }
+        for (; i < n; i++) {
+            c.tMin = std::min(c.tMin, c.t[i]);
+            c.tMax = std::max(c.tMax, c.t[i]);
+            c.residue += c.t[i] - c.t[i];
+        }
+    }
+    residue.store(lanes[0]);
+    for (int l = 0; l < V::W; l++) c.residue += lanes[0][l];
+}
+
+const SimdKernels kernels = { level, gradientRow2D, anisotropyRow2D, evolutionRow2D, anisotropyRow3D, solveRow3D, growthRow };
@@ -0,0 +1,173 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// ==========================================
+// 常驻线程池（带工作窃取）
+// ==========================================
+
+// 工作线程在构造时创建，之后一直等待任务，避免每个时间步都创建/销毁线程
+// parallelFor() 返回时所有线程都已完成全部任务，相当于一次屏障
+//
+// 负载均衡：[begin, end) 被切成若干块，每个线程先拿到一段连续的块（保持数据局部性），
+// 从自己队列的前端取块；自己的块做完后，从其它线程队列的后端"窃取"块。
+// 这样当某些区域（例如含有界面的 z 层）比纯液体区域慢时，空闲线程会自动分担。
+class ThreadPool
+{
+public:
+    // threads <= 0 表示使用全部硬件线程
+    explicit ThreadPool(int threads = 0)
+    {
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+        _threadCount = threads;
+        _queues.reset(new Queue[threads]);
+
+        // 调用线程自己也参与计算，所以只需要 threads - 1 个工作线程
+        for (int w = 1; w < threads; w++) {
+            _workers.emplace_back([this, w] { _workerLoop(w); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _quit = true;
+        }
+        _wake.notify_all();
+        for (auto& t : _workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return _threadCount; }
+
+    // 并行执行 fn(chunkBegin, chunkEnd)，块大小为 grain（grain <= 0 时自动选择）
+    // 每个下标只属于一个块，所以只要 fn 对每个下标的计算与其它下标无关，
+    // 结果就与线程数以及哪个线程执行了哪个块无关
+    void parallelFor(int begin, int end, const std::function<void(int, int)>& fn, int grain = 0)
+    {
+        if (end <= begin) return;
+        int n = end - begin;
+        if (grain <= 0) grain = std::max(1, n / (_threadCount * 4));
+        int chunks = (n + grain - 1) / grain;
+
+        if (_threadCount == 1 || chunks == 1) {
+            fn(begin, end);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &fn;
+            _begin = begin;
+            _end = end;
+            _grain = grain;
+
+            // 按线程均分块，前面的线程多分一个
+            int base = chunks / _threadCount, rem = chunks % _threadCount;
+            int c = 0;
+            for (int w = 0; w < _threadCount; w++) {
+                int count = base + (w < rem ? 1 : 0);
+                _queues[w].range.store(_pack(c, c + count));
+                c += count;
+            }
+
+            _pending = _threadCount - 1;
+            _generation++;
+        }
+        _wake.notify_all();
+
+        _runQueues(0); // 调用线程作为第 0 号线程参与计算
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _pending == 0; });
+        _task = nullptr;
+    }
+
+private:
+    // 每个线程的块队列：[front, back) 打包在一个 64 位原子量里，
+    // 拥有者从前端取，窃取者从后端取，两者都用 CAS 修改同一个字，不会取到同一块
+    struct Queue
+    {
+        std::atomic<uint64_t> range{ 0 };
+        char pad[64 - sizeof(std::atomic<uint64_t>)]; // 避免不同线程的队列共享缓存行
+    };
+
+    int _threadCount = 1;
+    std::vector<std::thread> _workers;
+    std::unique_ptr<Queue[]> _queues;
+
+    std::mutex _mutex;
+    std::condition_variable _wake, _done;
+    const std::function<void(int, int)>* _task = nullptr;
+    int _begin = 0, _end = 0, _grain = 1;
+    int _pending = 0;
+    unsigned long long _generation = 0;
+    bool _quit = false;
+
+    static uint64_t _pack(int front, int back) { return ((uint64_t)(uint32_t)front << 32) | (uint32_t)back; }
+    static int _front(uint64_t r) { return (int)(r >> 32); }
+    static int _back(uint64_t r) { return (int)(uint32_t)r; }
+
+    // 从队列 q 取一块；fromFront 为 true 时取前端（拥有者），否则取后端（窃取者）
+    bool _take(Queue& q, bool fromFront, int& chunk)
+    {
+        uint64_t r = q.range.load();
+        for (;;) {
+            int f = _front(r), b = _back(r);
+            if (f >= b) return false;
+            uint64_t next = fromFront ? _pack(f + 1, b) : _pack(f, b - 1);
+            if (q.range.compare_exchange_weak(r, next)) {
+                chunk = fromFront ? f : b - 1;
+                return true;
+            }
+        }
+    }
+
+    void _runChunk(int chunk)
+    {
+        int b = _begin + chunk * _grain;
+        int e = std::min(_end, b + _grain);
+        (*_task)(b, e);
+    }
+
+    void _runQueues(int w)
+    {
+        int chunk;
+        while (_take(_queues[w], true, chunk)) _runChunk(chunk);
+
+        // 自己的块做完了，依次从其它线程窃取
+        for (int v = 1; v < _threadCount; v++) {
+            Queue& victim = _queues[(w + v) % _threadCount];
+            while (_take(victim, false, chunk)) _runChunk(chunk);
+        }
+    }
+
+    void _workerLoop(int w)
+    {
+        unsigned long long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [&] { return _quit || _generation != seen; });
+                if (_quit) return;
+                seen = _generation;
+            }
+
+            _runQueues(w);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_pending == 0) _done.notify_one();
+        }
+    }
+};
@@ -0,0 +1,172 @@
+#include "Kobayashi.h"
+#include "BatchConfig.h"
+#include <chrono>
+#include <algorithm>
+#include <climits>
+
+// 无窗口批处理程序（2D）：不创建窗口，不调用任何 OpenGL 函数
+// 用法示例：
+//   batch --nx 1024 --ny 1024 --dt 0.0001 --steps 2000 --K 1.8
+//   batch --config run.cfg --steps 5000
+//   batch --timestep adaptive --time 0.2 --report 100
+//   batch --precision half --steps 2000
+//   batch --simd scalar
+//   batch --nx 4096 --ny 4096 --steps 100 --timeBlock 4
+//   batch --steps 100000 --report 500 --stopTip 0.9
+//   batch --dt 0.0004 --steps 5000 --watchdog 200
+int main(int argc, char** argv) {
+    BatchConfig cfg;
+    if (!cfg.parse(argc, argv)) return 1;
+
+    // 1. 网格和时间参数（默认值与 main.cpp 相同）
+    int nx = cfg.getInt("nx", 250);
+    int ny = cfg.getInt("ny", 250);
+    float dt = cfg.getFloat("dt", 0.0001f);
+    int steps = cfg.getInt("steps", 1000);
+    double endTime = cfg.getFloat("time", 0.0f); // 大于 0 时推进到这个物理时间，代替 steps
+    int report = cfg.getInt("report", 0); // 每隔多少步打印一次进度，0 表示不打印
+    std::string dump = cfg.getString("dump", "");
+    int threads = cfg.getInt("threads", 0);             // 0 表示使用全部核心
+    std::string mode = cfg.getString("mode", "inplace"); // inplace 或 jacobi
+    std::string kernel = cfg.getString("kernel", "fused"); // fused、twopass（参考实现）、narrowband（只算活跃块）或 spectral（周期边界的半隐式格式）
+    std::string aniso = cfg.getString("aniso", "algebraic"); // algebraic 或 trig
+    std::string boundary = cfg.getString("boundary", "periodic"); // periodic、neumann 或 dirichlet
+    std::string timestep = cfg.getString("timestep", "fixed"); // fixed、adaptive 或 subcycled
+    int thermalRatio = cfg.getInt("thermalRatio", 1); // 温度场粗网格每个方向粗多少倍，1 表示与相场同一网格
+    int thermalPad = cfg.getInt("thermalPad", 0);     // 非周期边界时温度场粗网格在相场网格外每侧多出的粗格数
+    std::string precision = cfg.getString("precision", "single"); // 状态场的存储精度：single、half、bfloat16 或 double
+    std::string simd = cfg.getString("simd", "auto"); // 行内核的指令集：auto（CPU 支持的最高级别）、avx512、avx2、sse4 或 scalar
+    int timeBlock = cfg.getInt("timeBlock", 1); // 时间分块的步数，1 表示逐步推进
+    int diagnostics = cfg.getInt("diagnostics", 0); // 1 表示每步统计生长诊断，在进度和结束时打印
+    StopConditions stop; // 自动停止条件，0 表示不检查；time 已经给出推进的物理时间，不再重复
+    stop.tipFraction = cfg.getFloat("stopTip", 0.0f);           // 尖端到晶核的距离达到晶核到边界距离的这个比例
+    stop.steadyTolerance = cfg.getFloat("stopSteady", 0.0f);    // 尖端速度的相对变化不超过它
+    stop.steadyCells = cfg.getInt("steadyCells", stop.steadyCells); // 比较尖端速度的每段格数
+    WatchdogSettings watchdog; // 发散看门狗
+    watchdog.interval = cfg.getInt("watchdog", 0);                            // 快照间隔步数，0 表示关闭
+    watchdog.phiMin = cfg.getFloat("watchPhiMin", watchdog.phiMin);           // phi 的允许范围
+    watchdog.phiMax = cfg.getFloat("watchPhiMax", watchdog.phiMax);
+    watchdog.tLimit = cfg.getFloat("watchT", watchdog.tLimit);                // |t| 的上限
+    watchdog.maxRetries = cfg.getInt("watchRetries", watchdog.maxRetries);    // 从同一快照连续回退的次数上限
+
+    if (nx < 3 || ny < 3 || steps < 0) {
+        std::cerr << "Invalid grid size or step count" << std::endl;
+        return 1;
+    }
+
+    // 2. 初始化模拟器，其余参数交给 setParam()
+    Kobayashi sim(nx, ny, dt);
+    if (!cfg.applyParams(sim)) return 1;
+
+    sim.setThreadCount(threads);
+    Boundary bc;
+    if (!parseBoundary(boundary, bc)) return 1;
+    sim.setBoundary(bc);
+    TimeStepping stepping;
+    if (!parseTimeStepping(timestep, stepping)) return 1;
+    sim.setTimeStepping(stepping);
+    if (mode == "jacobi") sim.setUpdateMode(Kobayashi::UpdateMode::Jacobi);
+    else if (mode != "inplace") {
+        std::cerr << "Unknown update mode: " << mode << std::endl;
+        return 1;
+    }
+    if (aniso == "trig") sim.setAnisotropyMode(Kobayashi::AnisotropyMode::Trig);
+    else if (aniso != "algebraic") {
+        std::cerr << "Unknown anisotropy mode: " << aniso << std::endl;
+        return 1;
+    }
+    if (kernel == "twopass") sim.setKernel(Kobayashi::Kernel::TwoPass);
+    else if (kernel == "narrowband") sim.setKernel(Kobayashi::Kernel::NarrowBand);
+    else if (kernel == "spectral") sim.setKernel(Kobayashi::Kernel::Spectral);
+    else if (kernel != "fused") {
+        std::cerr << "Unknown kernel: " << kernel << std::endl;
+        return 1;
+    }
+    if (thermalRatio > 1) sim.setThermalGrid(thermalRatio, thermalPad); // 在 setBoundary() 之后
+    Precision storePrecision;
+    if (!parsePrecision(precision, storePrecision)) return 1;
+    sim.setPrecision(storePrecision);
+    SimdLevel simdLevel;
+    if (!parseSimd(simd, simdLevel)) return 1;
+    sim.setSimd(simdLevel);
+    sim.setTemporalBlocking(timeBlock);
+    sim.setDiagnostics(diagnostics != 0);
+    sim.setStopConditions(stop);
+    sim.setWatchdog(watchdog);
+
+    std::cout << "Grid " << nx << "x" << ny << ", dt " << dt << ", ";
+    if (endTime > 0.0) std::cout << "time " << endTime << ", ";
+    else std::cout << steps << " steps, ";
+    std::cout << sim.threadCount() << " threads, " << mode << ", " << kernel << ", " << aniso << ", " << boundary << ", " << timestep << ", " << precision << ", " << simdName(sim.simd()) << std::endl;
+    if (stepping != TimeStepping::Fixed) {
+        float dtPhi, dtT;
+        sim.stableTimeSteps(dtPhi, dtT);
+        std::cout << "Stable dt: phase " << dtPhi << ", temperature " << dtT << std::endl;
+    }
+
+    auto printStats = [&]() {
+        const GrowthStats& g = sim.growthStats();
+        std::cout << "  solid " << g.solidCells << "  interface " << g.interfaceCells;
+        if (g.hasSolid()) std::cout << "  extent " << g.hi[0] - g.lo[0] + 1 << "x" << g.hi[1] - g.lo[1] + 1;
+        std::cout << "  t [" << g.tMin << ", " << g.tMax << "]  tip " << 100.0f * sim.growthMonitor().tipFraction() << "%";
+        if (sim.growthMonitor().tipSpeed() > 0.0) std::cout << " at " << sim.growthMonitor().tipSpeed();
+    };
+
+    size_t logged = 0;
+    auto printRollbacks = [&]() {
+        for (; logged < sim.rollbacks().size(); logged++) {
+            const RollbackEvent& e = sim.rollbacks()[logged];
+            std::cout << "  rollback: " << e.reason << " at step " << e.step << " (t " << e.time << ", dt " << e.dt << "), ";
+            if (e.gaveUp) std::cout << "giving up at step " << e.restoredStep;
+            else std::cout << "back to step " << e.restoredStep << " (t " << e.restoredTime << "), dt halved";
+            std::cout << std::endl;
+        }
+    };
+
+    // 3. 计时推进：按步数，或者按物理时间（每次最多推进 report 步）
+    auto start = std::chrono::steady_clock::now();
+    int done = 0;
+    // 没有 report 时按快照间隔分段，回退之后及时打印
+    int chunkSteps = report > 0 ? report : watchdog.interval > 0 ? watchdog.interval : INT_MAX;
+    auto finished = [&]() { return endTime > 0.0 ? sim.time() >= endTime * (1.0 - 1e-6) : done >= steps; };
+    while (!finished()) {
+        if (endTime > 0.0) {
+            done += sim.advance(endTime - sim.time(), chunkSteps);
+        } else {
+            int chunk = std::min(chunkSteps, steps - done);
+            done += sim.step(chunk);
+        }
+        printRollbacks();
+        if (report > 0) {
+            double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  step " << done << "  (" << t << " s)  t " << sim.time() << "  dt " << sim.timeStep();
+            if (sim.substeps() > 1) std::cout << " (" << (sim.phaseSubcycled() ? "phase" : "temperature") << " x" << sim.substeps() << ")";
+            if (sim.kernel() == Kobayashi::Kernel::NarrowBand) std::cout << "  active tiles " << 100.0f * sim.activeTileFraction() << "%";
+            if (sim.diagnostics()) printStats();
+            std::cout << std::endl;
+        }
+        if (sim.stopReason() != StopReason::None) break;
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    steps = done;
+
+    // 4. 报告吞吐量
+    double cellUpdates = (double)nx * ny * steps;
+    std::cout << "Steps: " << steps << ", physical time " << sim.time() << std::endl;
+    if (sim.stopReason() != StopReason::None) std::cout << "Stopped early: " << stopReasonName(sim.stopReason()) << std::endl;
+    if (watchdog.interval > 0) std::cout << "Rollbacks: " << sim.rollbacks().size() << std::endl;
+    std::cout << "Wall time: " << wall << " s" << std::endl;
+    std::cout << "Cell-updates/s: " << (wall > 0.0 ? cellUpdates / wall : 0.0) << std::endl;
+    if (sim.diagnostics()) {
+        std::cout << "Growth:";
+        printStats();
+        std::cout << std::endl;
+    }
+
+    if (!dump.empty()) {
+        std::vector<float> phi;
+        sim.exportPhi(phi);
+        if (!writeRawField(dump, phi)) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include "Kobayashi3D.h"
+#include "BatchConfig.h"
+#include <chrono>
+#include <algorithm>
+#include <climits>
+
+// 无窗口批处理程序（3D）：不创建窗口，不调用任何 OpenGL 函数
+// 用法示例：
+//   batch3D --nx 128 --ny 128 --nz 128 --dt 0.0001 --steps 500 --H 0.5
+//   batch3D --config run3d.cfg
+//   batch3D --timestep adaptive --time 0.02 --report 50
+//   batch3D --nx 256 --ny 256 --nz 256 --storage adaptive --regrid 4 --time 0.03
+//   batch3D --simd avx2
+//   batch3D --nx 256 --ny 256 --nz 256 --steps 40 --timeBlock 4
+//   batch3D --nx 64 --ny 64 --nz 64 --dx 0.045 --stencil 27
+//   batch3D --nx 201 --ny 201 --nz 201 --c2 0 --symmetry octant
+//   batch3D --steps 100000 --report 100 --stopTip 0.8 --stopSteady 0.02
+//   batch3D --dt 0.0002 --steps 2000 --watchdog 100
+int main(int argc, char** argv) {
+    BatchConfig cfg;
+    if (!cfg.parse(argc, argv)) return 1;
+
+    // 1. 网格和时间参数（默认值与 main3D.cpp 相同）
+    int nx = cfg.getInt("nx", 100);
+    int ny = cfg.getInt("ny", 100);
+    int nz = cfg.getInt("nz", 100);
+    float dt = cfg.getFloat("dt", 0.0001f);
+    int steps = cfg.getInt("steps", 100);
+    double endTime = cfg.getFloat("time", 0.0f); // 大于 0 时推进到这个物理时间，代替 steps
+    int report = cfg.getInt("report", 0); // 每隔多少步打印一次进度，0 表示不打印
+    std::string dump = cfg.getString("dump", "");
+    std::string boundary = cfg.getString("boundary", "periodic"); // periodic、neumann 或 dirichlet
+    int threads = cfg.getInt("threads", 0); // 0 表示使用全部核心
+    std::string aniso = cfg.getString("aniso", "algebraic"); // algebraic 或 trig
+    std::string storage = cfg.getString("storage", "dense"); // dense、sparse（只为晶体附近的砖块分配内存）或 adaptive（界面附近加密）
+    std::string timestep = cfg.getString("timestep", "fixed"); // fixed 或 adaptive（subcycled 在 3D 按 adaptive 推进）
+    int thermalRatio = cfg.getInt("thermalRatio", 1); // 温度场粗网格每个方向粗多少倍，1 表示与相场同一网格
+    int thermalPad = cfg.getInt("thermalPad", 0);     // 非周期边界时温度场粗网格在相场网格外每侧多出的粗格数
+    std::string precision = cfg.getString("precision", "single"); // 状态场的存储精度：single、half、bfloat16 或 double
+    std::string simd = cfg.getString("simd", "auto"); // 行内核的指令集：auto（CPU 支持的最高级别）、avx512、avx2、sse4 或 scalar
+    int timeBlock = cfg.getInt("timeBlock", 1); // 时间分块的步数，1 表示逐步推进
+    std::string layout = cfg.getString("layout", "separate"); // 各向异性量的排列：separate 或 bundled（按行交错，只用于 dense）
+    int stencil = cfg.getInt("stencil", 7); // 拉普拉斯算子的点数：7、19 或 27（后两者只用于 dense）
+    std::string symmetry = cfg.getString("symmetry", "none"); // 镜像对称约化：none、half、quarter 或 octant（只用于 dense）
+    int forceSymmetry = cfg.getInt("forceSymmetry", 0); // 1 表示 c2 ≠ 0 时仍然约化（结果与完整网格不同）
+    int diagnostics = cfg.getInt("diagnostics", 0); // 1 表示每步统计生长诊断，在进度和结束时打印
+    StopConditions stop; // 自动停止条件，0 表示不检查；time 已经给出推进的物理时间，不再重复
+    stop.tipFraction = cfg.getFloat("stopTip", 0.0f);           // 尖端到晶核的距离达到晶核到边界距离的这个比例
+    stop.steadyTolerance = cfg.getFloat("stopSteady", 0.0f);    // 尖端速度的相对变化不超过它
+    stop.steadyCells = cfg.getInt("steadyCells", stop.steadyCells); // 比较尖端速度的每段格数
+    WatchdogSettings watchdog; // 发散看门狗
+    watchdog.interval = cfg.getInt("watchdog", 0);                            // 快照间隔步数，0 表示关闭
+    watchdog.phiMin = cfg.getFloat("watchPhiMin", watchdog.phiMin);           // phi 的允许范围
+    watchdog.phiMax = cfg.getFloat("watchPhiMax", watchdog.phiMax);
+    watchdog.tLimit = cfg.getFloat("watchT", watchdog.tLimit);                // |t| 的上限
+    watchdog.maxRetries = cfg.getInt("watchRetries", watchdog.maxRetries);    // 从同一快照连续回退的次数上限
+
+    if (nx < 3 || ny < 3 || nz < 3 || steps < 0) {
+        std::cerr << "Invalid grid size or step count" << std::endl;
+        return 1;
+    }
+
+    // 2. 初始化模拟器，其余参数交给 setParam()
+    Kobayashi3D::Storage store = Kobayashi3D::Storage::Dense;
+    if (storage == "sparse") store = Kobayashi3D::Storage::Sparse;
+    else if (storage == "adaptive") store = Kobayashi3D::Storage::Adaptive;
+    else if (storage != "dense") {
+        std::cerr << "Unknown storage: " << storage << std::endl;
+        return 1;
+    }
+    Kobayashi3D sim(nx, ny, nz, dt, store);
+    if (!cfg.applyParams(sim)) return 1;
+    sim.setThreadCount(threads);
+    Boundary bc;
+    if (!parseBoundary(boundary, bc)) return 1;
+    sim.setBoundary(bc);
+    Kobayashi3D::Symmetry mirror = Kobayashi3D::Symmetry::None;
+    if (symmetry == "half") mirror = Kobayashi3D::Symmetry::Half;
+    else if (symmetry == "quarter") mirror = Kobayashi3D::Symmetry::Quarter;
+    else if (symmetry == "octant") mirror = Kobayashi3D::Symmetry::Octant;
+    else if (symmetry != "none") {
+        std::cerr << "Unknown symmetry: " << symmetry << std::endl;
+        return 1;
+    }
+    if (mirror != Kobayashi3D::Symmetry::None && (store != Kobayashi3D::Storage::Dense || thermalRatio > 1)) {
+        std::cerr << "symmetry " << symmetry << " needs storage dense and thermalRatio 1" << std::endl;
+        return 1;
+    }
+    if (!sim.setSymmetry(mirror, forceSymmetry != 0)) { // 在 setBoundary() 之后
+        std::cerr << "symmetry " << symmetry << " needs c2 0: with c2 != 0 the full grid is not mirror-symmetric "
+                  << "and the reduced run diverges from it (--forceSymmetry 1 imposes the symmetry anyway)" << std::endl;
+        return 1;
+    }
+    if (mirror != Kobayashi3D::Symmetry::None && !sim.mirrorSymmetric())
+        std::cerr << "Warning: c2 != 0, symmetry " << symmetry << " imposes a mirror symmetry the full grid does not have" << std::endl;
+    TimeStepping stepping;
+    if (!parseTimeStepping(timestep, stepping)) return 1;
+    sim.setTimeStepping(stepping);
+    if (aniso == "trig") sim.setAnisotropyMode(Kobayashi3D::AnisotropyMode::Trig);
+    else if (aniso != "algebraic") {
+        std::cerr << "Unknown anisotropy mode: " << aniso << std::endl;
+        return 1;
+    }
+    if (thermalRatio > 1) sim.setThermalGrid(thermalRatio, thermalPad); // 在 setBoundary() 之后
+    Precision storePrecision;
+    if (!parsePrecision(precision, storePrecision)) return 1;
+    sim.setPrecision(storePrecision);
+    SimdLevel simdLevel;
+    if (!parseSimd(simd, simdLevel)) return 1;
+    sim.setSimd(simdLevel);
+    sim.setTemporalBlocking(timeBlock);
+    if (layout == "bundled") sim.setDerivedLayout(Kobayashi3D::DerivedLayout::Bundled);
+    else if (layout != "separate") {
+        std::cerr << "Unknown layout: " << layout << std::endl;
+        return 1;
+    }
+    if (stencil == 19) sim.setLaplacianStencil(Kobayashi3D::LaplacianStencil::Point19);
+    else if (stencil == 27) sim.setLaplacianStencil(Kobayashi3D::LaplacianStencil::Point27);
+    else if (stencil != 7) {
+        std::cerr << "Unknown stencil: " << stencil << std::endl;
+        return 1;
+    }
+    sim.setDiagnostics(diagnostics != 0);
+    sim.setStopConditions(stop);
+    sim.setWatchdog(watchdog);
+
+    std::cout << "Grid " << nx << "x" << ny << "x" << nz << ", dt " << dt << ", ";
+    if (endTime > 0.0) std::cout << "time " << endTime << ", ";
+    else std::cout << steps << " steps, ";
+    std::cout << sim.threadCount() << " threads, " << aniso << ", " << boundary << ", " << storage << ", " << timestep << ", " << precision << ", " << simdName(sim.simd()) << std::endl;
+    if (stepping != TimeStepping::Fixed) {
+        float dtPhi, dtT;
+        sim.stableTimeSteps(dtPhi, dtT);
+        std::cout << "Stable dt: phase " << dtPhi << ", temperature " << dtT << std::endl;
+    }
+    auto printMemory = [&]() {
+        std::cout << "Memory: " << sim.memoryBytes() / (1024.0 * 1024.0) << " MB, "
+                  << (double)sim.memoryBytes() / ((double)nx * ny * nz) << " bytes/voxel";
+        if (store != Kobayashi3D::Storage::Dense) std::cout << ", " << sim.brickCount() << "/" << sim.brickTotal() << " bricks";
+        std::cout << std::endl;
+    };
+    printMemory();
+    auto printStats = [&]() {
+        const GrowthStats& g = sim.growthStats();
+        std::cout << "  solid " << g.solidCells << "  interface " << g.interfaceCells;
+        if (g.hasSolid()) std::cout << "  extent " << g.hi[0] - g.lo[0] + 1 << "x" << g.hi[1] - g.lo[1] + 1 << "x" << g.hi[2] - g.lo[2] + 1;
+        std::cout << "  t [" << g.tMin << ", " << g.tMax << "]  tip " << 100.0f * sim.growthMonitor().tipFraction() << "%";
+        if (sim.growthMonitor().tipSpeed() > 0.0) std::cout << " at " << sim.growthMonitor().tipSpeed();
+    };
+
+    size_t logged = 0;
+    auto printRollbacks = [&]() {
+        for (; logged < sim.rollbacks().size(); logged++) {
+            const RollbackEvent& e = sim.rollbacks()[logged];
+            std::cout << "  rollback: " << e.reason << " at step " << e.step << " (t " << e.time << ", dt " << e.dt << "), ";
+            if (e.gaveUp) std::cout << "giving up at step " << e.restoredStep;
+            else std::cout << "back to step " << e.restoredStep << " (t " << e.restoredTime << "), dt halved";
+            std::cout << std::endl;
+        }
+    };
+
+    // 3. 计时推进：按步数，或者按物理时间（每次最多推进 report 步）
+    auto start = std::chrono::steady_clock::now();
+    int done = 0;
+    // 没有 report 时按快照间隔分段，回退之后及时打印
+    int chunkSteps = report > 0 ? report : watchdog.interval > 0 ? watchdog.interval : INT_MAX;
+    auto finished = [&]() { return endTime > 0.0 ? sim.time() >= endTime * (1.0 - 1e-6) : done >= steps; };
+    while (!finished()) {
+        if (endTime > 0.0) {
+            done += sim.advance(endTime - sim.time(), chunkSteps);
+        } else {
+            int chunk = std::min(chunkSteps, steps - done);
+            done += sim.step(chunk);
+        }
+        printRollbacks();
+        if (report > 0) {
+            double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  step " << done << "  (" << t << " s)  t " << sim.time() << "  dt " << sim.timeStep();
+            if (store != Kobayashi3D::Storage::Dense) std::cout << "  " << sim.brickCount() << " bricks";
+            if (sim.diagnostics()) printStats();
+            std::cout << std::endl;
+        }
+        if (sim.stopReason() != StopReason::None) break;
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    steps = done;
+
+    // 4. 报告吞吐量（Adaptive 按细层的格子数计）
+    double cellUpdates = (double)sim.width() * sim.height() * sim.depth() * steps;
+    std::cout << "Steps: " << steps << ", physical time " << sim.time() << std::endl;
+    if (sim.stopReason() != StopReason::None) std::cout << "Stopped early: " << stopReasonName(sim.stopReason()) << std::endl;
+    if (watchdog.interval > 0) std::cout << "Rollbacks: " << sim.rollbacks().size() << std::endl;
+    std::cout << "Wall time: " << wall << " s" << std::endl;
+    std::cout << "Cell-updates/s: " << (wall > 0.0 ? cellUpdates / wall : 0.0) << std::endl;
+    if (sim.diagnostics()) {
+        std::cout << "Growth:";
+        printStats();
+        std::cout << std::endl;
+    }
+    if (store != Kobayashi3D::Storage::Dense) printMemory(); // 砖块随晶体生长而增减
+
+    if (!dump.empty()) {
+        std::vector<float> phi;
+        sim.exportPhi(phi);
+        if (!writeRawField(dump, phi)) return 1;
+    }
+    return 0;
+}
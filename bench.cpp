@@ -0,0 +1,436 @@
+#include "Kobayashi.h"
+#include "Kobayashi3D.h"
+#include "BatchConfig.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+// ==========================================
+// 求解器内核微基准测试
+// ==========================================
+
+// 对 2D 和 3D 求解器的每个阶段单独计时，报告：
+//   Mcell/s : 每秒更新的网格数（百万）
+//   B/cell  : 每个网格按"每个数组读/写一次"估算的内存流量
+//   GB/s    : 有效带宽 = Mcell/s × B/cell
+// 用法示例：
+//   bench --sizes2d 256,512,1024 --sizes3d 32,64 --mintime 0.5 --filter evolution
+//   bench --sizes2d 256 --sizes3d 64 --filter Half --accuracy2d 2000 --accuracy3d 300
+//   bench --sizes2d 512 --sizes3d 64 --simd avx2 --filter Scalar
+//   bench --sizes2d 2048 --sizes3d 128 --timeblock 8 --filter Step
+
+// 友元：单独调用 2D 求解器的每个阶段
+struct KobayashiBench
+{
+    static void gradient(Kobayashi& s) { s._computeGradientLaplacian(); }
+    static void evolution(Kobayashi& s) { s._evolution(); }
+    static void fused(Kobayashi& s) { s._fusedStep(); }
+    static void aniso(Kobayashi& s, bool trig) {
+        s.setAnisotropyMode(trig ? Kobayashi::AnisotropyMode::Trig : Kobayashi::AnisotropyMode::Algebraic);
+    }
+    static void texture(Kobayashi& s) { s._fillPixelBuffer(); }
+};
+
+// 友元：单独调用 3D 求解器的每个阶段
+struct Kobayashi3DBench
+{
+    static void anisotropy(Kobayashi3D& s) { s._computeAnisotropy(); }
+    static void fields(Kobayashi3D& s) { s._solveFields(); }
+    static void aniso(Kobayashi3D& s, bool trig) {
+        s.setAnisotropyMode(trig ? Kobayashi3D::AnisotropyMode::Trig : Kobayashi3D::AnisotropyMode::Algebraic);
+    }
+    static Kobayashi3D::AnisotropyDeviation deviation(const Kobayashi3D& s) { Kobayashi3D::AnisotropyDeviation d; s._anisotropyDeviation(d); return d; }
+    // 以中心为球心、半径 radius 格的球形晶核（Dense、Single），代替构造时的 7 格晶核
+    static void seedSphere(Kobayashi3D& s, float radius) {
+        int cx = s.width() / 2, cy = s.height() / 2, cz = s.depth() / 2;
+        for (int k = 0; k < s.depth(); k++)
+            for (int j = 0; j < s.height(); j++)
+                for (int i = 0; i < s.width(); i++) {
+                    float x = (float)(i - cx), y = (float)(j - cy), z = (float)(k - cz);
+                    s._phiRef(i, j, k) = (x * x + y * y + z * z <= radius * radius) ? 1.0f : 0.0f;
+                }
+    }
+};
+
+// 一个待测内核：名字、每个网格的内存流量估计、调用函数，以及每次调用推进的步数
+struct KernelCase
+{
+    const char* name;
+    double bytesPerCell;
+    std::function<void()> run;
+    int steps = 1;
+};
+
+struct BenchOptions
+{
+    double minTime = 0.2; // 每个内核至少计时这么久（秒）
+    int warmup = 20;      // 计时前先推进的物理步数，让界面出现
+    std::string filter;   // 只运行名字包含该字符串的内核
+    int threads = 0;      // 求解器线程数，0 表示使用全部核心
+    int accuracy2D = 0;   // 大于 0 时各存储精度推进这么多步，与 Double 比较（2D）
+    int accuracy3D = 0;   // 同上（3D）
+    SimdLevel simd = SimdLevel::AVX512; // 行内核的指令集（超过 CPU 支持的级别时降级），带 Scalar 后缀的内核总是用标量代码
+    int timeBlock = 4;    // blockedSteps 每次调用按时间分块推进的步数
+    float isotropy3D = 0.0f;       // 大于 0 时各拉普拉斯模板在 isotropyDx 的每个网格间距上推进到这个物理时间（3D）
+    std::vector<float> isotropyDx; // 同上，从细到粗
+};
+
+static std::vector<int> parseSizes(const std::string& s)
+{
+    std::vector<int> sizes;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) sizes.push_back(std::atoi(item.c_str()));
+    }
+    return sizes;
+}
+
+static void printHeader()
+{
+    std::printf("%-6s %-12s %-24s %10s %10s %8s %8s\n",
+                "engine", "grid", "kernel", "ms/call", "Mcell/s", "B/cell", "GB/s");
+}
+
+// 反复调用内核直到累计时间超过 minTime，报告平均每次调用的耗时
+static void runCase(const char* engine, const std::string& grid, double cells,
+                    const KernelCase& kc, const BenchOptions& opt)
+{
+    if (!opt.filter.empty() && std::string(kc.name).find(opt.filter) == std::string::npos) return;
+
+    kc.run(); // 预热缓存
+    int calls = 0;
+    double elapsed = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    while (elapsed < opt.minTime || calls < 3) {
+        kc.run();
+        calls++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double perCall = elapsed / calls;
+    double mcells = cells * kc.steps / perCall * 1e-6;
+    std::printf("%-6s %-12s %-24s %10.3f %10.2f %8.0f %8.2f\n",
+                engine, grid.c_str(), kc.name, perCall * 1e3, mcells, kc.bytesPerCell,
+                mcells * kc.bytesPerCell * 1e-3);
+}
+
+// 同一初始条件推进相同步数后与 Double 的结果比较：
+//   solid  : 固相格子数（phi > 0.5）的相对误差
+//   mean/max |dphi| : 逐格相场差的平均值和最大值（枝晶尖端位置稍有不同时最大值接近 1）
+static void printAccuracy(const char* engine, const std::string& grid, const char* name,
+                          const std::vector<float>& phi, const std::vector<float>& ref)
+{
+    size_t solid = 0, refSolid = 0;
+    double sum = 0.0, maxDiff = 0.0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        solid += phi[i] > 0.5f;
+        refSolid += ref[i] > 0.5f;
+        double d = std::fabs((double)phi[i] - ref[i]);
+        sum += d;
+        maxDiff = std::max(maxDiff, d);
+    }
+    double solidError = refSolid ? ((double)solid - (double)refSolid) / refSolid : 0.0;
+    std::printf("%-6s %-12s %-10s solid %8zu (%+.3f%%)  mean |dphi| %.2e  max |dphi| %.3f\n",
+                engine, grid.c_str(), name, solid, solidError * 100.0, sum / ref.size(), maxDiff);
+}
+
+static const Precision precisions[] = { Precision::Double, Precision::Single, Precision::Half, Precision::BFloat16 };
+static const char* precisionNames[] = { "double", "single", "half", "bfloat16" };
+
+static void accuracy2D(int n, const BenchOptions& opt)
+{
+    std::string grid = std::to_string(n) + "x" + std::to_string(n);
+    std::vector<float> ref, phi;
+    for (int p = 0; p < 4; p++) {
+        Kobayashi sim(n, n, 0.0001f);
+        sim.setThreadCount(opt.threads);
+        sim.setPrecision(precisions[p]);
+        sim.setSimd(opt.simd);
+        sim.step(opt.accuracy2D);
+        sim.exportPhi(p == 0 ? ref : phi);
+        printAccuracy("2D", grid, precisionNames[p], p == 0 ? ref : phi, ref);
+    }
+
+    // Single 的标量代码：与上面 single 的差别只来自行内核中 atan 的多项式近似
+    Kobayashi sim(n, n, 0.0001f);
+    sim.setThreadCount(opt.threads);
+    sim.setSimd(SimdLevel::Scalar);
+    sim.step(opt.accuracy2D);
+    sim.exportPhi(phi);
+    printAccuracy("2D", grid, "scalar", phi, ref);
+}
+
+static void accuracy3D(int n, const BenchOptions& opt)
+{
+    std::string grid = std::to_string(n) + "^3";
+    std::vector<float> ref, phi;
+    for (int p = 0; p < 4; p++) {
+        Kobayashi3D sim(n, n, n, 0.0001f);
+        sim.setThreadCount(opt.threads);
+        sim.setParam("H", 0.5f);
+        sim.setPrecision(precisions[p]);
+        sim.setSimd(opt.simd);
+        sim.step(opt.accuracy3D);
+        sim.exportPhi(p == 0 ? ref : phi);
+        printAccuracy("3D", grid, precisionNames[p], p == 0 ? ref : phi, ref);
+    }
+}
+
+static void bench2D(int n, const BenchOptions& opt)
+{
+    // 两遍的参考内核需要全场导数，融合内核单独用一个模拟器
+    Kobayashi sim(n, n, 0.0001f);
+    sim.setKernel(Kobayashi::Kernel::TwoPass);
+    sim.setThreadCount(opt.threads);
+    sim.setSimd(opt.simd);
+    sim.step(opt.warmup);
+
+    Kobayashi fusedSim(n, n, 0.0001f);
+    fusedSim.setThreadCount(opt.threads);
+    fusedSim.setSimd(opt.simd);
+    fusedSim.step(opt.warmup);
+
+    Kobayashi bandSim(n, n, 0.0001f);
+    bandSim.setKernel(Kobayashi::Kernel::NarrowBand);
+    bandSim.setThreadCount(opt.threads);
+    bandSim.setSimd(opt.simd);
+    bandSim.step(opt.warmup);
+
+    Kobayashi spectralSim(n, n, 0.0001f);
+    spectralSim.setKernel(Kobayashi::Kernel::Spectral);
+    spectralSim.setThreadCount(opt.threads);
+    spectralSim.setSimd(opt.simd);
+    spectralSim.step(opt.warmup);
+
+    // 其它存储精度总是用融合内核
+    Kobayashi halfSim(n, n, 0.0001f), bfloat16Sim(n, n, 0.0001f), doubleSim(n, n, 0.0001f);
+    halfSim.setPrecision(Precision::Half);
+    bfloat16Sim.setPrecision(Precision::BFloat16);
+    doubleSim.setPrecision(Precision::Double);
+    for (Kobayashi* s : { &halfSim, &bfloat16Sim, &doubleSim }) {
+        s->setThreadCount(opt.threads);
+        s->step(opt.warmup);
+    }
+
+    // 流量模型（float = 4 字节）：
+    //   gradient : 读 phi, t, angl；写 gradX, gradY, lapPhi, lapT, angl, eps, epsDeriv
+    //   evolution: 读 eps, epsDeriv, gradX, gradY, lapPhi, lapT, phi, t；写 phi, t
+    //   fusedStep: 读 phi, t, angl；写 phiNext, tNext, anglNext（导数只在每个线程的三行缓冲中）
+    //   narrowBand: 整步（含幽灵格和活跃块更新），流量按 fusedStep 乘以活跃块比例估计
+    //   spectral : 整步：fusedStep，打包（读 phi, phiNext, t, tNext；写一个复数），两次二维 FFT（行、列各读写一遍复数），
+    //              滤波（读两个复数、写一个复数），解包（读一个复数；读写 phi, t）
+    //   texture  : 读 phi；写 RGBA 4 字节
+    //   fusedStepHalf/BFloat16/Double : 同 fusedStep，phi、t 按存储类型 2 或 8 字节
+    //   blockedSteps : 按时间分块一次推进 timeblock 步（含幽灵格），流量按每步 fusedStep 估计（实际只有一步的内存流量）
+    // 带 Trig 后缀的是 atan/cos/sin 的原始各向异性实现，用来对比代数路径（anisotropy = 6）
+    // 带 Scalar 后缀的是同一内核的标量代码，用来对比 SIMD 行内核
+    // 代数路径不读写 angl
+    std::vector<KernelCase> cases = {
+        { "gradientLaplacian",      8 * 4.0, [&] { KobayashiBench::aniso(sim, false); KobayashiBench::gradient(sim); } },
+        { "gradientLaplacianTrig", 10 * 4.0, [&] { KobayashiBench::aniso(sim, true); KobayashiBench::gradient(sim); } },
+        { "evolution",             10 * 4.0, [&] { KobayashiBench::evolution(sim); } },
+        { "fusedStep",              4 * 4.0, [&] { KobayashiBench::aniso(fusedSim, false); KobayashiBench::fused(fusedSim); } },
+        { "fusedStepTrig",          6 * 4.0, [&] { KobayashiBench::aniso(fusedSim, true); KobayashiBench::fused(fusedSim); } },
+        { "fusedStepScalar",        4 * 4.0, [&] { KobayashiBench::aniso(fusedSim, false); fusedSim.setSimd(SimdLevel::Scalar);
+                                                   KobayashiBench::fused(fusedSim); fusedSim.setSimd(opt.simd); } },
+        { "fusedStepHalf",          4 * 2.0, [&] { KobayashiBench::fused(halfSim); } },
+        { "fusedStepBFloat16",      4 * 2.0, [&] { KobayashiBench::fused(bfloat16Sim); } },
+        { "fusedStepDouble",        4 * 8.0, [&] { KobayashiBench::fused(doubleSim); } },
+        { "blockedSteps",           4 * 4.0, [&] { KobayashiBench::aniso(fusedSim, false); fusedSim.setTemporalBlocking(opt.timeBlock);
+                                                   fusedSim.step(opt.timeBlock); }, opt.timeBlock },
+        { "narrowBandStep", 4 * 4.0 * bandSim.activeTileFraction(), [&] { bandSim.step(1); } },
+        { "spectralStep",          36 * 4.0, [&] { spectralSim.step(1); } },
+        { "updateTexture",          2 * 4.0, [&] { KobayashiBench::texture(sim); } },
+    };
+
+    std::string grid = std::to_string(n) + "x" + std::to_string(n);
+    for (const auto& kc : cases) runCase("2D", grid, (double)n * n, kc, opt);
+    std::cout << "2D " << grid << " narrowBand active tiles: " << 100.0f * bandSim.activeTileFraction() << "%" << std::endl;
+}
+
+// 两个默认参数的模拟器先用 Algebraic 走 warmup 步，再分别用 Trig 和 Algebraic 走一步，返回 phi 的最大绝对差
+static float anisotropyStepDeviation(int n, int warmup, const BenchOptions& opt)
+{
+    Kobayashi3D trig(n, n, n, 0.0001f), algebraic(n, n, n, 0.0001f);
+    for (Kobayashi3D* s : { &trig, &algebraic }) {
+        s->setThreadCount(opt.threads);
+        s->setSimd(opt.simd);
+        s->step(warmup);
+    }
+    Kobayashi3DBench::aniso(trig, true);
+    trig.step(1);
+    algebraic.step(1);
+    float diff = 0.0f;
+    for (int k = 0; k < n; k++)
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i < n; i++) diff = std::max(diff, std::fabs(trig.phiAt(i, j, k) - algebraic.phiAt(i, j, k)));
+    return diff;
+}
+
+static void bench3D(int n, const BenchOptions& opt)
+{
+    Kobayashi3D sim(n, n, n, 0.0001f);
+    sim.setThreadCount(opt.threads);
+    sim.setSimd(opt.simd);
+    sim.step(opt.warmup);
+
+    Kobayashi3D bundledSim(n, n, n, 0.0001f);
+    bundledSim.setThreadCount(opt.threads);
+    bundledSim.setSimd(opt.simd);
+    bundledSim.setDerivedLayout(Kobayashi3D::DerivedLayout::Bundled);
+    bundledSim.step(opt.warmup);
+
+    Kobayashi3D halfSim(n, n, n, 0.0001f), bfloat16Sim(n, n, n, 0.0001f), doubleSim(n, n, n, 0.0001f);
+    halfSim.setPrecision(Precision::Half);
+    bfloat16Sim.setPrecision(Precision::BFloat16);
+    doubleSim.setPrecision(Precision::Double);
+    for (Kobayashi3D* s : { &halfSim, &bfloat16Sim, &doubleSim }) {
+        s->setThreadCount(opt.threads);
+        s->step(opt.warmup);
+    }
+
+    // 流量模型（float = 4 字节）：
+    //   anisotropy  : 读 phi, omega×3；写 eps², fluxY, fluxZ, epsTauTheta
+    //   fields      : H = 0 的特化，读 phi, t, eps², fluxY, fluxZ, epsTauTheta；写 phiNext, tNext
+    //   fieldsOrient: H ≠ 0，另外读 omega×3、写 omega_next×3
+    //   solveFieldsHalf/BFloat16/Double : 同 fields，状态场 4 个按存储类型，通量项 4 个按计算类型（Half、BFloat16 为 float）
+    //   blockedSteps: 按时间分块一次推进 timeblock 步（两个阶段，含幽灵格），流量按每步 anisotropy + fields 估计
+    //   *Bundled    : 同一内核，各向异性量按行交错存放（DerivedLayout::Bundled），流量相同
+    //   solveFields19/27 : 同 fields，拉普拉斯算子换成 19、27 点模板，多读的棱、角邻居都在已经读过的行上，流量相同
+    // computeAnisotropyTrig 是 Rodrigues + acos/atan2 的原始实现，用来对比代数路径
+    // 带 Scalar 后缀的是同一内核的标量代码，用来对比 SIMD 行内核
+    std::vector<KernelCase> cases = {
+        { "computeAnisotropy",     8 * 4.0, [&] { Kobayashi3DBench::aniso(sim, false); Kobayashi3DBench::anisotropy(sim); } },
+        { "computeAnisotropyTrig", 8 * 4.0, [&] { Kobayashi3DBench::aniso(sim, true); Kobayashi3DBench::anisotropy(sim); } },
+        { "computeAnisotropyScalar", 8 * 4.0, [&] { Kobayashi3DBench::aniso(sim, false); sim.setSimd(SimdLevel::Scalar);
+                                                    Kobayashi3DBench::anisotropy(sim); sim.setSimd(opt.simd); } },
+        { "solveFields",           8 * 4.0, [&] { Kobayashi3DBench::fields(sim); } },
+        { "solveFieldsScalar",     8 * 4.0, [&] { sim.setSimd(SimdLevel::Scalar); Kobayashi3DBench::fields(sim); sim.setSimd(opt.simd); } },
+        { "solveFields19",         8 * 4.0, [&] { sim.setLaplacianStencil(Kobayashi3D::LaplacianStencil::Point19); Kobayashi3DBench::fields(sim);
+                                                  sim.setLaplacianStencil(Kobayashi3D::LaplacianStencil::Point7); } },
+        { "solveFields27",         8 * 4.0, [&] { sim.setLaplacianStencil(Kobayashi3D::LaplacianStencil::Point27); Kobayashi3DBench::fields(sim);
+                                                  sim.setLaplacianStencil(Kobayashi3D::LaplacianStencil::Point7); } },
+        { "computeAnisotropyBundled", 8 * 4.0, [&] { Kobayashi3DBench::anisotropy(bundledSim); } },
+        { "solveFieldsBundled",    8 * 4.0, [&] { Kobayashi3DBench::fields(bundledSim); } },
+        { "solveFieldsBundledScalar", 8 * 4.0, [&] { bundledSim.setSimd(SimdLevel::Scalar); Kobayashi3DBench::fields(bundledSim);
+                                                     bundledSim.setSimd(opt.simd); } },
+        { "solveFieldsOrientation", 14 * 4.0, [&] { sim.setParam("H", 0.5f); Kobayashi3DBench::fields(sim); sim.setParam("H", 0.0f); } },
+        { "solveFieldsHalf",       4 * 2.0 + 4 * 4.0, [&] { Kobayashi3DBench::fields(halfSim); } },
+        { "solveFieldsBFloat16",   4 * 2.0 + 4 * 4.0, [&] { Kobayashi3DBench::fields(bfloat16Sim); } },
+        { "solveFieldsDouble",     8 * 8.0, [&] { Kobayashi3DBench::fields(doubleSim); } },
+        { "blockedSteps",         16 * 4.0, [&] { Kobayashi3DBench::aniso(sim, false); sim.setTemporalBlocking(opt.timeBlock);
+                                                  sim.step(opt.timeBlock); }, opt.timeBlock },
+    };
+
+    std::string grid = std::to_string(n) + "^3";
+    for (const auto& kc : cases) runCase("3D", grid, (double)n * n * n, kc, opt);
+
+    // 两种各向异性实现在同一状态上的最大绝对误差，以及各走一步后 phi 的最大差
+    auto dev = Kobayashi3DBench::deviation(sim);
+    std::cout << "3D " << grid << " anisotropy Algebraic vs Trig max |diff|: eps " << dev.eps
+              << ", deps/dtheta " << dev.epsTheta << ", deps/dphi " << dev.epsPhi
+              << ", fluxY " << dev.fluxY << ", fluxZ " << dev.fluxZ << " (max |flux| " << dev.fluxScale << ")"
+              << ", epsTauTheta " << dev.epsTauTheta << std::endl;
+    std::cout << "3D " << grid << " anisotropy Algebraic vs Trig one-step phi max |diff|: from the seed "
+              << anisotropyStepDeviation(n, 0, opt) << ", after warmup " << anisotropyStepDeviation(n, opt.warmup, opt) << std::endl;
+}
+
+// 拉普拉斯模板的网格各向异性：c2 = 0 时界面能各向同性，球形晶核只会因网格长出偏向某些方向的枝晶。
+// 物理尺寸固定（边长 3、晶核半径 0.15），网格间距 dx 越粗格子越少。同一 dx 下三种模板用相同的 dt
+// （7 点模板的稳定上限的一半），推进到同一物理时间后沿 <100>、<110>、<111> 测 phi = 0.5 的半径：
+//   r100/r111 : 各向同性时为 1，网格把界面推向坐标轴时大于 1
+//   size      : 三个半径的平均值与参考解（最细 dx 的 27 点模板）的相对差，界面分辨不足时晶体长得慢
+//   shape     : 各半径除以平均值后与参考解的最大差，只反映形状
+static float isotropyRadius(const Kobayashi3D& sim, int dx, int dy, int dz)
+{
+    int n = sim.width(), c = n / 2;
+    float length = std::sqrt((float)(dx * dx + dy * dy + dz * dz));
+    float prev = sim.phiAt(c, c, c);
+    for (int m = 1; c + m < n; m++) {
+        float cur = sim.phiAt(c + m * dx, c + m * dy, c + m * dz);
+        if (prev >= 0.5f && cur < 0.5f) return length * ((m - 1) + (prev - 0.5f) / (prev - cur));
+        prev = cur;
+    }
+    return length * (n - 1 - c);
+}
+
+static void isotropy3D(const BenchOptions& opt)
+{
+    const float domain = 3.0f, seed = 0.15f;
+    const Kobayashi3D::LaplacianStencil stencils[] = { Kobayashi3D::LaplacianStencil::Point7,
+        Kobayashi3D::LaplacianStencil::Point19, Kobayashi3D::LaplacianStencil::Point27 };
+    const int points[] = { 7, 19, 27 };
+    float ref[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t d = 0; d < opt.isotropyDx.size(); d++) {
+        float h = opt.isotropyDx[d];
+        int n = (int)std::lround(domain / h);
+        auto configure = [&](Kobayashi3D& sim) {
+            for (const char* name : { "dx", "dy", "dz" }) sim.setParam(name, h);
+            sim.setParam("c2", 0.0f);
+        };
+        Kobayashi3D probe(3, 3, 3, 1.0f);
+        configure(probe);
+        float dtPhi, dtT;
+        probe.stableTimeSteps(dtPhi, dtT);
+        float dt = 0.5f * std::min(dtPhi, dtT);
+        for (int s = 2; s >= 0; s--) {
+            Kobayashi3D sim(n, n, n, dt);
+            sim.setThreadCount(opt.threads);
+            sim.setSimd(opt.simd);
+            configure(sim);
+            sim.setLaplacianStencil(stencils[s]);
+            Kobayashi3DBench::seedSphere(sim, seed / h);
+            auto start = std::chrono::steady_clock::now();
+            int steps = sim.advance(opt.isotropy3D, INT_MAX);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            float r[3] = { isotropyRadius(sim, 1, 0, 0) * h, isotropyRadius(sim, 1, 1, 0) * h, isotropyRadius(sim, 1, 1, 1) * h };
+            if (d == 0 && s == 2) std::copy(r, r + 3, ref);
+            float mean = (r[0] + r[1] + r[2]) / 3.0f, refMean = (ref[0] + ref[1] + ref[2]) / 3.0f, shape = 0.0f;
+            for (int a = 0; a < 3; a++) shape = std::max(shape, std::fabs(r[a] / mean - ref[a] / refMean));
+            std::printf("3D     %-12s dx %.4f %2d-point  r100 %.4f  r110 %.4f  r111 %.4f  r100/r111 %.3f  size %5.1f%%  shape %4.1f%%  %5d steps %7.2f s\n",
+                        (std::to_string(n) + "^3").c_str(), h, points[s], r[0], r[1], r[2], r[0] / r[2],
+                        (mean - refMean) / refMean * 100.0f, shape * 100.0f, steps, seconds);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BatchConfig cfg;
+    if (!cfg.parse(argc, argv)) return 1;
+
+    BenchOptions opt;
+    opt.minTime = cfg.getFloat("mintime", 0.2f);
+    opt.warmup = cfg.getInt("warmup", 20);
+    opt.filter = cfg.getString("filter", "");
+    opt.threads = cfg.getInt("threads", 0);
+    opt.accuracy2D = cfg.getInt("accuracy2d", 0);
+    opt.accuracy3D = cfg.getInt("accuracy3d", 0);
+    opt.timeBlock = std::max(1, cfg.getInt("timeblock", 4));
+    opt.isotropy3D = cfg.getFloat("isotropy3d", 0.0f);
+    std::stringstream dxList(cfg.getString("isotropydx", "0.02,0.03,0.045,0.06"));
+    for (std::string item; std::getline(dxList, item, ',');) if (!item.empty()) opt.isotropyDx.push_back(std::stof(item));
+    if (!parseSimd(cfg.getString("simd", "auto"), opt.simd)) return 1;
+    std::vector<int> sizes2D = parseSizes(cfg.getString("sizes2d", "128,256,512,1024"));
+    std::vector<int> sizes3D = parseSizes(cfg.getString("sizes3d", "32,64,96"));
+
+    for (const auto& kv : cfg.values) {
+        if (!cfg.used.count(kv.first)) {
+            std::cerr << "Unknown option: " << kv.first << std::endl;
+            return 1;
+        }
+    }
+
+    printHeader();
+    for (int n : sizes2D) bench2D(n, opt);
+    for (int n : sizes3D) bench3D(n, opt);
+    if (opt.accuracy2D > 0) for (int n : sizes2D) accuracy2D(n, opt);
+    if (opt.accuracy3D > 0) for (int n : sizes3D) accuracy3D(n, opt);
+    if (opt.isotropy3D > 0.0f) isotropy3D(opt);
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include "Kobayashi.h"
 
 Kobayashi* g_sim = nullptr;
+size_t g_loggedRollbacks = 0; // 已经打印过的看门狗回退
 
 // 渲染回调
 void display() {
@@ -11,7 +12,16 @@ void display() {
 // 闲置回调（相当于 Update 循环）
 void idle() {
     if (g_sim) {
+        bool running = !g_sim->isPaused();
         g_sim->update();
+        // 满足停止条件时 update() 自行暂停，按空格键可以继续
+        if (running && g_sim->isPaused())
+            std::cout << "Stopped: " << stopReasonName(g_sim->stopReason()) << " (t = " << g_sim->time() << ")" << std::endl;
+        for (; g_loggedRollbacks < g_sim->rollbacks().size(); g_loggedRollbacks++) {
+            const RollbackEvent& e = g_sim->rollbacks()[g_loggedRollbacks];
+            std::cout << "Rollback: " << e.reason << " at t = " << e.time << ", back to t = " << e.restoredTime
+                      << (e.gaveUp ? "" : ", dt halved") << std::endl;
+        }
         glutPostRedisplay(); // 请求重绘
     }
 }
@@ -45,6 +55,12 @@ int main(int argc, char** argv) {
 
     // 2. 初始化模拟器
     g_sim = new Kobayashi(250, 250, 0.0001f);
+    StopConditions stop;
+    stop.tipFraction = 0.9f; // 周期边界下晶体碰到自己的像之前暂停
+    g_sim->setStopConditions(stop);
+    WatchdogSettings watchdog;
+    watchdog.interval = 200; // 发散时回到最多 200 步之前，dt 减半后继续
+    g_sim->setWatchdog(watchdog);
     g_sim->glInit();
     
     std::cout << "Controls:\n [Space]: Pause/Play\n [R]: Reset\n [ESC]: Quit" << std::endl;
@@ -57,6 +73,7 @@ int main(int argc, char** argv) {
     // 4. 进入主循环
     glutMainLoop();
 
+    g_sim->glRelease();
     delete g_sim;
     return 0;
 }
\ No newline at end of file
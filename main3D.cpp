@@ -1,7 +1,8 @@
 #include <GL/freeglut.h>
 #include "Kobayashi3D.h"
 
-Kobayashi* g_sim = nullptr;
+Kobayashi3D* g_sim = nullptr;
+size_t g_loggedRollbacks = 0; // 已经打印过的看门狗回退
 
 // 渲染回调
 void display() {
@@ -11,7 +12,16 @@ void display() {
 // 闲置回调（相当于 Update 循环）
 void idle() {
     if (g_sim) {
+        bool running = !g_sim->isPaused();
         g_sim->update();
+        // 满足停止条件时 update() 自行暂停，按空格键可以继续
+        if (running && g_sim->isPaused())
+            std::cout << "Stopped: " << stopReasonName(g_sim->stopReason()) << " (t = " << g_sim->time() << ")" << std::endl;
+        for (; g_loggedRollbacks < g_sim->rollbacks().size(); g_loggedRollbacks++) {
+            const RollbackEvent& e = g_sim->rollbacks()[g_loggedRollbacks];
+            std::cout << "Rollback: " << e.reason << " at t = " << e.time << ", back to t = " << e.restoredTime
+                      << (e.gaveUp ? "" : ", dt halved") << std::endl;
+        }
         glutPostRedisplay(); // 请求重绘
     }
 }
@@ -47,7 +57,13 @@ int main(int argc, char** argv) {
     glEnable(GL_DEPTH_TEST);
 
     // 2. 初始化模拟器（3D网格：100x100x100）
-    g_sim = new Kobayashi(100, 100, 100, 0.0001f);
+    g_sim = new Kobayashi3D(100, 100, 100, 0.0001f);
+    StopConditions stop;
+    stop.tipFraction = 0.9f; // 周期边界下晶体碰到自己的像之前暂停
+    g_sim->setStopConditions(stop);
+    WatchdogSettings watchdog;
+    watchdog.interval = 200; // 发散时回到最多 200 步之前，dt 减半后继续
+    g_sim->setWatchdog(watchdog);
     g_sim->glInit();
 
     std::cout << "Controls:\n [Space]: Pause/Play\n [R]: Reset\n [ESC]: Quit" << std::endl;